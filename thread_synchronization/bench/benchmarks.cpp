@@ -0,0 +1,306 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "array_manager.h"
+#include "sync_primitives.h"
+#include "trace.h"
+
+namespace {
+
+constexpr size_t kContendedArraySize = 1 << 16;
+
+// One array per backend, shared by every thread of a run so the threads
+// really contend on it. Markers release whatever they claim, so the array
+// is empty again between runs.
+ArrayManager& sharedArray(ArrayBackend backend) {
+    static std::unique_ptr<ArrayManager> arrays[] = {
+        std::make_unique<ArrayManager>(kContendedArraySize, ArrayBackend::GlobalLock),
+        std::make_unique<ArrayManager>(kContendedArraySize, ArrayBackend::Striped),
+        std::make_unique<ArrayManager>(kContendedArraySize, ArrayBackend::PerElement),
+        std::make_unique<ArrayManager>(kContendedArraySize, ArrayBackend::LockFree),
+    };
+    return *arrays[static_cast<size_t>(backend)];
+}
+
+void BM_MarkReset(benchmark::State& state) {
+    ArrayManager& array = sharedArray(static_cast<ArrayBackend>(state.range(0)));
+    const int markerId = state.thread_index() + 1;
+    std::mt19937 rng(static_cast<unsigned int>(markerId));
+    std::uniform_int_distribution<size_t> pick(0, array.getSize() - 1);
+    
+    for (auto _ : state) {
+        const size_t index = pick(rng);
+        if (array.markElement(index, markerId)) {
+            array.resetElement(index, markerId);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// BM_MarkReset with each thread submitting batch indices per call; items
+// are indices, so the rates compare directly.
+void BM_MarkResetBatched(benchmark::State& state) {
+    ArrayManager& array = sharedArray(static_cast<ArrayBackend>(state.range(0)));
+    const int markerId = state.thread_index() + 1;
+    std::mt19937 rng(static_cast<unsigned int>(markerId));
+    std::uniform_int_distribution<size_t> pick(0, array.getSize() - 1);
+    std::vector<size_t> batch(static_cast<size_t>(state.range(1)));
+    
+    for (auto _ : state) {
+        for (size_t& index : batch) {
+            index = pick(rng);
+        }
+        array.markElements(batch, markerId);
+        // Only cells this thread holds are reset.
+        array.resetElements(batch, markerId);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+// Lock-free marks on an array of one sequence segment and on a larger one.
+// With no snapshot running, markers never write the shared sequence words,
+// so the single-segment array should scale like the large one.
+void BM_MarkElement(benchmark::State& state) {
+    static ArrayManager small(SegmentedSeqLock::kSegmentSize, ArrayBackend::LockFree);
+    static ArrayManager large(kContendedArraySize, ArrayBackend::LockFree);
+    ArrayManager& array = state.range(0) == 0 ? small : large;
+    const int markerId = state.thread_index() + 1;
+    std::mt19937 rng(static_cast<unsigned int>(markerId));
+    std::uniform_int_distribution<size_t> pick(0, array.getSize() - 1);
+    
+    for (auto _ : state) {
+        const size_t index = pick(rng);
+        if (array.markElement(index, markerId)) {
+            array.resetElement(index, markerId);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Fills the whole array by drawing indices until one is free (mode 0) or
+// through claimAnyFree (mode 1). Drawing slows down as the array fills.
+void BM_FillArray(benchmark::State& state) {
+    ArrayManager array(static_cast<size_t>(state.range(0)), ArrayBackend::LockFree);
+    if (state.range(1) == 1) {
+        array.trackOccupancy();
+    }
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<size_t> pick(0, array.getSize() - 1);
+    
+    for (auto _ : state) {
+        if (state.range(1) == 0) {
+            for (size_t filled = 0; filled < array.getSize();) {
+                filled += array.markElement(pick(rng), 1) ? 1 : 0;
+            }
+        } else {
+            while (array.claimAnyFree(1, pick(rng))) {
+            }
+        }
+        state.PauseTiming();
+        array.resetMarkedElements(1);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_CountMarkedElements(benchmark::State& state) {
+    ArrayManager array(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < array.getSize(); i += 3) {
+        array.markElement(i, 1);
+    }
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(array.countMarkedElements(1));
+    }
+}
+
+void BM_RecountMarkedElements(benchmark::State& state) {
+    const CellWidth width = parseCellWidth(std::to_string(state.range(1)));
+    ArrayManager array(static_cast<size_t>(state.range(0)), ArrayBackend::GlobalLock, 0,
+                       StorageOptions(), width);
+    for (size_t i = 0; i < array.getSize(); i += 3) {
+        array.markElement(i, 1);
+    }
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(array.recountMarkedElements(1));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(cellBytes(width)));
+}
+
+// Every cell belongs to a random one of the markers or is free, so almost
+// no block is uniform.
+void BM_MarkerHistogramMixed(benchmark::State& state) {
+    const CellWidth width = parseCellWidth(std::to_string(state.range(0)));
+    const int markers = static_cast<int>(state.range(1));
+    constexpr size_t kSize = 1 << 20;
+    ArrayManager array(kSize, ArrayBackend::GlobalLock, 0, StorageOptions(), width);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> owner(0, markers);
+    for (size_t i = 0; i < kSize; ++i) {
+        const int marker = owner(rng);
+        if (marker != 0) {
+            array.markElement(i, marker);
+        }
+    }
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(array.markerHistogram(static_cast<size_t>(markers) + 1));
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(kSize * cellBytes(width)));
+}
+
+void BM_Snapshot(benchmark::State& state) {
+    ArrayManager array(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < array.getSize(); i += 3) {
+        array.markElement(i, 1);
+    }
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(array.snapshot());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(sizeof(int)));
+}
+
+// Ping-pong between two threads; each iteration is two signal-to-wake hops.
+void BM_EventSignalToWake(benchmark::State& state) {
+    Event ping;
+    Event pong;
+    std::atomic<bool> stop(false);
+    
+    std::thread responder([&] {
+        while (true) {
+            ping.wait();
+            ping.reset();
+            if (stop.load()) {
+                break;
+            }
+            pong.signal();
+        }
+    });
+    
+    for (auto _ : state) {
+        ping.signal();
+        pong.wait();
+        pong.reset();
+    }
+    
+    stop.store(true);
+    ping.signal();
+    responder.join();
+}
+
+// Main thread releases N signallers with one broadcast and waits for all of
+// them to count down.
+void BM_CountdownEventFanIn(benchmark::State& state) {
+    const int signallerCount = static_cast<int>(state.range(0));
+    CountdownEvent countdown(0);
+    EpochEvent release;
+    std::atomic<bool> stop(false);
+    
+    std::vector<std::thread> signallers;
+    for (int i = 0; i < signallerCount; ++i) {
+        signallers.emplace_back([&] {
+            uint32_t seen = 0;
+            while (true) {
+                release.waitForChange(seen);
+                seen = release.current();
+                if (stop.load()) {
+                    break;
+                }
+                countdown.signal();
+            }
+        });
+    }
+    
+    for (auto _ : state) {
+        countdown.reset(signallerCount);
+        release.advance();
+        countdown.wait();
+    }
+    
+    stop.store(true);
+    release.advance();
+    for (auto& signaller : signallers) {
+        signaller.join();
+    }
+}
+
+ThreadBarrier& barrierFor(int threadCount) {
+    static std::mutex barriersMutex;
+    static std::map<int, std::unique_ptr<ThreadBarrier>> barriers;
+    
+    std::lock_guard<std::mutex> lock(barriersMutex);
+    auto& barrier = barriers[threadCount];
+    if (!barrier) {
+        barrier = std::make_unique<ThreadBarrier>(threadCount);
+    }
+    return *barrier;
+}
+
+void BM_ThreadBarrierAwait(benchmark::State& state) {
+    ThreadBarrier& barrier = barrierFor(state.threads());
+    
+    for (auto _ : state) {
+        barrier.await();
+    }
+}
+
+// Producer-side cost of one trace event while the recorder drains to
+// /dev/null in the background.
+void BM_TraceRecord(benchmark::State& state) {
+    TraceRecorder recorder("/dev/null", kContendedArraySize);
+    TraceRing* ring = recorder.createRing();
+    uint64_t index = 0;
+    
+    for (auto _ : state) {
+        ring->record(TraceEventType::Mark, 1, index++);
+    }
+    
+    recorder.stop();
+    state.counters["dropped"] = static_cast<double>(recorder.getDropped());
+}
+
+const int kMaxThreads = static_cast<int>(std::max(4u, std::thread::hardware_concurrency()));
+
+}
+
+BENCHMARK(BM_MarkReset)
+    ->ArgName("backend")
+    ->DenseRange(0, 3)
+    ->ThreadRange(1, kMaxThreads)
+    ->UseRealTime();
+BENCHMARK(BM_MarkResetBatched)
+    ->ArgNames({"backend", "batch"})
+    ->ArgsProduct({benchmark::CreateDenseRange(0, 3, 1), {8, 64}})
+    ->ThreadRange(1, kMaxThreads)
+    ->UseRealTime();
+BENCHMARK(BM_MarkElement)
+    ->ArgName("large")
+    ->DenseRange(0, 1)
+    ->ThreadRange(1, kMaxThreads)
+    ->UseRealTime();
+BENCHMARK(BM_FillArray)
+    ->ArgNames({"size", "nearest"})
+    ->ArgsProduct({{1 << 12, 1 << 16}, {0, 1}});
+BENCHMARK(BM_CountMarkedElements)->RangeMultiplier(16)->Range(1 << 10, 1 << 24);
+BENCHMARK(BM_RecountMarkedElements)
+    ->ArgNames({"size", "cell_bits"})
+    ->ArgsProduct({benchmark::CreateRange(1 << 10, 1 << 24, 16), {8, 16, 32}});
+BENCHMARK(BM_MarkerHistogramMixed)
+    ->ArgNames({"cell_bits", "markers"})
+    ->ArgsProduct({{8, 16, 32}, {2, 7, 15, 100}});
+BENCHMARK(BM_Snapshot)->RangeMultiplier(16)->Range(1 << 10, 1 << 24);
+BENCHMARK(BM_EventSignalToWake)->UseRealTime();
+BENCHMARK(BM_CountdownEventFanIn)->RangeMultiplier(2)->Range(1, kMaxThreads)->UseRealTime();
+BENCHMARK(BM_TraceRecord);
+BENCHMARK(BM_ThreadBarrierAwait)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+BENCHMARK_MAIN();
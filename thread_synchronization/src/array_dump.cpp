@@ -0,0 +1,154 @@
+#include "array_dump.h"
+#include <charconv>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+
+template <typename T>
+void appendNumber(std::string& text, T value) {
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+}
+
+ArrayDumper::ArrayDumper(ArrayDumpMode mode)
+    : mode(mode),
+      hasPrevious(false) {
+}
+
+ArrayDumpMode ArrayDumper::getMode() const {
+    return mode;
+}
+
+std::string ArrayDumper::format(const ArraySnapshot& snapshot) {
+    const std::vector<int>& values = snapshot.values;
+    std::string text;
+    
+    switch (mode) {
+        case ArrayDumpMode::Full:
+            formatFull(values, text);
+            break;
+        case ArrayDumpMode::RunLength:
+            formatRunLength(values, text);
+            break;
+        case ArrayDumpMode::Summary:
+            formatSummary(values, text);
+            break;
+        case ArrayDumpMode::Delta:
+            // The first dump has nothing to compare against, so it is the
+            // run-length baseline later deltas refer to.
+            if (hasPrevious && previous.size() == values.size()) {
+                formatDelta(values, text);
+            } else {
+                formatRunLength(values, text);
+            }
+            previous = values;
+            hasPrevious = true;
+            break;
+    }
+    return text;
+}
+
+void ArrayDumper::print(const ArrayManager& arrayManager, std::ostream& out) {
+    const std::string text = format(arrayManager.snapshot());
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    out.flush();
+}
+
+void ArrayDumper::formatFull(const std::vector<int>& values, std::string& text) const {
+    // Up to five digits plus ", " per element for marker values.
+    text.reserve(values.size() * 4 + 24);
+    text += "Array contents: [";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) {
+            text += ", ";
+        }
+        appendNumber(text, values[i]);
+    }
+    text += "]\n";
+}
+
+void ArrayDumper::formatRunLength(const std::vector<int>& values, std::string& text) const {
+    text += "Array runs: [";
+    size_t runStart = 0;
+    for (size_t i = 1; i <= values.size(); ++i) {
+        if (i < values.size() && values[i] == values[runStart]) {
+            continue;
+        }
+        
+        if (runStart > 0) {
+            text += ", ";
+        }
+        appendNumber(text, values[runStart]);
+        if (i - runStart > 1) {
+            text += " x ";
+            appendNumber(text, i - runStart);
+        }
+        runStart = i;
+    }
+    text += "]\n";
+}
+
+void ArrayDumper::formatSummary(const std::vector<int>& values, std::string& text) const {
+    std::map<int, size_t> cellsPerValue;
+    for (int value : values) {
+        ++cellsPerValue[value];
+    }
+    
+    text += "Array summary: size=";
+    appendNumber(text, values.size());
+    text += " free=";
+    appendNumber(text, cellsPerValue.count(0) ? cellsPerValue[0] : 0);
+    for (const auto& [value, cells] : cellsPerValue) {
+        if (value == 0) {
+            continue;
+        }
+        text += " marker";
+        appendNumber(text, value);
+        text += '=';
+        appendNumber(text, cells);
+    }
+    text += '\n';
+}
+
+void ArrayDumper::formatDelta(const std::vector<int>& values, std::string& text) const {
+    std::string changes;
+    size_t changed = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i] == previous[i]) {
+            continue;
+        }
+        
+        if (changed++ > 0) {
+            changes += ", ";
+        }
+        appendNumber(changes, i);
+        changes += ": ";
+        appendNumber(changes, previous[i]);
+        changes += " -> ";
+        appendNumber(changes, values[i]);
+    }
+    
+    text += "Array delta: changed=";
+    appendNumber(text, changed);
+    text += " [";
+    text += changes;
+    text += "]\n";
+}
+
+ArrayDumpMode parseArrayDumpMode(const std::string& text) {
+    if (text == "full") {
+        return ArrayDumpMode::Full;
+    } else if (text == "rle") {
+        return ArrayDumpMode::RunLength;
+    } else if (text == "summary") {
+        return ArrayDumpMode::Summary;
+    } else if (text == "delta") {
+        return ArrayDumpMode::Delta;
+    }
+    throw std::invalid_argument("Invalid array dump mode: " + text);
+}
@@ -0,0 +1,40 @@
+#ifndef ARRAY_DUMP_H
+#define ARRAY_DUMP_H
+
+#include "array_manager.h"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+enum class ArrayDumpMode {
+    Full,       // every element
+    RunLength,  // "value x count" runs
+    Summary,    // free cells and cells per marker
+    Delta       // indices changed since the previous dump
+};
+
+// Formats array snapshots for the console. Each dump is built in one buffer
+// and written with a single call. Delta mode remembers the previous dump, so
+// keep one dumper per output.
+class ArrayDumper {
+public:
+    explicit ArrayDumper(ArrayDumpMode mode = ArrayDumpMode::Full);
+
+    ArrayDumpMode getMode() const;
+    std::string format(const ArraySnapshot& snapshot);
+    void print(const ArrayManager& arrayManager, std::ostream& out);
+
+private:
+    void formatFull(const std::vector<int>& values, std::string& text) const;
+    void formatRunLength(const std::vector<int>& values, std::string& text) const;
+    void formatSummary(const std::vector<int>& values, std::string& text) const;
+    void formatDelta(const std::vector<int>& values, std::string& text) const;
+
+    ArrayDumpMode mode;
+    std::vector<int> previous;
+    bool hasPrevious;
+};
+
+ArrayDumpMode parseArrayDumpMode(const std::string& text);
+
+#endif
@@ -1,83 +1,810 @@
 #include "array_manager.h"
+#include "array_dump.h"
+#include "scan_kernels.h"
+#include <algorithm>
 #include <iostream>
+#include <numeric>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
-ArrayManager::ArrayManager(size_t size) {
-    try {
-        array.resize(size, 0);
-    } catch (const std::bad_alloc& e) {
-        throw std::runtime_error("Failed to allocate array memory: " + std::string(e.what()));
+template <typename Cell>
+constexpr bool kPlainAtomicCell = sizeof(std::atomic<Cell>) == sizeof(Cell) &&
+                                  std::atomic<Cell>::is_always_lock_free;
+static_assert(kPlainAtomicCell<int> && kPlainAtomicCell<uint16_t> && kPlainAtomicCell<uint8_t>,
+              "Storage is used directly as atomic cells, and scan kernels read them as plain ones");
+
+namespace {
+
+// Above this share of the array it is cheaper to stream the whole array
+// through the reset kernel than to scatter stores over the owned indices.
+constexpr size_t kBulkResetDivisor = 8;
+
+// Retired cells a sweep takes at a time.
+constexpr size_t kSweepChunk = 4096;
+
+// Whole-array snapshot passes attempted before settling for a
+// segment-by-segment copy, and attempts per segment after that before
+// copying under the element locks.
+constexpr size_t kSnapshotAttempts = 8;
+
+template <typename Cell>
+const Cell* plainCells(const std::atomic<Cell>* cells) {
+    return reinterpret_cast<const Cell*>(cells);
+}
+
+template <typename Cell>
+Cell* plainCells(std::atomic<Cell>* cells) {
+    return reinterpret_cast<Cell*>(cells);
+}
+
+// Overloads picking the scan kernel for each cell width.
+size_t countEqual(const int* data, size_t size, int value) {
+    return scanKernels().countEqual(data, size, value);
+}
+
+size_t countEqual(const uint16_t* data, size_t size, uint16_t value) {
+    return scanKernels().halfwords.countEqual(data, size, value);
+}
+
+size_t countEqual(const uint8_t* data, size_t size, uint8_t value) {
+    return scanKernels().bytes.countEqual(data, size, value);
+}
+
+size_t resetEqual(int* data, size_t size, int value) {
+    return scanKernels().resetEqual(data, size, value);
+}
+
+size_t resetEqual(uint16_t* data, size_t size, uint16_t value) {
+    return scanKernels().halfwords.resetEqual(data, size, value);
+}
+
+size_t resetEqual(uint8_t* data, size_t size, uint8_t value) {
+    return scanKernels().bytes.resetEqual(data, size, value);
+}
+
+void histogram(const int* data, size_t size, size_t* bins, size_t binCount) {
+    scanKernels().histogram(data, size, bins, binCount);
+}
+
+void histogram(const uint16_t* data, size_t size, size_t* bins, size_t binCount) {
+    scanKernels().halfwords.histogram(data, size, bins, binCount);
+}
+
+void histogram(const uint8_t* data, size_t size, size_t* bins, size_t binCount) {
+    scanKernels().bytes.histogram(data, size, bins, binCount);
+}
+
+}
+
+size_t cellBytes(CellWidth width) {
+    switch (width) {
+        case CellWidth::Byte:
+            return sizeof(uint8_t);
+        case CellWidth::Halfword:
+            return sizeof(uint16_t);
+        case CellWidth::Word:
+            return sizeof(int);
     }
+    throw std::invalid_argument("Unknown cell width");
 }
 
-ArrayManager::~ArrayManager() = default;
+int maxMarkerValue(CellWidth width) {
+    switch (width) {
+        case CellWidth::Byte:
+            return UINT8_MAX;
+        case CellWidth::Halfword:
+            return UINT16_MAX;
+        case CellWidth::Word:
+            return OwnershipIndex::kMaxMarkerValue;
+    }
+    throw std::invalid_argument("Unknown cell width");
+}
 
-bool ArrayManager::markElement(size_t index, int markerValue) {
-    std::lock_guard<std::mutex> lock(arrayMutex);
+CellWidth narrowestCellWidth(int maxMarker) {
+    if (maxMarker <= maxMarkerValue(CellWidth::Byte)) {
+        return CellWidth::Byte;
+    } else if (maxMarker <= maxMarkerValue(CellWidth::Halfword)) {
+        return CellWidth::Halfword;
+    }
+    return CellWidth::Word;
+}
+
+CellWidth parseCellWidth(const std::string& text) {
+    if (text == "8") {
+        return CellWidth::Byte;
+    } else if (text == "16") {
+        return CellWidth::Halfword;
+    } else if (text == "32") {
+        return CellWidth::Word;
+    }
+    throw std::invalid_argument("Invalid cell width: " + text);
+}
+
+ReleaseMode parseReleaseMode(const std::string& text) {
+    if (text == "eager") {
+        return ReleaseMode::Eager;
+    } else if (text == "lazy") {
+        return ReleaseMode::Lazy;
+    }
+    throw std::invalid_argument("Invalid release mode: " + text);
+}
+
+ArrayManager::ArrayManager(size_t size, ArrayBackend backend, size_t stripeCount,
+                           const StorageOptions& storage, CellWidth width)
+    : array(size, cellBytes(width), storage),
+      width(width),
+      cells(makeCells(array, width)),
+      backend(backend),
+      locking(makeLockPolicy(backend, size, stripeCount)),
+      ownership(size),
+      occupancy(size),
+      sequence(size) {
     
-    if (index >= array.size()) {
-        throw std::out_of_range("Array index out of bounds");
+    if (array.wasReopened()) {
+        rebuildOwnership();
+    }
+}
+
+ArrayManager::~ArrayManager() {
+    // Reopened storage has no retired flags, so nothing retired may be left
+    // in it.
+    sweepRetired();
+}
+
+ArrayManager::LockPolicy ArrayManager::makeLockPolicy(ArrayBackend backend, size_t size,
+                                                      size_t stripeCount) {
+    switch (backend) {
+        case ArrayBackend::GlobalLock:
+            return LockPolicy(std::in_place_type<GlobalLockPolicy>, size, stripeCount);
+        case ArrayBackend::Striped:
+            return LockPolicy(std::in_place_type<StripedLockPolicy>, size, stripeCount);
+        case ArrayBackend::PerElement:
+            return LockPolicy(std::in_place_type<PerElementLockPolicy>, size, stripeCount);
+        case ArrayBackend::LockFree:
+            return LockPolicy(std::in_place_type<LockFreePolicy>, size, stripeCount);
     }
+    throw std::invalid_argument("Unknown array backend");
+}
+
+ArrayManager::Cells ArrayManager::makeCells(ElementStorage& storage, CellWidth width) {
+    switch (width) {
+        case CellWidth::Byte:
+            return CellArray<uint8_t>{static_cast<std::atomic<uint8_t>*>(storage.data())};
+        case CellWidth::Halfword:
+            return CellArray<uint16_t>{static_cast<std::atomic<uint16_t>*>(storage.data())};
+        case CellWidth::Word:
+            return CellArray<int>{static_cast<std::atomic<int>*>(storage.data())};
+    }
+    throw std::invalid_argument("Unknown cell width");
+}
+
+template <typename Policy, typename Cell>
+bool ArrayManager::claimElement(const Policy& policy, CellArray<Cell> cellArray, size_t index,
+                                int markerValue) {
+    [[maybe_unused]] auto guard = policy.lockIndex(index);
+    return claimHeld<Policy>(cellArray, index, markerValue);
+}
+
+template <typename Policy, typename Cell>
+void ArrayManager::releaseElement(const Policy& policy, CellArray<Cell> cellArray, size_t index,
+                                  int markerValue) {
+    [[maybe_unused]] auto guard = policy.lockIndex(index);
+    releaseHeld<Policy>(cellArray, index, markerValue);
+}
+
+template <typename Policy, typename Cell>
+bool ArrayManager::claimHeld(CellArray<Cell> cellArray, size_t index, int markerValue) {
+    std::atomic<Cell>& cell = cellArray.cells[index];
     
-    if (array[index] == 0) {
-        array[index] = markerValue;
-        return true;
+    // Collisions are the common failure; skip the sequence bump for them. A
+    // retired marker's cell is free and is taken over as it stands.
+    const Cell seen = cell.load(std::memory_order_relaxed);
+    if (seen != 0 && !isRetiredValue(seen)) {
+        return false;
     }
     
-    return false;
+    // Sequentially consistent, as SegmentedSeqLock::write() requires.
+    if constexpr (Policy::kLockFree) {
+        const bool claimed = sequence.write(index, [&cell, seen, markerValue] {
+            Cell expected = seen;
+            return cell.compare_exchange_strong(expected, static_cast<Cell>(markerValue));
+        });
+        if (!claimed) {
+            return false;
+        }
+    } else {
+        sequence.write(index, [&cell, markerValue] {
+            cell.store(static_cast<Cell>(markerValue));
+            return true;
+        });
+    }
+    if (seen != 0) {
+        retiredCellCount.fetch_sub(1);
+    }
+    // Set after the claim and cleared before the release, so a bit is never
+    // left clear for a marked cell.
+    if (occupancyTracked.load(std::memory_order_relaxed)) {
+        occupancy.set(index);
+    }
+    return true;
+}
+
+template <typename Policy, typename Cell>
+bool ArrayManager::releaseHeld(CellArray<Cell> cellArray, size_t index, int markerValue) {
+    std::atomic<Cell>& cell = cellArray.cells[index];
+    bool released = true;
+    const bool tracked = occupancyTracked.load(std::memory_order_relaxed);
+    
+    if (tracked) {
+        occupancy.clear(index);
+    }
+    if constexpr (Policy::kLockFree) {
+        Cell expected = static_cast<Cell>(markerValue);
+        released = sequence.write(index, [&cell, &expected] {
+            return cell.compare_exchange_strong(expected, 0);
+        });
+        if (tracked && !released && expected != 0) {
+            occupancy.set(index);
+        }
+    } else {
+        sequence.write(index, [&cell] {
+            cell.store(0);
+            return true;
+        });
+    }
+    return released;
+}
+
+template <typename Policy, typename Cell>
+bool ArrayManager::releaseRetired(const Policy& policy, CellArray<Cell> cellArray, size_t index,
+                                  int markerValue) {
+    [[maybe_unused]] auto guard = policy.lockIndex(index);
+    if (cellArray.cells[index].load(std::memory_order_acquire) != static_cast<Cell>(markerValue)) {
+        return false;
+    }
+    // Lock-free, a marker can still take the cell over before the CAS.
+    return releaseHeld<Policy>(cellArray, index, markerValue);
+}
+
+template <typename Policy, typename Function>
+void ArrayManager::forEachInBatch(const Policy& policy, const std::vector<size_t>& indices,
+                                  bool keepOrder, Function&& function) {
+    std::vector<size_t> order;
+    if (!keepOrder) {
+        order.resize(indices.size());
+        std::iota(order.begin(), order.end(), 0);
+        // Stable, so of two equal indices the earlier position goes first.
+        std::stable_sort(order.begin(), order.end(), [&policy, &indices](size_t a, size_t b) {
+            return std::make_pair(policy.lockKey(indices[a]), indices[a]) <
+                   std::make_pair(policy.lockKey(indices[b]), indices[b]);
+        });
+    }
+    
+    std::optional<decltype(policy.lockIndex(0))> guard;
+    size_t heldKey = 0;
+    for (size_t step = 0; step < indices.size(); ++step) {
+        const size_t position = keepOrder ? step : order[step];
+        const size_t index = indices[position];
+        const size_t key = policy.lockKey(index);
+        if (!guard || key != heldKey) {
+            guard.reset();
+            guard.emplace(policy.lockIndex(index));
+            heldKey = key;
+        }
+        if (!function(position, index)) {
+            return;
+        }
+    }
+}
+
+template <typename Function>
+auto ArrayManager::withAllLocked(Function&& function) const {
+    return std::visit([&function](const auto& policy) {
+        [[maybe_unused]] auto guard = policy.lockAll();
+        return function();
+    }, locking);
+}
+
+bool ArrayManager::markElement(size_t index, int markerValue) {
+    checkIndex(index);
+    checkMarkerValue(markerValue);
+    
+    // Lock order is always owner record, then the policy's element lock. The
+    // record lock is per marker, so markers never contend on it.
+    auto& record = ownership.obtain(markerValue);
+    std::lock_guard<std::mutex> ownerLock(record.recordMutex);
+    checkNotRetired(markerValue);
+    
+    const bool claimed = std::visit([&](const auto& policy, auto cellArray) {
+        return claimElement(policy, cellArray, index, markerValue);
+    }, locking, cells);
+    
+    if (claimed) {
+        ownership.add(record, index);
+    }
+    return claimed;
 }
 
 bool ArrayManager::resetElement(size_t index, int markerValue) {
-    std::lock_guard<std::mutex> lock(arrayMutex);
+    checkIndex(index);
+    checkMarkerValue(markerValue);
     
-    if (index >= array.size()) {
-        throw std::out_of_range("Array index out of bounds");
+    auto& record = ownership.obtain(markerValue);
+    std::lock_guard<std::mutex> ownerLock(record.recordMutex);
+    
+    // Only the owner's record lock lets a cell holding markerValue change,
+    // so checking before releasing it cannot race.
+    if (getElementAt(index) != markerValue) {
+        return false;
     }
     
-    if (array[index] == markerValue) {
-        array[index] = 0;
-        return true;
+    ownership.remove(record, index);
+    std::visit([&](const auto& policy, auto cellArray) {
+        releaseElement(policy, cellArray, index, markerValue);
+    }, locking, cells);
+    
+    return true;
+}
+
+BatchMarkResult ArrayManager::markElements(const std::vector<size_t>& indices, int markerValue,
+                                           bool stopAtCollision) {
+    for (size_t index : indices) {
+        checkIndex(index);
     }
+    checkMarkerValue(markerValue);
+    
+    BatchMarkResult result;
+    result.claimed.assign(indices.size(), false);
     
-    return false;
+    auto& record = ownership.obtain(markerValue);
+    std::lock_guard<std::mutex> ownerLock(record.recordMutex);
+    checkNotRetired(markerValue);
+    
+    std::visit([&](const auto& policy, auto cellArray) {
+        using Policy = std::decay_t<decltype(policy)>;
+        forEachInBatch(policy, indices, stopAtCollision, [&](size_t position, size_t index) {
+            const bool claimed = claimHeld<Policy>(cellArray, index, markerValue);
+            result.claimed[position] = claimed;
+            return claimed || !stopAtCollision;
+        });
+    }, locking, cells);
+    
+    result.firstCollision = indices.size();
+    for (size_t position = 0; position < indices.size(); ++position) {
+        if (result.claimed[position]) {
+            ownership.add(record, indices[position]);
+            ++result.marked;
+        } else if (result.firstCollision == indices.size()) {
+            result.firstCollision = position;
+        }
+    }
+    return result;
+}
+
+size_t ArrayManager::resetElements(const std::vector<size_t>& indices, int markerValue) {
+    for (size_t index : indices) {
+        checkIndex(index);
+    }
+    checkMarkerValue(markerValue);
+    
+    auto& record = ownership.obtain(markerValue);
+    std::lock_guard<std::mutex> ownerLock(record.recordMutex);
+    // The cells still hold the value, but no longer belong to the record.
+    if (isRetiredValue(markerValue)) {
+        return 0;
+    }
+    
+    size_t released = 0;
+    std::visit([&](const auto& policy, auto cellArray) {
+        using Policy = std::decay_t<decltype(policy)>;
+        forEachInBatch(policy, indices, false, [&](size_t, size_t index) {
+            // As in resetElement(), the record lock keeps the check valid.
+            if (cellArray.cells[index].load(std::memory_order_acquire) == markerValue) {
+                ownership.remove(record, index);
+                releaseHeld<Policy>(cellArray, index, markerValue);
+                ++released;
+            }
+            return true;
+        });
+    }, locking, cells);
+    return released;
+}
+
+std::optional<size_t> ArrayManager::claimAnyFree(int markerValue, size_t hint) {
+    checkIndex(hint);
+    checkMarkerValue(markerValue);
+    checkOccupancyTracked();
+    
+    auto& record = ownership.obtain(markerValue);
+    std::lock_guard<std::mutex> ownerLock(record.recordMutex);
+    checkNotRetired(markerValue);
+    
+    std::optional<size_t> claimed;
+    auto search = [&](const auto& policy, auto cellArray) {
+        // [hint, size) first, then [0, hint). Another marker can take a
+        // candidate before it is claimed; the search then goes on past it.
+        size_t from = hint;
+        size_t end = array.size();
+        for (int pass = 0; pass < 2 && !claimed; ++pass) {
+            for (size_t index = occupancy.findFree(from); index < end;
+                 index = occupancy.findFree(index + 1)) {
+                if (claimElement(policy, cellArray, index, markerValue)) {
+                    claimed = index;
+                    break;
+                }
+            }
+            from = 0;
+            end = hint;
+        }
+    };
+    std::visit(search, locking, cells);
+    // Retired cells keep their bits until they are swept, so an empty search
+    // sweeps and looks again. Sweeping takes element locks only, which keeps
+    // the record-then-element lock order.
+    while (!claimed && retiredCellCount.load() > 0) {
+        if (sweepRetired() == 0) {
+            std::this_thread::yield();
+        }
+        std::visit(search, locking, cells);
+    }
+    
+    if (claimed) {
+        ownership.add(record, *claimed);
+    }
+    return claimed;
 }
 
 size_t ArrayManager::countMarkedElements(int markerValue) const {
-    std::lock_guard<std::mutex> lock(arrayMutex);
+    return ownership.count(markerValue);
+}
+
+size_t ArrayManager::resetMarkedElements(int markerValue) {
+    checkMarkerValue(markerValue);
+    auto& record = ownership.obtain(markerValue);
+    std::lock_guard<std::mutex> ownerLock(record.recordMutex);
+    
+    const std::vector<size_t> owned = ownership.takeAll(record);
+    // Nothing to reset, so no reader needs to retry either.
+    if (owned.empty()) {
+        return 0;
+    }
     
-    size_t count = 0;
-    for (size_t i = 0; i < array.size(); ++i) {
-        if (array[i] == markerValue) {
-            ++count;
+    // A marker's cells disappear from snapshots all at once.
+    sequence.beginBulkWrite();
+    if (owned.size() > array.size() / kBulkResetDivisor) {
+        if (occupancyTracked.load(std::memory_order_relaxed)) {
+            for (size_t index : owned) {
+                occupancy.clear(index);
+            }
+        }
+        // Only the owner can change cells holding markerValue and we hold its
+        // record lock, so the kernel's plain stores cannot lose other writes.
+        withAllLocked([this, markerValue] {
+            std::visit([this, markerValue](auto cellArray) {
+                using Cell = typename decltype(cellArray)::CellType;
+                resetEqual(plainCells(cellArray.cells), array.size(), static_cast<Cell>(markerValue));
+            }, cells);
+            std::atomic_thread_fence(std::memory_order_release);
+        });
+    } else {
+        for (size_t index : owned) {
+            std::visit([&](const auto& policy, auto cellArray) {
+                releaseElement(policy, cellArray, index, markerValue);
+            }, locking, cells);
         }
     }
+    sequence.endBulkWrite();
     
-    return count;
+    return owned.size();
 }
 
-void ArrayManager::printArray() const {
-    std::lock_guard<std::mutex> lock(arrayMutex);
+size_t ArrayManager::retireMarkedElements(int markerValue) {
+    checkMarkerValue(markerValue);
+    auto& record = ownership.obtain(markerValue);
+    std::lock_guard<std::mutex> ownerLock(record.recordMutex);
+    
+    // Swapping the list out is O(1); the cells are left for the sweep.
+    std::vector<size_t> owned = ownership.takeAll(record);
+    const size_t count = owned.size();
+    // Nothing to drain, so there is nothing to flag either.
+    if (count == 0) {
+        return 0;
+    }
+    // Counted before the flag is set, so takeovers never run it below zero.
+    retiredCellCount.fetch_add(count);
     
-    std::cout << "Array contents: [";
-    for (size_t i = 0; i < array.size(); ++i) {
-        std::cout << array[i];
-        if (i < array.size() - 1) {
-            std::cout << ", ";
+    // Queued along with the flag, so a sweep finishing an older batch of
+    // this value cannot clear the flag in between.
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    // Like a bulk reset, the cells disappear from snapshots all at once.
+    sequence.beginBulkWrite();
+    record.retired.store(true, std::memory_order_release);
+    sequence.endBulkWrite();
+    retiredQueue.push_back(std::make_shared<RetiredCells>(RetiredCells{markerValue, std::move(owned), 0, 0}));
+    return count;
+}
+
+size_t ArrayManager::sweepRetired() {
+    size_t swept = 0;
+    while (true) {
+        std::shared_ptr<RetiredCells> batch;
+        size_t begin = 0;
+        size_t end = 0;
+        {
+            std::lock_guard<std::mutex> lock(retiredMutex);
+            // Skips batches whose chunks are all handed out already.
+            const auto open = std::find_if(retiredQueue.rbegin(), retiredQueue.rend(),
+                                           [](const std::shared_ptr<RetiredCells>& cells) {
+                return cells->next < cells->indices.size();
+            });
+            if (open == retiredQueue.rend()) {
+                return swept;
+            }
+            batch = *open;
+            begin = batch->next;
+            end = std::min(begin + kSweepChunk, batch->indices.size());
+            batch->next = end;
+            ++batch->chunksInFlight;
         }
+        
+        for (size_t position = begin; position < end; ++position) {
+            const size_t index = batch->indices[position];
+            const bool released = std::visit([&](const auto& policy, auto cellArray) {
+                return releaseRetired(policy, cellArray, index, batch->markerValue);
+            }, locking, cells);
+            if (released) {
+                retiredCellCount.fetch_sub(1);
+                ++swept;
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        if (--batch->chunksInFlight == 0 && batch->next == batch->indices.size()) {
+            finishRetiredBatch(batch);
+        }
+    }
+}
+
+void ArrayManager::finishRetiredBatch(const std::shared_ptr<RetiredCells>& batch) {
+    retiredQueue.erase(std::find(retiredQueue.begin(), retiredQueue.end(), batch));
+    // Every cell of the batch was reset or taken over, and the value could
+    // not mark meanwhile, so no cell holds it any more unless another batch
+    // is still pending for it.
+    const bool pending = std::any_of(retiredQueue.begin(), retiredQueue.end(),
+                                     [batch](const std::shared_ptr<RetiredCells>& cells) {
+        return cells->markerValue == batch->markerValue;
+    });
+    if (!pending) {
+        ownership.obtain(batch->markerValue).retired.store(false, std::memory_order_release);
+    }
+}
+
+bool ArrayManager::isRetired(int markerValue) const {
+    return markerValue > 0 && markerValue <= getMaxMarkerValue() && isRetiredValue(markerValue);
+}
+
+size_t ArrayManager::recountMarkedElements(int markerValue) const {
+    // No cell can hold a value its width cannot represent.
+    if (markerValue < 0 || markerValue > getMaxMarkerValue() || isRetiredValue(markerValue)) {
+        return 0;
+    }
+    return withAllLocked([this, markerValue] {
+        return std::visit([this, markerValue](auto cellArray) {
+            using Cell = typename decltype(cellArray)::CellType;
+            return countEqual(plainCells(cellArray.cells), array.size(), static_cast<Cell>(markerValue));
+        }, cells);
+    });
+}
+
+size_t ArrayManager::sweepMarkedElements(int markerValue) {
+    checkMarkerValue(markerValue);
+    auto& record = ownership.obtain(markerValue);
+    std::lock_guard<std::mutex> ownerLock(record.recordMutex);
+    // Whatever this process recorded is about to be cleared as well.
+    ownership.takeAll(record);
+    // The bitmap is rebuilt from the cells below, which must not hold
+    // retired values by then.
+    sweepRetired();
+    
+    sequence.beginBulkWrite();
+    // The kernel stores only to matching lanes, so cells other markers
+    // claim meanwhile are never overwritten.
+    const size_t released = withAllLocked([this, markerValue] {
+        return std::visit([this, markerValue](auto cellArray) {
+            using Cell = typename decltype(cellArray)::CellType;
+            const size_t count = resetEqual(plainCells(cellArray.cells), array.size(),
+                                            static_cast<Cell>(markerValue));
+            std::atomic_thread_fence(std::memory_order_release);
+            return count;
+        }, cells);
+    });
+    sequence.endBulkWrite();
+    // Marks from other processes never reached the bitmap either; this is
+    // the one place it can catch up with them.
+    rebuildOccupancy();
+    return released;
+}
+
+std::vector<size_t> ArrayManager::markerHistogram(size_t binCount) const {
+    std::vector<size_t> bins(binCount, 0);
+    
+    withAllLocked([this, &bins] {
+        std::visit([this, &bins](auto cellArray) {
+            histogram(plainCells(cellArray.cells), array.size(), bins.data(), bins.size());
+        }, cells);
+    });
+    return bins;
+}
+
+ArraySnapshot ArrayManager::snapshot() const {
+    ArraySnapshot result;
+    result.values.resize(array.size());
+    
+    // Relaxed element loads keep the optimistic copy race-free; the sequence
+    // validation decides whether the copy is kept.
+    int* target = result.values.data();
+    SeqLockRead read = SeqLockRead::Failed;
+    std::visit([&](auto cellArray) {
+        read = sequence.read([this, cellArray, target](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                target[i] = visibleValue(cellArray.cells[i].load(std::memory_order_relaxed));
+            }
+        }, kSnapshotAttempts);
+    }, cells);
+    // Writers kept a segment busy throughout.
+    if (read == SeqLockRead::Failed) {
+        return lockedSnapshot();
     }
-    std::cout << "]" << std::endl;
+    result.consistent = read == SeqLockRead::Consistent;
+    return result;
+}
+
+ArraySnapshot ArrayManager::lockedSnapshot() const {
+    ArraySnapshot result;
+    result.values.resize(array.size());
+    
+    int* target = result.values.data();
+    std::visit([&](const auto& policy, auto cellArray) {
+        using Policy = std::decay_t<decltype(policy)>;
+        [[maybe_unused]] auto guard = policy.lockAll();
+        for (size_t i = 0; i < array.size(); ++i) {
+            target[i] = visibleValue(cellArray.cells[i].load(std::memory_order_acquire));
+        }
+        result.consistent = Policy::kLockAllExcludesWriters;
+    }, locking, cells);
+    return result;
+}
+
+void ArrayManager::printArray() const {
+    ArrayDumper(ArrayDumpMode::Full).print(*this, std::cout);
 }
 
 size_t ArrayManager::getSize() const {
     return array.size();
 }
 
+void ArrayManager::trackOccupancy() {
+    if (occupancyTracked.load()) {
+        return;
+    }
+    occupancyTracked.store(true);
+    rebuildOccupancy();
+}
+
+bool ArrayManager::tracksOccupancy() const {
+    return occupancyTracked.load();
+}
+
+size_t ArrayManager::getOccupiedCount() const {
+    checkOccupancyTracked();
+    // A sweep clears the bit just before uncounting the cell.
+    const size_t occupied = occupancy.getOccupiedCount();
+    const size_t retiredCells = retiredCellCount.load();
+    return occupied > retiredCells ? occupied - retiredCells : 0;
+}
+
+size_t ArrayManager::getFreeCount() const {
+    return array.size() - getOccupiedCount();
+}
+
+bool ArrayManager::isFull() const {
+    return getOccupiedCount() == array.size();
+}
+
 int ArrayManager::getElementAt(size_t index) const {
-    std::lock_guard<std::mutex> lock(arrayMutex);
-    
+    checkIndex(index);
+    return std::visit([this, index](auto cellArray) -> int {
+        return visibleValue(cellArray.cells[index].load(std::memory_order_acquire));
+    }, cells);
+}
+
+ArrayBackend ArrayManager::getBackend() const {
+    return backend;
+}
+
+CellWidth ArrayManager::getCellWidth() const {
+    return width;
+}
+
+int ArrayManager::getMaxMarkerValue() const {
+    return maxMarkerValue(width);
+}
+
+const ElementStorage& ArrayManager::getStorage() const {
+    return array;
+}
+
+void ArrayManager::persist() {
+    sweepRetired();
+    array.persist();
+}
+
+void ArrayManager::checkIndex(size_t index) const {
     if (index >= array.size()) {
         throw std::out_of_range("Array index out of bounds");
     }
-    
-    return array[index];
-}
\ No newline at end of file
+}
+
+void ArrayManager::checkMarkerValue(int markerValue) const {
+    // 0 is the free value, so no marker can own it.
+    if (markerValue < 1) {
+        throw std::invalid_argument("Marker value " + std::to_string(markerValue) + " is not positive");
+    }
+    if (markerValue > getMaxMarkerValue()) {
+        throw std::invalid_argument("Marker value " + std::to_string(markerValue) +
+                                    " does not fit the array's cells");
+    }
+}
+
+void ArrayManager::checkNotRetired(int markerValue) const {
+    if (isRetiredValue(markerValue)) {
+        throw std::invalid_argument("Marker value " + std::to_string(markerValue) + " has been retired");
+    }
+}
+
+bool ArrayManager::isRetiredValue(int value) const {
+    return ownership.isRetired(value);
+}
+
+int ArrayManager::visibleValue(int value) const {
+    return value != 0 && isRetiredValue(value) ? 0 : value;
+}
+
+void ArrayManager::checkOccupancyTracked() const {
+    if (!occupancyTracked.load(std::memory_order_relaxed)) {
+        throw std::logic_error("Occupancy is not tracked for this array");
+    }
+}
+
+void ArrayManager::rebuildOwnership() {
+    // Runs in the constructor, so no marker can race on the records.
+    const int maxMarker = getMaxMarkerValue();
+    std::visit([this, maxMarker](auto cellArray) {
+        for (size_t index = 0; index < array.size(); ++index) {
+            const int value = cellArray.cells[index].load(std::memory_order_relaxed);
+            if (value == 0) {
+                continue;
+            }
+            if (value < 0 || value > maxMarker) {
+                throw std::runtime_error("Corrupt array storage: invalid marker " +
+                                         std::to_string(value) + " at index " + std::to_string(index));
+            }
+            ownership.add(ownership.obtain(value), index);
+        }
+    }, cells);
+}
+
+void ArrayManager::rebuildOccupancy() {
+    if (!occupancyTracked.load()) {
+        return;
+    }
+    std::visit([this](auto cellArray) {
+        occupancy.rebuild([cellArray](size_t index) {
+            return cellArray.cells[index].load(std::memory_order_relaxed) != 0;
+        });
+    }, cells);
+}
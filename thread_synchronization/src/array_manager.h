@@ -1,30 +1,241 @@
 #ifndef ARRAY_MANAGER_H
 #define ARRAY_MANAGER_H
 
+#include "element_storage.h"
+#include "lock_policies.h"
+#include "occupancy_bitmap.h"
+#include "ownership_index.h"
+#include "seqlock.h"
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
+#include <variant>
 #include <vector>
 
+enum class ArrayBackend {
+    GlobalLock,
+    Striped,
+    PerElement,
+    LockFree
+};
+
+// Bytes per array cell. Narrower cells cut the memory every full-array scan
+// has to stream, but cap the marker values the array can hold.
+enum class CellWidth {
+    Byte,       // uint8_t, markers 1..255
+    Halfword,   // uint16_t, markers 1..65535
+    Word        // int, markers 1..2147483647
+};
+
+size_t cellBytes(CellWidth width);
+// Largest marker value a cell of this width can hold.
+int maxMarkerValue(CellWidth width);
+// The narrowest width that holds markers 1..maxMarker.
+CellWidth narrowestCellWidth(int maxMarker);
+// "8", "16" or "32".
+CellWidth parseCellWidth(const std::string& text);
+
+// How a terminated marker's cells are given back.
+enum class ReleaseMode {
+    Eager,  // reset before the others continue, O(cells held)
+    Lazy    // retired in O(1), reset afterwards on access or by a sweeper
+};
+
+// "eager" or "lazy".
+ReleaseMode parseReleaseMode(const std::string& text);
+
+// Outcome of ArrayManager::markElements(), one flag per batch position.
+struct BatchMarkResult {
+    std::vector<bool> claimed;
+    size_t marked = 0;
+    // Batch position of the first index not claimed, or the batch size if
+    // every index was.
+    size_t firstCollision = 0;
+};
+
+struct ArraySnapshot {
+    std::vector<int> values;
+    // True when the copy reflects a single instant. Under sustained writes
+    // the copy may instead be assembled segment by segment, each segment
+    // consistent on its own.
+    bool consistent = false;
+};
+
 class ArrayManager {
 public:
-    explicit ArrayManager(size_t size);
-    ~ArrayManager();
-
+    // stripeCount only applies to ArrayBackend::Striped; 0 selects
+    // StripedLockPolicy::kDefaultStripeCount. Reopened file storage keeps its
+    // marks, and their owners' counts are rebuilt from it; it must have been
+    // written with the same cell width.
+    explicit ArrayManager(size_t size,
+                          ArrayBackend backend = ArrayBackend::GlobalLock,
+                          size_t stripeCount = 0,
+                          const StorageOptions& storage = StorageOptions(),
+                          CellWidth width = CellWidth::Word);
+    virtual ~ArrayManager();
+    
     ArrayManager(const ArrayManager&) = delete;
     ArrayManager& operator=(const ArrayManager&) = delete;
     ArrayManager(ArrayManager&&) = delete;
     ArrayManager& operator=(ArrayManager&&) = delete;
-
-    bool markElement(size_t index, int markerValue);
-    bool resetElement(size_t index, int markerValue);
-    size_t countMarkedElements(int markerValue) const;
-    void printArray() const;
-    size_t getSize() const;
-    int getElementAt(size_t index) const;
+    
+    virtual bool markElement(size_t index, int markerValue);
+    virtual bool resetElement(size_t index, int markerValue);
+    // Batched markElement()/resetElement(): every index is bounds-checked
+    // before any cell changes, the owner's record lock is taken once, and
+    // indices sharing an element lock are handled under one acquisition.
+    // Without stopAtCollision the batch is applied grouped by lock and in
+    // ascending index order; with it, indices are tried in batch order and
+    // none after the first collision is attempted, as a marker would.
+    virtual BatchMarkResult markElements(const std::vector<size_t>& indices, int markerValue,
+                                         bool stopAtCollision = false);
+    // Returns how many of the cells held markerValue and were reset.
+    virtual size_t resetElements(const std::vector<size_t>& indices, int markerValue);
+    // Marks the first free cell at or after hint, wrapping around to the
+    // start, found through the occupancy bitmap instead of by retrying.
+    // Empty once no free cell is left. Needs trackOccupancy().
+    virtual std::optional<size_t> claimAnyFree(int markerValue, size_t hint = 0);
+    virtual size_t countMarkedElements(int markerValue) const;
+    virtual size_t resetMarkedElements(int markerValue);
+    // Releases every cell markerValue holds in O(1) by retiring the marker
+    // value: its cells read as free at once, a marker claiming one takes it
+    // over, and sweepRetired() resets the rest. A retired value cannot mark
+    // again until the sweep has drained all of its cells; trying throws
+    // std::invalid_argument. Returns the number of cells retired.
+    virtual size_t retireMarkedElements(int markerValue);
+    // Resets the cells of retired markers that nobody has taken over yet.
+    // Safe to run alongside markers. Returns how many cells it reset; with
+    // no other sweep running, every retired value is free again afterwards.
+    virtual size_t sweepRetired();
+    bool isRetired(int markerValue) const;
+    // Full-array scans for diagnostics and verification; they bypass the
+    // ownership index and run on the vector kernels from scan_kernels.h. A
+    // retired marker counts 0; the histogram sees its cells until swept.
+    virtual size_t recountMarkedElements(int markerValue) const;
+    virtual std::vector<size_t> markerHistogram(size_t binCount) const;
+    // Resets by full-array scan instead of through the ownership index, for
+    // shared storage whose cells another process marked. Only cells still
+    // holding markerValue change. Retired cells are swept first.
+    virtual size_t sweepMarkedElements(int markerValue);
+    // Copies the array while markers keep running. Writers are only blocked
+    // if some segment never settles, when it falls back to lockedSnapshot().
+    virtual ArraySnapshot snapshot() const;
+    // Copies the array under lockAll(). Consistent only for the global and
+    // striped backends; per-element and lock-free writers keep running.
+    ArraySnapshot lockedSnapshot() const;
+    virtual void printArray() const;
+    virtual size_t getSize() const;
+    virtual int getElementAt(size_t index) const;
+    // Starts keeping the occupancy bitmap, built from the cells as they
+    // stand. Until then marks skip the bitmap entirely, and claimAnyFree()
+    // and the occupancy counts throw std::logic_error. Not safe against
+    // concurrent marking: call it before markers start.
+    void trackOccupancy();
+    bool tracksOccupancy() const;
+    // O(1) from the occupancy bitmap, less the retired cells not yet
+    // swept. Like the ownership index, it only sees marks made through this
+    // process.
+    size_t getOccupiedCount() const;
+    size_t getFreeCount() const;
+    bool isFull() const;
+    ArrayBackend getBackend() const;
+    CellWidth getCellWidth() const;
+    // Marker values above this throw std::invalid_argument.
+    int getMaxMarkerValue() const;
+    const ElementStorage& getStorage() const;
+    // Sweeps retired cells, then flushes file-backed storage to disk; a
+    // no-op for memory storage.
+    void persist();
 
 private:
-    std::vector<int> array;
-    mutable std::mutex arrayMutex;
+    using LockPolicy = std::variant<GlobalLockPolicy, StripedLockPolicy,
+                                    PerElementLockPolicy, LockFreePolicy>;
+    
+    // A typed view of the storage; the width is picked at runtime, so every
+    // cell access dispatches on this alongside the lock policy.
+    template <typename Cell>
+    struct CellArray {
+        using CellType = Cell;
+        std::atomic<Cell>* cells;
+    };
+    using Cells = std::variant<CellArray<int>, CellArray<uint16_t>, CellArray<uint8_t>>;
+    
+    static LockPolicy makeLockPolicy(ArrayBackend backend, size_t size, size_t stripeCount);
+    static Cells makeCells(ElementStorage& storage, CellWidth width);
+    
+    template <typename Policy, typename Cell>
+    bool claimElement(const Policy& policy, CellArray<Cell> cells, size_t index, int markerValue);
+    template <typename Policy, typename Cell>
+    void releaseElement(const Policy& policy, CellArray<Cell> cells, size_t index, int markerValue);
+    // The same, with the element's lock (if the policy has one) already held.
+    template <typename Policy, typename Cell>
+    bool claimHeld(CellArray<Cell> cells, size_t index, int markerValue);
+    // Returns false if a lock-free release found the cell already changed.
+    template <typename Policy, typename Cell>
+    bool releaseHeld(CellArray<Cell> cells, size_t index, int markerValue);
+    // Resets a retired cell unless a marker has taken it over.
+    template <typename Policy, typename Cell>
+    bool releaseRetired(const Policy& policy, CellArray<Cell> cells, size_t index, int markerValue);
+    // Calls function(position, index) for each batch position with the
+    // index's lock held, reusing the lock across consecutive positions with
+    // the same lock key. Stops when function returns false.
+    template <typename Policy, typename Function>
+    void forEachInBatch(const Policy& policy, const std::vector<size_t>& indices, bool keepOrder,
+                        Function&& function);
+    template <typename Function>
+    auto withAllLocked(Function&& function) const;
+    
+    void checkIndex(size_t index) const;
+    void checkMarkerValue(int markerValue) const;
+    // Call with the marker's record lock held, which retiring also takes.
+    void checkNotRetired(int markerValue) const;
+    bool isRetiredValue(int value) const;
+    // What a cell holding value reads as: 0 for a retired marker.
+    int visibleValue(int value) const;
+    void checkOccupancyTracked() const;
+    void rebuildOwnership();
+    void rebuildOccupancy();
+    
+    // Elements are atomic so lock-free policies can CAS them directly and
+    // full-array readers never tear; locking policies only write them while
+    // holding the element's lock.
+    ElementStorage array;
+    const CellWidth width;
+    const Cells cells;
+    const ArrayBackend backend;
+    LockPolicy locking;
+    OwnershipIndex ownership;
+    OccupancyBitmap occupancy;
+    // Set once by trackOccupancy(), before any marker reads it.
+    std::atomic<bool> occupancyTracked{false};
+    // Every element store goes through this so snapshot() can validate its
+    // copy instead of locking.
+    SegmentedSeqLock sequence;
+    
+    // Cells still holding a retired marker value, waiting to be swept. Sweeps
+    // take them a chunk at a time, so several threads can share one batch.
+    // A batch stays queued until its last chunk is done.
+    struct RetiredCells {
+        int markerValue = 0;
+        std::vector<size_t> indices;
+        size_t next = 0;
+        size_t chunksInFlight = 0;
+    };
+    
+    // Removes a fully swept batch and, once no other batch holds its marker
+    // value, clears the value's flag. Call with retiredMutex held.
+    void finishRetiredBatch(const std::shared_ptr<RetiredCells>& batch);
+    
+    // Each marker's OwnershipIndex::Record::retired flag is set while any of
+    // its cells may still hold the value. Set and cleared under retiredMutex.
+    // Retired cells not yet reset or taken over; their occupancy bits are
+    // still set.
+    std::atomic<size_t> retiredCellCount{0};
+    std::mutex retiredMutex;
+    std::vector<std::shared_ptr<RetiredCells>> retiredQueue;
 };
 
-#endif
\ No newline at end of file
+#endif
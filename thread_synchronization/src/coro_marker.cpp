@@ -0,0 +1,263 @@
+#include "coro_marker.h"
+#include "logger.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+CoroRound::CoroRound(CoroExecutor& executor)
+    : startEvent(executor),
+      blockedCountdown(executor, 0),
+      releaseEpoch(executor) {}
+
+CoroMarker::CoroMarker(int id, std::shared_ptr<ArrayManager> arrayManager,
+                       CoroRound& round, CoroExecutor& executor)
+    : id(id),
+      arrayManager(arrayManager),
+      round(round),
+      executor(executor),
+      command(MarkerCommand::Continue),
+      started(false),
+      blocked(false),
+      markedCount(0),
+      totalMarks(0),
+      blockedIndex(0) {
+    
+    if (!arrayManager) {
+        throw std::invalid_argument("Array manager cannot be null");
+    }
+}
+
+void CoroMarker::setPacing(const PacingPolicy& policy) {
+    if (started) {
+        throw std::logic_error("Cannot change pacing of a started marker");
+    }
+    pacing = policy;
+}
+
+void CoroMarker::setAccessPolicy(const AccessPolicy& policy) {
+    if (started) {
+        throw std::logic_error("Cannot change access policy of a started marker");
+    }
+    access = policy;
+}
+
+void CoroMarker::start() {
+    if (started) {
+        throw std::logic_error("Marker already started");
+    }
+    
+    started = true;
+    task = markerLoop();
+    task.start(executor);
+}
+
+void CoroMarker::setPendingCommand(MarkerCommand cmd) {
+    command = cmd;
+}
+
+bool CoroMarker::isStarted() const {
+    return started;
+}
+
+bool CoroMarker::isFinished() const {
+    return task.isDone();
+}
+
+bool CoroMarker::isBlocked() const {
+    return blocked;
+}
+
+int CoroMarker::getId() const {
+    return id;
+}
+
+size_t CoroMarker::getMarkedCount() const {
+    return markedCount;
+}
+
+size_t CoroMarker::getTotalMarks() const {
+    return totalMarks;
+}
+
+size_t CoroMarker::getBlockedIndex() const {
+    return blockedIndex;
+}
+
+CoroTask CoroMarker::markerLoop() {
+    co_await round.startEvent.wait();
+    
+    try {
+        Pacer pacer(pacing, static_cast<uint32_t>(id));
+        IndexGenerator indices(access, arrayManager->getSize(), static_cast<uint64_t>(id));
+        
+        while (true) {
+            const size_t index = indices.next();
+            if (arrayManager->markElement(index, id)) {
+                ++totalMarks;
+                co_await executor.sleepFor(pacer.deferredPace());
+                markedCount = arrayManager->countMarkedElements(id);
+                co_await executor.sleepFor(pacer.deferredPace());
+                continue;
+            }
+            
+            markedCount = arrayManager->countMarkedElements(id);
+            defaultLogger().log(LogLevel::Info, "Marker ", id,
+                                " blocked. Marked elements: ", markedCount,
+                                ", blocked at index: ", index);
+            blockedIndex = index;
+            blocked = true;
+            
+            const uint32_t seenEpoch = round.releaseEpoch.current();
+            round.blockedCountdown.signal();
+            // A shutdown may have set Terminate and released while this
+            // marker was still running; its release is then already spent.
+            if (command != MarkerCommand::Terminate) {
+                co_await round.releaseEpoch.waitForChange(seenEpoch);
+            }
+            blocked = false;
+            
+            if (command == MarkerCommand::Terminate) {
+                arrayManager->resetMarkedElements(id);
+                markedCount = 0;
+                co_return;
+            }
+        }
+    } catch (const std::exception& e) {
+        defaultLogger().log(LogLevel::Error, "Error in coroutine marker ", id, ": ", e.what());
+        // Count as blocked so the current round still completes.
+        round.blockedCountdown.signal();
+    }
+}
+
+CoroMarkerManager::CoroMarkerManager(std::shared_ptr<ArrayManager> arrayManager)
+    : arrayManager(arrayManager),
+      round(executor) {
+    
+    if (!arrayManager) {
+        throw std::invalid_argument("Array manager cannot be null");
+    }
+}
+
+CoroMarkerManager::~CoroMarkerManager() {
+    try {
+        for (const auto& marker : markers) {
+            marker->setPendingCommand(MarkerCommand::Terminate);
+        }
+        round.startEvent.signal();
+        round.releaseEpoch.advance();
+        // Frames may only be destroyed once nothing is left to resume them.
+        executor.run();
+    } catch (const std::exception& e) {
+        defaultLogger().log(LogLevel::Error, "Error during coroutine marker shutdown: ", e.what());
+    }
+}
+
+void CoroMarkerManager::setPacing(const PacingPolicy& policy) {
+    pacing = policy;
+}
+
+void CoroMarkerManager::setAccessPolicy(const AccessPolicy& policy) {
+    access = policy;
+}
+
+void CoroMarkerManager::createMarkers(int count) {
+    if (count <= 0) {
+        throw std::invalid_argument("Marker count must be positive");
+    }
+    
+    const int firstId = static_cast<int>(markers.size()) + 1;
+    if (count > arrayManager->getMaxMarkerValue() - firstId + 1) {
+        throw std::invalid_argument("Marker ids would not fit the array's cells");
+    }
+    markers.reserve(markers.size() + static_cast<size_t>(count));
+    for (int id = firstId; id < firstId + count; ++id) {
+        auto marker = std::make_unique<CoroMarker>(id, arrayManager, round, executor);
+        marker->setPacing(pacing);
+        marker->setAccessPolicy(access);
+        markers.push_back(std::move(marker));
+    }
+}
+
+void CoroMarkerManager::startAllMarkers() {
+    round.blockedCountdown.reset(static_cast<int>(markers.size()));
+    
+    for (const auto& marker : markers) {
+        if (!marker->isStarted()) {
+            marker->start();
+        }
+    }
+    round.startEvent.signal();
+}
+
+void CoroMarkerManager::waitForAllMarkersBlocked() {
+    if (!executor.runUntil([this] { return round.blockedCountdown.isSet(); })) {
+        throw std::logic_error("Markers stopped before every one of them blocked");
+    }
+    dropFinishedMarkers();
+}
+
+void CoroMarkerManager::terminateMarker(int id) {
+    auto it = std::find_if(markers.begin(), markers.end(),
+                           [id](const auto& marker) { return marker->getId() == id; });
+    if (it == markers.end()) {
+        throw std::invalid_argument("Marker " + std::to_string(id) + " is not active");
+    }
+    
+    // The marker is suspended, so its cells are released here instead of
+    // resuming it; it sees the Terminate command at the next release.
+    (*it)->setPendingCommand(MarkerCommand::Terminate);
+    arrayManager->resetMarkedElements(id);
+    
+    retiredMarks += (*it)->getTotalMarks();
+    retiredMarkers.push_back(std::move(*it));
+    markers.erase(it);
+}
+
+void CoroMarkerManager::continueOtherMarkers() {
+    round.blockedCountdown.reset(static_cast<int>(markers.size()));
+    round.releaseEpoch.advance();
+}
+
+bool CoroMarkerManager::areAllMarkersFinished() const {
+    return markers.empty();
+}
+
+size_t CoroMarkerManager::getActiveMarkerCount() const {
+    return markers.size();
+}
+
+std::vector<int> CoroMarkerManager::getActiveMarkerIds() const {
+    std::vector<int> ids;
+    ids.reserve(markers.size());
+    for (const auto& marker : markers) {
+        ids.push_back(marker->getId());
+    }
+    return ids;
+}
+
+CoroMarker* CoroMarkerManager::findMarkerById(int id) {
+    for (const auto& marker : markers) {
+        if (marker->getId() == id) {
+            return marker.get();
+        }
+    }
+    return nullptr;
+}
+
+size_t CoroMarkerManager::getTotalMarks() const {
+    size_t total = retiredMarks;
+    for (const auto& marker : markers) {
+        total += marker->getTotalMarks();
+    }
+    return total;
+}
+
+const CoroExecutor& CoroMarkerManager::getExecutor() const {
+    return executor;
+}
+
+void CoroMarkerManager::dropFinishedMarkers() {
+    retiredMarkers.erase(std::remove_if(retiredMarkers.begin(), retiredMarkers.end(),
+                                        [](const auto& marker) { return marker->isFinished(); }),
+                         retiredMarkers.end());
+}
@@ -0,0 +1,118 @@
+#ifndef CORO_MARKER_H
+#define CORO_MARKER_H
+
+// Requires C++20; only the targets built with THREAD_SYNC_COROUTINES include
+// this header.
+
+#include "array_manager.h"
+#include "coro_sync.h"
+#include "index_generator.h"
+#include "marker_thread.h"
+#include "pacing.h"
+#include <memory>
+#include <vector>
+
+// RoundControl for coroutine markers: the same start gate, blocked countdown
+// and release epoch, awaited instead of waited on.
+struct CoroRound {
+    explicit CoroRound(CoroExecutor& executor);
+    
+    AsyncEvent startEvent;
+    AsyncCountdownEvent blockedCountdown;
+    AsyncEpochEvent releaseEpoch;
+};
+
+// The MarkerThread loop as a coroutine. Waiting for the start, a release or
+// a pacing sleep suspends the coroutine on the executor instead of blocking
+// a thread, so a marker costs its frame and this object rather than a stack.
+// Markers keep totals only, not the histograms of MarkerStats.
+class CoroMarker {
+public:
+    CoroMarker(int id, std::shared_ptr<ArrayManager> arrayManager,
+               CoroRound& round, CoroExecutor& executor);
+    
+    CoroMarker(const CoroMarker&) = delete;
+    CoroMarker& operator=(const CoroMarker&) = delete;
+    CoroMarker(CoroMarker&&) = delete;
+    CoroMarker& operator=(CoroMarker&&) = delete;
+    
+    // Must be called before start().
+    void setPacing(const PacingPolicy& policy);
+    void setAccessPolicy(const AccessPolicy& policy);
+    // Schedules the marker; it first waits for the round's start event.
+    void start();
+    // Acted on at the next release.
+    void setPendingCommand(MarkerCommand command);
+    bool isStarted() const;
+    bool isFinished() const;
+    bool isBlocked() const;
+    int getId() const;
+    size_t getMarkedCount() const;
+    // Successful marks over the marker's lifetime, including released ones.
+    size_t getTotalMarks() const;
+    size_t getBlockedIndex() const;
+
+private:
+    CoroTask markerLoop();
+    
+    int id;
+    std::shared_ptr<ArrayManager> arrayManager;
+    CoroRound& round;
+    CoroExecutor& executor;
+    PacingPolicy pacing;
+    AccessPolicy access;
+    MarkerCommand command;
+    bool started;
+    bool blocked;
+    size_t markedCount;
+    size_t totalMarks;
+    size_t blockedIndex;
+    CoroTask task;
+};
+
+// ThreadManager's round protocol for coroutine markers. Every marker runs on
+// one executor, driven by whichever thread calls into the manager, so
+// waitForAllMarkersBlocked() is where the markers actually run.
+class CoroMarkerManager {
+public:
+    explicit CoroMarkerManager(std::shared_ptr<ArrayManager> arrayManager);
+    // Terminates every marker and runs them until they have all exited.
+    ~CoroMarkerManager();
+    
+    CoroMarkerManager(const CoroMarkerManager&) = delete;
+    CoroMarkerManager& operator=(const CoroMarkerManager&) = delete;
+    CoroMarkerManager(CoroMarkerManager&&) = delete;
+    CoroMarkerManager& operator=(CoroMarkerManager&&) = delete;
+    
+    // Both apply to markers created afterwards.
+    void setPacing(const PacingPolicy& policy);
+    void setAccessPolicy(const AccessPolicy& policy);
+    void createMarkers(int count);
+    void startAllMarkers();
+    // Runs the markers until every active one has blocked.
+    void waitForAllMarkersBlocked();
+    void terminateMarker(int id);
+    void continueOtherMarkers();
+    bool areAllMarkersFinished() const;
+    size_t getActiveMarkerCount() const;
+    std::vector<int> getActiveMarkerIds() const;
+    CoroMarker* findMarkerById(int id);
+    size_t getTotalMarks() const;
+    const CoroExecutor& getExecutor() const;
+
+private:
+    void dropFinishedMarkers();
+    
+    std::shared_ptr<ArrayManager> arrayManager;
+    // Declared before the markers so it outlives every coroutine frame.
+    CoroExecutor executor;
+    CoroRound round;
+    std::vector<std::unique_ptr<CoroMarker>> markers;
+    PacingPolicy pacing;
+    AccessPolicy access;
+    // Terminated markers stay suspended until the next release lets them exit.
+    std::vector<std::unique_ptr<CoroMarker>> retiredMarkers;
+    size_t retiredMarks = 0;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "coro_sync.h"
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+CoroExecutor::CoroExecutor() : timerSequence(0), resumes(0) {}
+
+void CoroExecutor::schedule(std::coroutine_handle<> handle) {
+    if (!handle) {
+        throw std::invalid_argument("Coroutine handle cannot be null");
+    }
+    ready.push_back(handle);
+}
+
+void CoroExecutor::scheduleAt(std::coroutine_handle<> handle, Clock::time_point deadline) {
+    if (!handle) {
+        throw std::invalid_argument("Coroutine handle cannot be null");
+    }
+    timers.push({deadline, timerSequence++, handle});
+}
+
+void CoroExecutor::run() {
+    while (resumeNext()) {
+    }
+}
+
+size_t CoroExecutor::getReadyCount() const {
+    return ready.size();
+}
+
+size_t CoroExecutor::getSleepingCount() const {
+    return timers.size();
+}
+
+uint64_t CoroExecutor::getResumes() const {
+    return resumes;
+}
+
+CoroExecutor::YieldAwaiter CoroExecutor::yield() {
+    return {*this};
+}
+
+CoroExecutor::SleepAwaiter CoroExecutor::sleepFor(std::chrono::microseconds delay) {
+    return {*this, delay};
+}
+
+bool CoroExecutor::resumeNext() {
+    // Due timers join the ready queue first, so a busy queue cannot starve
+    // sleepers.
+    if (!timers.empty()) {
+        const auto now = Clock::now();
+        while (!timers.empty() && timers.top().deadline <= now) {
+            ready.push_back(timers.top().handle);
+            timers.pop();
+        }
+    }
+    
+    if (ready.empty()) {
+        if (timers.empty()) {
+            return false;
+        }
+        // Nothing else can make a coroutine ready on this thread.
+        std::this_thread::sleep_until(timers.top().deadline);
+        ready.push_back(timers.top().handle);
+        timers.pop();
+    }
+    
+    const std::coroutine_handle<> handle = ready.front();
+    ready.pop_front();
+    ++resumes;
+    handle.resume();
+    return true;
+}
+
+CoroTask::CoroTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+CoroTask::CoroTask(CoroTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+CoroTask& CoroTask::operator=(CoroTask&& other) noexcept {
+    if (this != &other) {
+        if (handle) {
+            handle.destroy();
+        }
+        handle = std::exchange(other.handle, nullptr);
+    }
+    return *this;
+}
+
+CoroTask::~CoroTask() {
+    if (handle) {
+        handle.destroy();
+    }
+}
+
+void CoroTask::start(CoroExecutor& executor) {
+    if (!handle) {
+        throw std::logic_error("Cannot start an empty coroutine task");
+    }
+    executor.schedule(handle);
+}
+
+bool CoroTask::isDone() const {
+    return handle && handle.done();
+}
+
+void CoroTask::rethrowIfFailed() const {
+    if (isDone() && handle.promise().exception) {
+        std::rethrow_exception(handle.promise().exception);
+    }
+}
+
+CoroWaitList::CoroWaitList(CoroExecutor& executor) : executor(executor) {}
+
+void CoroWaitList::add(std::coroutine_handle<> handle) {
+    waiters.push_back(handle);
+}
+
+void CoroWaitList::resumeAll() {
+    for (const auto handle : waiters) {
+        executor.schedule(handle);
+    }
+    waiters.clear();
+}
+
+size_t CoroWaitList::size() const {
+    return waiters.size();
+}
+
+AsyncEvent::AsyncEvent(CoroExecutor& executor) : signaled(false), waiters(executor) {}
+
+void AsyncEvent::signal() {
+    signaled = true;
+    waiters.resumeAll();
+}
+
+void AsyncEvent::reset() {
+    signaled = false;
+}
+
+bool AsyncEvent::isSignaled() const {
+    return signaled;
+}
+
+AsyncEvent::Awaiter AsyncEvent::wait() {
+    return {*this};
+}
+
+AsyncCountdownEvent::AsyncCountdownEvent(CoroExecutor& executor, int initialCount)
+    : remaining(initialCount), waiters(executor) {
+    if (initialCount < 0) {
+        throw std::invalid_argument("Initial count cannot be negative");
+    }
+}
+
+void AsyncCountdownEvent::addCount(int count) {
+    if (remaining == 0) {
+        throw std::logic_error("Cannot add to a countdown event that has already been signaled");
+    }
+    remaining += count;
+}
+
+void AsyncCountdownEvent::signal() {
+    if (remaining > 0 && --remaining == 0) {
+        waiters.resumeAll();
+    }
+}
+
+bool AsyncCountdownEvent::isSet() const {
+    return remaining == 0;
+}
+
+void AsyncCountdownEvent::reset(int count) {
+    if (count < 0) {
+        throw std::invalid_argument("Count cannot be negative");
+    }
+    remaining = count;
+    if (remaining == 0) {
+        waiters.resumeAll();
+    }
+}
+
+AsyncCountdownEvent::Awaiter AsyncCountdownEvent::wait() {
+    return {*this};
+}
+
+AsyncEpochEvent::AsyncEpochEvent(CoroExecutor& executor) : epoch(0), waiters(executor) {}
+
+uint32_t AsyncEpochEvent::current() const {
+    return epoch;
+}
+
+uint32_t AsyncEpochEvent::advance() {
+    ++epoch;
+    waiters.resumeAll();
+    return epoch;
+}
+
+AsyncEpochEvent::Awaiter AsyncEpochEvent::waitForChange(uint32_t seenEpoch) {
+    return {*this, seenEpoch};
+}
@@ -0,0 +1,222 @@
+#ifndef CORO_SYNC_H
+#define CORO_SYNC_H
+
+// Requires C++20; only the targets built with THREAD_SYNC_COROUTINES include
+// this header.
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <queue>
+#include <vector>
+
+// Runs coroutines on the thread that calls run(). Resumed coroutines wait in
+// a FIFO ready queue and sleeping ones in a timer queue, so suspending costs
+// a queue push rather than a context switch. Nothing here is thread-safe:
+// the executor, the events built on it and every coroutine they resume
+// belong to that one thread.
+class CoroExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    struct YieldAwaiter {
+        CoroExecutor& executor;
+        
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { executor.schedule(handle); }
+        void await_resume() const noexcept {}
+    };
+    
+    struct SleepAwaiter {
+        CoroExecutor& executor;
+        std::chrono::microseconds delay;
+        
+        bool await_ready() const noexcept { return delay.count() <= 0; }
+        void await_suspend(std::coroutine_handle<> handle) {
+            executor.scheduleAt(handle, Clock::now() + delay);
+        }
+        void await_resume() const noexcept {}
+    };
+    
+    CoroExecutor();
+    
+    CoroExecutor(const CoroExecutor&) = delete;
+    CoroExecutor& operator=(const CoroExecutor&) = delete;
+    
+    void schedule(std::coroutine_handle<> handle);
+    void scheduleAt(std::coroutine_handle<> handle, Clock::time_point deadline);
+    // Resumes coroutines until none are ready or sleeping.
+    void run();
+    // Resumes coroutines until done() holds or none are left; returns done().
+    template <typename Done>
+    bool runUntil(Done done);
+    size_t getReadyCount() const;
+    size_t getSleepingCount() const;
+    // Coroutine resumptions so far.
+    uint64_t getResumes() const;
+    
+    // co_await yield() lets every coroutine already ready run first.
+    YieldAwaiter yield();
+    // co_await sleepFor(delay) resumes after delay; zero does not suspend.
+    SleepAwaiter sleepFor(std::chrono::microseconds delay);
+
+private:
+    struct Timer {
+        Clock::time_point deadline;
+        uint64_t sequence;
+        std::coroutine_handle<> handle;
+        
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+    
+    // Resumes one coroutine, sleeping until the earliest timer if none is
+    // ready; false when nothing is left to resume.
+    bool resumeNext();
+    
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t timerSequence;
+    uint64_t resumes;
+};
+
+template <typename Done>
+bool CoroExecutor::runUntil(Done done) {
+    while (!done()) {
+        if (!resumeNext()) {
+            return done();
+        }
+    }
+    return true;
+}
+
+// A coroutine that starts suspended and runs once start() hands it to an
+// executor. The task owns the coroutine frame; it may only be destroyed
+// while the coroutine is finished or not scheduled anywhere.
+class CoroTask {
+public:
+    struct promise_type {
+        std::exception_ptr exception;
+        
+        CoroTask get_return_object() {
+            return CoroTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_always final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+    
+    CoroTask() = default;
+    CoroTask(CoroTask&& other) noexcept;
+    CoroTask& operator=(CoroTask&& other) noexcept;
+    ~CoroTask();
+    
+    CoroTask(const CoroTask&) = delete;
+    CoroTask& operator=(const CoroTask&) = delete;
+    
+    void start(CoroExecutor& executor);
+    // True once the coroutine has returned or thrown; false for an empty task.
+    bool isDone() const;
+    // Rethrows whatever escaped a finished coroutine.
+    void rethrowIfFailed() const;
+
+private:
+    explicit CoroTask(std::coroutine_handle<promise_type> handle);
+    
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Coroutines suspended on one condition. resumeAll() schedules them on the
+// executor in arrival order rather than resuming them inline, so whoever
+// signals keeps running until it suspends itself.
+class CoroWaitList {
+public:
+    explicit CoroWaitList(CoroExecutor& executor);
+    
+    void add(std::coroutine_handle<> handle);
+    void resumeAll();
+    size_t size() const;
+
+private:
+    CoroExecutor& executor;
+    std::vector<std::coroutine_handle<>> waiters;
+};
+
+// Event for coroutines: co_await wait() suspends until signal().
+class AsyncEvent {
+public:
+    struct Awaiter {
+        AsyncEvent& event;
+        
+        bool await_ready() const noexcept { return event.signaled; }
+        void await_suspend(std::coroutine_handle<> handle) { event.waiters.add(handle); }
+        void await_resume() const noexcept {}
+    };
+    
+    explicit AsyncEvent(CoroExecutor& executor);
+    
+    void signal();
+    void reset();
+    bool isSignaled() const;
+    Awaiter wait();
+
+private:
+    bool signaled;
+    CoroWaitList waiters;
+};
+
+// CountdownEvent for coroutines: co_await wait() suspends until the count
+// reaches zero.
+class AsyncCountdownEvent {
+public:
+    struct Awaiter {
+        AsyncCountdownEvent& event;
+        
+        bool await_ready() const noexcept { return event.remaining == 0; }
+        void await_suspend(std::coroutine_handle<> handle) { event.waiters.add(handle); }
+        void await_resume() const noexcept {}
+    };
+    
+    AsyncCountdownEvent(CoroExecutor& executor, int initialCount);
+    
+    void addCount(int count = 1);
+    void signal();
+    bool isSet() const;
+    void reset(int count);
+    Awaiter wait();
+
+private:
+    int remaining;
+    CoroWaitList waiters;
+};
+
+// EpochEvent for coroutines: co_await waitForChange(seen) suspends until the
+// epoch moves past seen, and advance() resumes every such waiter at once.
+class AsyncEpochEvent {
+public:
+    struct Awaiter {
+        AsyncEpochEvent& event;
+        uint32_t seenEpoch;
+        
+        bool await_ready() const noexcept { return event.epoch != seenEpoch; }
+        void await_suspend(std::coroutine_handle<> handle) { event.waiters.add(handle); }
+        void await_resume() const noexcept {}
+    };
+    
+    explicit AsyncEpochEvent(CoroExecutor& executor);
+    
+    uint32_t current() const;
+    uint32_t advance();
+    Awaiter waitForChange(uint32_t seenEpoch);
+
+private:
+    uint32_t epoch;
+    CoroWaitList waiters;
+};
+
+#endif
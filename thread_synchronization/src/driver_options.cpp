@@ -0,0 +1,226 @@
+#include "driver_options.h"
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+
+std::string trim(const std::string& text) {
+    const size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) {
+        return "";
+    }
+    const size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+unsigned long long parseUnsigned(const std::string& key, const std::string& value,
+                                 unsigned long long min, unsigned long long max) {
+    size_t pos = 0;
+    unsigned long long parsed = 0;
+    try {
+        if (value.empty() || value[0] == '-') {
+            throw std::invalid_argument(value);
+        }
+        parsed = std::stoull(value, &pos);
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Invalid value for " + key + ": " + value);
+    }
+    
+    if (pos != value.size() || parsed < min || parsed > max) {
+        throw std::invalid_argument("Invalid value for " + key + ": " + value + ". Valid range is [" +
+                                    std::to_string(min) + ", " + std::to_string(max) + "]");
+    }
+    return parsed;
+}
+
+}
+
+void applyDriverOption(DriverOptions& options, const std::string& key, const std::string& value) {
+    if (key == "array-size") {
+        options.arraySize = static_cast<size_t>(parseUnsigned(key, value, 1, SIZE_MAX));
+    } else if (key == "markers") {
+        options.markerCount = static_cast<int>(parseUnsigned(key, value, 1, maxMarkerValue(CellWidth::Word)));
+    } else if (key == "rounds") {
+        options.roundLimit = static_cast<size_t>(parseUnsigned(key, value, 0, SIZE_MAX));
+    } else if (key == "seed") {
+        options.seed = static_cast<uint32_t>(parseUnsigned(key, value, 0, UINT32_MAX));
+    } else if (key == "batch") {
+        options.markBatch = static_cast<size_t>(parseUnsigned(key, value, 1, SIZE_MAX));
+    } else if (key == "claim") {
+        options.claim = parseClaimMode(value);
+    } else if (key == "release") {
+        options.release = parseReleaseMode(value);
+    } else if (key == "stripes") {
+        options.stripeCount = static_cast<size_t>(parseUnsigned(key, value, 1, SIZE_MAX));
+    } else if (key == "storage") {
+        const HugePageMode hugePages = options.storage.hugePages;
+        const NumaPlacement numa = options.storage.numa;
+        options.storage = parseStorageOptions(value);
+        options.storage.hugePages = hugePages;
+        options.storage.numa = numa;
+    } else if (key == "huge-pages") {
+        options.storage.hugePages = parseHugePageMode(value);
+    } else if (key == "numa") {
+        options.storage.numa = parseNumaPlacement(value);
+    } else if (key == "execution") {
+        if (value == "threads") {
+            options.execution = ExecutionMode::Threads;
+        } else if (value == "processes") {
+#ifdef THREAD_SYNC_PROCESSES
+            options.execution = ExecutionMode::Processes;
+#else
+            throw std::invalid_argument("--execution processes is not supported on this platform");
+#endif
+        } else if (value == "pool") {
+            options.execution = ExecutionMode::Pool;
+            options.poolWorkers = 0;
+        } else if (value.rfind("pool:", 0) == 0) {
+            options.execution = ExecutionMode::Pool;
+            options.poolWorkers = static_cast<size_t>(parseUnsigned(key, value.substr(5), 1, 4096));
+        } else {
+            throw std::invalid_argument("Invalid execution: " + value);
+        }
+    } else if (key == "affinity") {
+        options.affinity = parseAffinityPolicy(value);
+    } else if (key == "cell-width") {
+        if (value == "auto") {
+            options.cellWidth.reset();
+        } else {
+            options.cellWidth = parseCellWidth(value);
+        }
+    } else if (key == "pacing") {
+        options.pacing = parsePacingPolicy(value);
+    } else if (key == "access") {
+        options.access = parseAccessPolicy(value);
+    } else if (key == "trace") {
+        options.tracePath = value;
+    } else if (key == "log-level") {
+        options.logLevel = parseLogLevel(value);
+    } else if (key == "log-overflow") {
+        options.logOverflow = parseLogOverflow(value);
+    } else if (key == "terminate") {
+        options.termination = parseTerminationChoice(value);
+    } else if (key == "verbosity") {
+        if (value == "quiet") {
+            options.verbosity = Verbosity::Quiet;
+        } else if (value == "rounds") {
+            options.verbosity = Verbosity::Rounds;
+        } else if (value == "full") {
+            options.verbosity = Verbosity::Full;
+        } else {
+            throw std::invalid_argument("Invalid value for verbosity: " + value);
+        }
+    } else if (key == "dump") {
+        options.dumpMode = parseArrayDumpMode(value);
+    } else if (key == "backend") {
+        if (value == "global") {
+            options.backend = ArrayBackend::GlobalLock;
+        } else if (value == "striped") {
+            options.backend = ArrayBackend::Striped;
+        } else if (value == "per-element") {
+            options.backend = ArrayBackend::PerElement;
+        } else if (value == "lock-free") {
+            options.backend = ArrayBackend::LockFree;
+        } else {
+            throw std::invalid_argument("Invalid value for backend: " + value);
+        }
+    } else {
+        throw std::invalid_argument("Unknown option: " + key);
+    }
+}
+
+void loadDriverConfig(DriverOptions& options, const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::invalid_argument("Cannot open config file: " + path);
+    }
+    
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        
+        const size_t separator = line.find('=');
+        if (separator == std::string::npos) {
+            throw std::invalid_argument("Malformed config line: " + line);
+        }
+        applyDriverOption(options, trim(line.substr(0, separator)), trim(line.substr(separator + 1)));
+    }
+}
+
+DriverOptions parseDriverOptions(const std::vector<std::string>& args) {
+    DriverOptions options;
+    
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg.rfind("--", 0) != 0) {
+            throw std::invalid_argument("Unexpected argument: " + arg);
+        }
+        
+        options.headless = true;
+        const std::string key = arg.substr(2);
+        if (key == "help") {
+            options.showHelp = true;
+            continue;
+        }
+        if (key == "headless") {
+            continue;
+        }
+        
+        if (i + 1 >= args.size()) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        const std::string& value = args[++i];
+        
+        if (key == "config") {
+            loadDriverConfig(options, value);
+        } else {
+            applyDriverOption(options, key, value);
+        }
+    }
+    
+    return options;
+}
+
+void printDriverUsage(std::ostream& out, const char* program) {
+    out << "Usage: " << program << " [options]\n"
+        << "Without options the program runs interactively.\n\n"
+        << "  --headless               run without prompts using the defaults below\n"
+        << "  --config FILE            read key=value options from FILE\n"
+        << "  --array-size N           number of array elements (default 100)\n"
+        << "  --markers N              number of marker threads (default 4); at most 255 with\n"
+        << "                           --cell-width 8, 65535 with 16, 2147483647 with 32,\n"
+        << "                           and 65535 with --execution processes\n"
+        << "  --rounds N               stop after N rounds, 0 = until all terminated (default 0)\n"
+        << "  --terminate POLICY       first | last | most | fewest | oldest | round-robin | random\n"
+        << "                           victim each round (default first)\n"
+        << "  --seed N                 seed for random termination (default 1)\n"
+        << "  --verbosity LEVEL        quiet | rounds | full (default quiet)\n"
+        << "  --dump MODE              full | rle | summary | delta array dumps at full verbosity\n"
+        << "  --backend NAME           global | striped | per-element | lock-free (default global)\n"
+        << "  --stripes N              stripe count for the striped backend\n"
+        << "  --storage KIND           heap | anon | shm | file:PATH | reopen:PATH (default heap)\n"
+        << "  --huge-pages MODE        none | thp | explicit (default none)\n"
+        << "  --numa PLACEMENT         default | first-touch | interleave array pages over nodes\n"
+        << "  --execution MODE         threads | pool[:WORKERS] | processes (default threads)\n"
+        << "                           processes needs a POSIX host\n"
+        << "  --affinity POLICY        none | compact | scatter | cpus:LIST (default none)\n"
+        << "  --cell-width BITS        auto | 8 | 16 | 32 bits per array cell (default auto)\n"
+        << "  --pacing MODE            none | spin:CYCLES | sleep:US[:JITTER_US] (default sleep:5000)\n"
+        << "  --access PATTERN         uniform | zipf[:S] | sequential | strided[:N] (default uniform)\n"
+        << "  --batch K                indices each marker draws and marks at once (default 1)\n"
+        << "  --claim MODE             drawn | nearest free cell from the drawn index (default drawn)\n"
+        << "  --release MODE           eager | lazy reset of a terminated marker's cells (default eager)\n"
+        << "  --trace FILE             record a binary event trace to FILE\n"
+        << "  --log-level LEVEL        debug | info | warning | error | off (default warning\n"
+        << "                           when quiet, info otherwise)\n"
+        << "  --log-overflow POLICY    drop | block when the log queue is full (default drop)\n"
+        << "  --help                   show this message\n";
+}
+
+LogLevel effectiveLogLevel(const DriverOptions& options) {
+    return options.logLevel.value_or(options.verbosity == Verbosity::Quiet ? LogLevel::Warning : LogLevel::Info);
+}
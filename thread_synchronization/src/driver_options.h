@@ -0,0 +1,75 @@
+#ifndef DRIVER_OPTIONS_H
+#define DRIVER_OPTIONS_H
+
+#include "array_dump.h"
+#include "array_manager.h"
+#include "index_generator.h"
+#include "logger.h"
+#include "pacing.h"
+#include "placement.h"
+#include "victim_policy.h"
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class ExecutionMode {
+    Threads,    // a thread per marker
+    Pool,       // markers as tasks on a work-stealing pool
+    Processes   // a forked process per marker, sharing the array
+};
+
+enum class Verbosity {
+    Quiet,      // summary line only
+    Rounds,     // one line per round
+    Full        // per-round lines plus array dumps
+};
+
+// Settings for a run of the marker protocol. Defaults describe the
+// interactive mode; any command-line flag switches to headless mode.
+struct DriverOptions {
+    bool headless = false;
+    bool showHelp = false;
+    size_t arraySize = 100;
+    int markerCount = 4;
+    // Maximum number of block/terminate/continue rounds; 0 runs until every
+    // marker has been terminated.
+    size_t roundLimit = 0;
+    TerminationChoice termination = TerminationChoice::First;
+    uint32_t seed = 1;
+    Verbosity verbosity = Verbosity::Quiet;
+    // How full verbosity dumps the array each round.
+    ArrayDumpMode dumpMode = ArrayDumpMode::Full;
+    ArrayBackend backend = ArrayBackend::GlobalLock;
+    size_t stripeCount = 0;
+    StorageOptions storage;
+    // Unset picks the narrowest width that holds every marker id.
+    std::optional<CellWidth> cellWidth;
+    PacingPolicy pacing;
+    AccessPolicy access;
+    // Indices each marker draws and submits together; 1 marks one at a time.
+    size_t markBatch = 1;
+    ClaimMode claim = ClaimMode::Drawn;
+    ReleaseMode release = ReleaseMode::Eager;
+    AffinityPolicy affinity;
+    ExecutionMode execution = ExecutionMode::Threads;
+    // Pool execution only; 0 starts one worker per CPU.
+    size_t poolWorkers = 0;
+    // Binary event trace destination; empty disables tracing.
+    std::string tracePath;
+    // Unset follows the verbosity: warning when quiet, info otherwise.
+    std::optional<LogLevel> logLevel;
+    LogOverflow logOverflow = LogOverflow::Drop;
+};
+
+// Parses "--key value" flags and "--config FILE" (key=value lines, '#'
+// comments). Throws std::invalid_argument on unknown keys or bad values.
+DriverOptions parseDriverOptions(const std::vector<std::string>& args);
+void applyDriverOption(DriverOptions& options, const std::string& key, const std::string& value);
+void loadDriverConfig(DriverOptions& options, const std::string& path);
+void printDriverUsage(std::ostream& out, const char* program);
+// The explicit --log-level, or the level the verbosity implies.
+LogLevel effectiveLogLevel(const DriverOptions& options);
+
+#endif
@@ -0,0 +1,423 @@
+#include "element_storage.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define STORAGE_HAS_MMAP 1
+#endif
+
+namespace {
+
+constexpr char kArrayMagic[8] = {'T', 'S', 'A', 'R', 'R', 'A', 'Y', '\0'};
+constexpr uint32_t kArrayVersion = 1;
+// Cells start one page in so they keep page alignment.
+constexpr size_t kHeaderBytes = 4096;
+constexpr size_t kHugePageSize = size_t(2) << 20;
+
+struct ArrayFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t cellBytes;
+    uint64_t elementCount;
+};
+
+std::string systemError(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+// Checks an array file's header against the array about to map it, reading
+// only, so a wrong path is rejected before anything writes to it.
+void checkArrayFile(const std::string& path, size_t count, size_t cellBytes) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Cannot open array file " + path);
+    }
+    const auto fileBytes = static_cast<uint64_t>(in.tellg());
+    ArrayFileHeader header{};
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kArrayMagic, sizeof(kArrayMagic)) != 0) {
+        throw std::runtime_error("Not an array file: " + path);
+    }
+    if (header.version != kArrayVersion) {
+        throw std::runtime_error("Unsupported array file: " + path);
+    }
+    if (header.cellBytes != cellBytes) {
+        throw std::runtime_error("Array file " + path + " holds " + std::to_string(header.cellBytes) +
+                                 "-byte cells, not " + std::to_string(cellBytes));
+    }
+    if (header.elementCount != count) {
+        throw std::runtime_error("Array file " + path + " holds " + std::to_string(header.elementCount) +
+                                 " elements, not " + std::to_string(count));
+    }
+    if (fileBytes < kHeaderBytes + count * cellBytes) {
+        throw std::runtime_error("Array file " + path + " is truncated");
+    }
+}
+
+#ifdef STORAGE_HAS_MMAP
+void adviseHugePages([[maybe_unused]] void* base, [[maybe_unused]] size_t bytes) {
+#ifdef MADV_HUGEPAGE
+    // Advisory only; kernels without THP simply ignore the range.
+    madvise(base, bytes, MADV_HUGEPAGE);
+#endif
+}
+#endif
+
+}
+
+MappedRegion::~MappedRegion() {
+    release();
+}
+
+MappedRegion::MappedRegion(MappedRegion&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedRegion& MappedRegion::operator=(MappedRegion&& other) noexcept {
+    if (this != &other) {
+        release();
+        base = other.base;
+        length = other.length;
+        mappedLength = other.mappedLength;
+        mapped = other.mapped;
+        fileBacked = other.fileBacked;
+        hugePages = other.hugePages;
+        other.base = nullptr;
+        other.length = 0;
+        other.mappedLength = 0;
+    }
+    return *this;
+}
+
+MappedRegion MappedRegion::heap(size_t bytes) {
+    MappedRegion region;
+    // calloc hands large blocks straight from fresh zero pages, so they are
+    // not touched until used.
+    region.base = std::calloc(bytes == 0 ? 1 : bytes, 1);
+    if (!region.base) {
+        throw std::runtime_error("Failed to allocate array memory: " + std::to_string(bytes) + " bytes");
+    }
+    region.length = bytes;
+    return region;
+}
+
+MappedRegion MappedRegion::anonymous(size_t bytes, HugePageMode hugePages) {
+#ifdef STORAGE_HAS_MMAP
+    MappedRegion region;
+    region.length = bytes;
+    region.mappedLength = bytes == 0 ? 1 : bytes;
+
+#ifdef MAP_HUGETLB
+    if (hugePages == HugePageMode::Explicit) {
+        // Without MAP_NORESERVE the mapping fails up front when the pool is
+        // short, instead of faulting with SIGBUS on first touch.
+        const size_t rounded = (region.mappedLength + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+        void* base = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) {
+            region.base = base;
+            region.mappedLength = rounded;
+            region.mapped = true;
+            region.hugePages = HugePageMode::Explicit;
+            return region;
+        }
+        // No reserved huge pages: use transparent ones instead.
+    }
+#endif
+
+    void* base = mmap(nullptr, region.mappedLength, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error(systemError("Failed to map " + std::to_string(bytes) + " bytes"));
+    }
+    region.base = base;
+    region.mapped = true;
+    if (hugePages != HugePageMode::None) {
+        adviseHugePages(base, region.mappedLength);
+        region.hugePages = HugePageMode::Transparent;
+    }
+    return region;
+#else
+    (void)hugePages;
+    return heap(bytes);
+#endif
+}
+
+MappedRegion MappedRegion::file(const std::string& path, size_t bytes, bool reopen,
+                                HugePageMode hugePages) {
+#ifdef STORAGE_HAS_MMAP
+    if (hugePages == HugePageMode::Explicit) {
+        throw std::invalid_argument("Explicit huge pages are only available for anonymous storage");
+    }
+    
+    const int fd = open(path.c_str(), reopen ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(systemError("Cannot open array file " + path));
+    }
+    
+    struct stat status {};
+    if (fstat(fd, &status) != 0) {
+        const std::string message = systemError("Cannot size array file " + path);
+        close(fd);
+        throw std::runtime_error(message);
+    }
+    if (static_cast<size_t>(status.st_size) < bytes) {
+        if (reopen) {
+            close(fd);
+            throw std::runtime_error("Array file " + path + " is truncated");
+        }
+        if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            const std::string message = systemError("Cannot size array file " + path);
+            close(fd);
+            throw std::runtime_error(message);
+        }
+    }
+    
+    MappedRegion region;
+    region.length = bytes;
+    region.mappedLength = bytes;
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error(systemError("Cannot map array file " + path));
+    }
+    
+    region.base = base;
+    region.mapped = true;
+    region.fileBacked = true;
+    if (hugePages == HugePageMode::Transparent) {
+        adviseHugePages(base, bytes);
+        region.hugePages = HugePageMode::Transparent;
+    }
+    return region;
+#else
+    (void)bytes;
+    (void)reopen;
+    (void)hugePages;
+    throw std::runtime_error("File-backed storage is not supported on this platform: " + path);
+#endif
+}
+
+MappedRegion MappedRegion::shared(size_t bytes, HugePageMode hugePages) {
+#ifdef STORAGE_HAS_MMAP
+    if (hugePages == HugePageMode::Explicit) {
+        throw std::invalid_argument("Explicit huge pages are only available for anonymous storage");
+    }
+    
+    // The name only has to be unique until it is unlinked below.
+    static std::atomic<unsigned> segmentCounter{0};
+    const std::string name = "/thread_sync." + std::to_string(getpid()) + "." +
+                             std::to_string(segmentCounter.fetch_add(1));
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        throw std::runtime_error(systemError("Cannot create shared memory segment " + name));
+    }
+    shm_unlink(name.c_str());
+    
+    MappedRegion region;
+    region.length = bytes;
+    region.mappedLength = bytes == 0 ? 1 : bytes;
+    if (ftruncate(fd, static_cast<off_t>(region.mappedLength)) != 0) {
+        const std::string message = systemError("Cannot size shared memory segment");
+        close(fd);
+        throw std::runtime_error(message);
+    }
+    void* base = mmap(nullptr, region.mappedLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error(systemError("Cannot map shared memory segment"));
+    }
+    
+    region.base = base;
+    region.mapped = true;
+    if (hugePages == HugePageMode::Transparent) {
+        // Only honoured when shmem THP is enabled.
+        adviseHugePages(base, region.mappedLength);
+        region.hugePages = HugePageMode::Transparent;
+    }
+    return region;
+#else
+    (void)bytes;
+    (void)hugePages;
+    throw std::runtime_error("Shared memory storage is not supported on this platform");
+#endif
+}
+
+void* MappedRegion::data() const {
+    return base;
+}
+
+size_t MappedRegion::size() const {
+    return length;
+}
+
+HugePageMode MappedRegion::getHugePages() const {
+    return hugePages;
+}
+
+void MappedRegion::sync() {
+#ifdef STORAGE_HAS_MMAP
+    if (fileBacked && base && msync(base, mappedLength, MS_SYNC) != 0) {
+        throw std::runtime_error(systemError("Failed to sync array file"));
+    }
+#endif
+}
+
+void MappedRegion::release() {
+    if (!base) {
+        return;
+    }
+#ifdef STORAGE_HAS_MMAP
+    if (mapped) {
+        munmap(base, mappedLength);
+        base = nullptr;
+        return;
+    }
+#endif
+    std::free(base);
+    base = nullptr;
+}
+
+ElementStorage::ElementStorage(size_t count, size_t cellBytes, const StorageOptions& options)
+    : kind(options.kind),
+      cells(nullptr),
+      count(count),
+      cellBytes(cellBytes),
+      numa(NumaPlacement::Default),
+      reopened(false) {
+    
+    if (cellBytes == 0 || count > (SIZE_MAX - kHeaderBytes) / cellBytes) {
+        throw std::invalid_argument("Array size too large");
+    }
+    const size_t arrayBytes = count * cellBytes;
+    
+    switch (options.kind) {
+        case StorageKind::Heap:
+            region = MappedRegion::heap(arrayBytes);
+            cells = region.data();
+            break;
+        case StorageKind::Anonymous:
+            region = MappedRegion::anonymous(arrayBytes, options.hugePages);
+            cells = region.data();
+            break;
+        case StorageKind::Shared:
+            region = MappedRegion::shared(arrayBytes, options.hugePages);
+            cells = region.data();
+            break;
+        case StorageKind::File: {
+            if (options.path.empty()) {
+                throw std::invalid_argument("File storage needs a path");
+            }
+            if (options.reopen) {
+                checkArrayFile(options.path, count, cellBytes);
+            }
+            region = MappedRegion::file(options.path, kHeaderBytes + arrayBytes, options.reopen,
+                                        options.hugePages);
+            
+            if (options.reopen) {
+                reopened = true;
+            } else {
+                // A fresh file reads as zeros.
+                auto* header = static_cast<ArrayFileHeader*>(region.data());
+                std::memcpy(header->magic, kArrayMagic, sizeof(kArrayMagic));
+                header->version = kArrayVersion;
+                header->cellBytes = static_cast<uint32_t>(cellBytes);
+                header->elementCount = count;
+            }
+            cells = static_cast<char*>(region.data()) + kHeaderBytes;
+            break;
+        }
+    }
+    // Zero-filled memory is a valid array of atomic zeros on every supported
+    // compiler; constructing each cell would touch every page up front.
+    
+    switch (options.numa) {
+        case NumaPlacement::Default:
+            break;
+        case NumaPlacement::FirstTouch:
+            // File pages are only read, so reopened marks survive.
+            firstTouchMemory(cells, arrayBytes, options.kind != StorageKind::File, systemTopology());
+            numa = NumaPlacement::FirstTouch;
+            break;
+        case NumaPlacement::Interleave:
+            if (interleaveMemory(cells, arrayBytes, systemTopology())) {
+                numa = NumaPlacement::Interleave;
+            }
+            break;
+    }
+}
+
+ElementStorage::~ElementStorage() {
+    try {
+        persist();
+    } catch (const std::exception&) {
+        // The mapping is still written back by the kernel eventually.
+    }
+}
+
+StorageKind ElementStorage::getKind() const {
+    return kind;
+}
+
+bool ElementStorage::isShared() const {
+    return kind == StorageKind::File || kind == StorageKind::Shared;
+}
+
+HugePageMode ElementStorage::getHugePages() const {
+    return region.getHugePages();
+}
+
+NumaPlacement ElementStorage::getNumaPlacement() const {
+    return numa;
+}
+
+bool ElementStorage::wasReopened() const {
+    return reopened;
+}
+
+void ElementStorage::persist() {
+    region.sync();
+}
+
+StorageOptions parseStorageOptions(const std::string& text) {
+    StorageOptions options;
+    if (text == "heap") {
+        options.kind = StorageKind::Heap;
+    } else if (text == "anon") {
+        options.kind = StorageKind::Anonymous;
+    } else if (text == "shm") {
+        options.kind = StorageKind::Shared;
+    } else if (text.rfind("file:", 0) == 0 && text.size() > 5) {
+        options.kind = StorageKind::File;
+        options.path = text.substr(5);
+    } else if (text.rfind("reopen:", 0) == 0 && text.size() > 7) {
+        options.kind = StorageKind::File;
+        options.path = text.substr(7);
+        options.reopen = true;
+    } else {
+        throw std::invalid_argument("Invalid storage: " + text);
+    }
+    return options;
+}
+
+HugePageMode parseHugePageMode(const std::string& text) {
+    if (text == "none") {
+        return HugePageMode::None;
+    } else if (text == "thp") {
+        return HugePageMode::Transparent;
+    } else if (text == "explicit") {
+        return HugePageMode::Explicit;
+    }
+    throw std::invalid_argument("Invalid huge page mode: " + text);
+}
@@ -0,0 +1,114 @@
+#ifndef ELEMENT_STORAGE_H
+#define ELEMENT_STORAGE_H
+
+#include <cstddef>
+#include "placement.h"
+#include <cstdint>
+#include <string>
+
+enum class StorageKind {
+    Heap,       // zero-filled heap block
+    Anonymous,  // private anonymous mapping, pages populated on first touch
+    File,       // shared file mapping that outlives the process
+    Shared      // POSIX shared memory, visible to forked child processes
+};
+
+enum class HugePageMode {
+    None,
+    Transparent,    // madvise(MADV_HUGEPAGE)
+    Explicit        // MAP_HUGETLB, falling back to Transparent if none are reserved
+};
+
+struct StorageOptions {
+    StorageKind kind = StorageKind::Heap;
+    HugePageMode hugePages = HugePageMode::None;
+    NumaPlacement numa = NumaPlacement::Default;
+    // File storage only.
+    std::string path;
+    // Keep the file's contents instead of starting from a zeroed array.
+    bool reopen = false;
+};
+
+// A zero-filled block of memory that owns its allocation or mapping.
+class MappedRegion {
+public:
+    MappedRegion() = default;
+    ~MappedRegion();
+    
+    MappedRegion(const MappedRegion&) = delete;
+    MappedRegion& operator=(const MappedRegion&) = delete;
+    MappedRegion(MappedRegion&& other) noexcept;
+    MappedRegion& operator=(MappedRegion&& other) noexcept;
+    
+    static MappedRegion heap(size_t bytes);
+    // Falls back to the heap where mmap is unavailable.
+    static MappedRegion anonymous(size_t bytes, HugePageMode hugePages);
+    // Maps the whole file. A fresh file is created or truncated, then grown
+    // to bytes; growth is sparse, so untouched pages cost no disk space.
+    // Reopening needs an existing file of at least bytes and never creates,
+    // truncates or grows it.
+    static MappedRegion file(const std::string& path, size_t bytes, bool reopen,
+                             HugePageMode hugePages);
+    // A shm_open segment, unlinked as soon as it is mapped: processes forked
+    // afterwards share it, and it disappears with the last of them.
+    static MappedRegion shared(size_t bytes, HugePageMode hugePages);
+    
+    void* data() const;
+    size_t size() const;
+    // Huge page mode actually in effect.
+    HugePageMode getHugePages() const;
+    // Writes dirty pages of a file mapping back to disk.
+    void sync();
+
+private:
+    void release();
+    
+    void* base = nullptr;
+    size_t length = 0;
+    size_t mappedLength = 0;
+    bool mapped = false;
+    bool fileBacked = false;
+    HugePageMode hugePages = HugePageMode::None;
+};
+
+// The ArrayManager's cells, cellBytes wide each. File storage starts with a
+// header page recording the cell width and element count, so a later run can
+// reopen and check them.
+class ElementStorage {
+public:
+    ElementStorage(size_t count, size_t cellBytes, const StorageOptions& options);
+    ~ElementStorage();
+    
+    ElementStorage(const ElementStorage&) = delete;
+    ElementStorage& operator=(const ElementStorage&) = delete;
+    
+    void* data() { return cells; }
+    const void* data() const { return cells; }
+    size_t size() const { return count; }
+    size_t getCellBytes() const { return cellBytes; }
+    
+    StorageKind getKind() const;
+    // True when forked processes see each other's writes to the cells.
+    bool isShared() const;
+    HugePageMode getHugePages() const;
+    // NUMA placement actually in effect.
+    NumaPlacement getNumaPlacement() const;
+    // True when existing file contents were kept.
+    bool wasReopened() const;
+    void persist();
+
+private:
+    StorageKind kind;
+    MappedRegion region;
+    void* cells;
+    size_t count;
+    size_t cellBytes;
+    NumaPlacement numa;
+    bool reopened;
+};
+
+// "heap", "anon", "shm", "file:PATH" (fresh) or "reopen:PATH" (keep contents).
+StorageOptions parseStorageOptions(const std::string& text);
+HugePageMode parseHugePageMode(const std::string& text);
+
+#endif
@@ -0,0 +1,231 @@
+#include "index_generator.h"
+#include <cmath>
+#include <stdexcept>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// 64x64 -> 128-bit multiply: returns the low half, stores the high half.
+uint64_t multiplyWide(uint64_t a, uint64_t b, uint64_t& high) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 Uint128;
+    const Uint128 product = static_cast<Uint128>(a) * b;
+    high = static_cast<uint64_t>(product >> 64);
+    return static_cast<uint64_t>(product);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return _umul128(a, b, &high);
+#else
+    // Schoolbook on 32-bit halves.
+    const uint64_t aLow = a & 0xFFFFFFFFu;
+    const uint64_t aHigh = a >> 32;
+    const uint64_t bLow = b & 0xFFFFFFFFu;
+    const uint64_t bHigh = b >> 32;
+    const uint64_t lowLow = aLow * bLow;
+    const uint64_t lowHigh = aLow * bHigh;
+    const uint64_t highLow = aHigh * bLow;
+    const uint64_t cross = (lowLow >> 32) + (lowHigh & 0xFFFFFFFFu) + highLow;
+    high = aHigh * bHigh + (lowHigh >> 32) + (cross >> 32);
+    return (cross << 32) | (lowLow & 0xFFFFFFFFu);
+#endif
+}
+
+uint64_t splitMix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// log1p(x) / x, accurate near zero.
+double helper1(double x) {
+    return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+// expm1(x) / x, accurate near zero.
+double helper2(double x) {
+    return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+double hIntegral(double x, double exponent) {
+    const double logX = std::log(x);
+    return helper2((1.0 - exponent) * logX) * logX;
+}
+
+double h(double x, double exponent) {
+    return std::exp(-exponent * std::log(x));
+}
+
+double hIntegralInverse(double x, double exponent) {
+    double t = x * (1.0 - exponent);
+    if (t < -1.0) {
+        t = -1.0;
+    }
+    return std::exp(helper1(t) * x);
+}
+
+double parseDouble(const std::string& text, const std::string& original) {
+    size_t pos = 0;
+    double value = 0;
+    try {
+        value = std::stod(text, &pos);
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Invalid access pattern: " + original);
+    }
+    if (pos != text.size()) {
+        throw std::invalid_argument("Invalid access pattern: " + original);
+    }
+    return value;
+}
+
+}
+
+Xoshiro256::Xoshiro256(uint64_t seed) {
+    for (auto& word : state) {
+        word = splitMix64(seed);
+    }
+}
+
+uint64_t Xoshiro256::operator()() {
+    const uint64_t result = rotl(state[1] * 5, 7) * 9;
+    const uint64_t t = state[1] << 17;
+    
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+    
+    return result;
+}
+
+uint64_t Xoshiro256::below(uint64_t bound) {
+    uint64_t high = 0;
+    uint64_t low = multiplyWide((*this)(), bound, high);
+    if (low < bound) {
+        // 2^64 mod bound, without negating an unsigned value.
+        const uint64_t threshold = (~bound + 1) % bound;
+        while (low < threshold) {
+            low = multiplyWide((*this)(), bound, high);
+        }
+    }
+    return high;
+}
+
+double Xoshiro256::unit() {
+    return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+}
+
+AccessPolicy parseAccessPolicy(const std::string& text) {
+    const size_t colon = text.find(':');
+    const std::string name = text.substr(0, colon);
+    const bool hasArgument = colon != std::string::npos;
+    const std::string argument = hasArgument ? text.substr(colon + 1) : "";
+    
+    AccessPolicy policy;
+    if (name == "uniform" && !hasArgument) {
+        policy.pattern = AccessPattern::Uniform;
+    } else if (name == "sequential" && !hasArgument) {
+        policy.pattern = AccessPattern::Sequential;
+    } else if (name == "zipf") {
+        policy.pattern = AccessPattern::Zipf;
+        if (hasArgument) {
+            policy.zipfExponent = parseDouble(argument, text);
+        }
+        if (!(policy.zipfExponent > 0.0)) {
+            throw std::invalid_argument("Zipf exponent must be positive: " + text);
+        }
+    } else if (name == "strided") {
+        policy.pattern = AccessPattern::Strided;
+        if (hasArgument) {
+            const double stride = parseDouble(argument, text);
+            if (stride < 1.0 || stride != std::floor(stride)) {
+                throw std::invalid_argument("Stride must be a positive integer: " + text);
+            }
+            policy.stride = static_cast<size_t>(stride);
+        }
+    } else {
+        throw std::invalid_argument("Invalid access pattern: " + text);
+    }
+    return policy;
+}
+
+ClaimMode parseClaimMode(const std::string& text) {
+    if (text == "drawn") {
+        return ClaimMode::Drawn;
+    } else if (text == "nearest") {
+        return ClaimMode::Nearest;
+    }
+    throw std::invalid_argument("Invalid claim mode: " + text);
+}
+
+IndexGenerator::IndexGenerator(const AccessPolicy& policy, size_t size, uint64_t seed)
+    : policy(policy),
+      size(size),
+      rng(seed),
+      cursor(0),
+      hIntegralX1(0),
+      hIntegralElements(0),
+      squeeze(0) {
+    
+    if (size == 0) {
+        throw std::invalid_argument("Index generator needs a non-empty array");
+    }
+    
+    cursor = static_cast<size_t>(rng.below(size));
+    
+    if (policy.pattern == AccessPattern::Zipf) {
+        const double s = policy.zipfExponent;
+        hIntegralX1 = hIntegral(1.5, s) - 1.0;
+        hIntegralElements = hIntegral(static_cast<double>(size) + 0.5, s);
+        squeeze = 2.0 - hIntegralInverse(hIntegral(2.5, s) - h(2.0, s), s);
+    }
+}
+
+size_t IndexGenerator::next() {
+    switch (policy.pattern) {
+        case AccessPattern::Uniform:
+            return static_cast<size_t>(rng.below(size));
+        case AccessPattern::Zipf:
+            return nextZipf();
+        case AccessPattern::Sequential: {
+            const size_t index = cursor;
+            cursor = cursor + 1 == size ? 0 : cursor + 1;
+            return index;
+        }
+        case AccessPattern::Strided: {
+            const size_t index = cursor;
+            cursor = (cursor + policy.stride) % size;
+            return index;
+        }
+    }
+    return 0;
+}
+
+size_t IndexGenerator::nextZipf() {
+    const double s = policy.zipfExponent;
+    const double n = static_cast<double>(size);
+    
+    while (true) {
+        const double u = hIntegralElements + rng.unit() * (hIntegralX1 - hIntegralElements);
+        const double x = hIntegralInverse(u, s);
+        double k = std::floor(x + 0.5);
+        if (k < 1.0) {
+            k = 1.0;
+        } else if (k > n) {
+            k = n;
+        }
+        
+        if (k - x <= squeeze || u >= hIntegral(k + 0.5, s) - h(k, s)) {
+            // Rank 1 is the hottest element and lives at index 0.
+            return static_cast<size_t>(k) - 1;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef INDEX_GENERATOR_H
+#define INDEX_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// xoshiro256** seeded through splitmix64. Each marker owns one, so index
+// generation shares no state between threads and is reproducible per id.
+class Xoshiro256 {
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed);
+
+    uint64_t operator()();
+    // Uniform in [0, bound) without modulo bias (Lemire's method).
+    uint64_t below(uint64_t bound);
+    // Uniform in [0, 1).
+    double unit();
+
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return UINT64_MAX; }
+
+private:
+    uint64_t state[4];
+};
+
+enum class AccessPattern {
+    Uniform,      // every index equally likely
+    Zipf,         // low indices are hot, P(rank k) ~ 1 / k^zipfExponent
+    Sequential,   // consecutive indices from a per-marker starting point
+    Strided       // every stride-th index from a per-marker starting point
+};
+
+struct AccessPolicy {
+    AccessPattern pattern = AccessPattern::Uniform;
+    double zipfExponent = 1.0;
+    size_t stride = 16;
+};
+
+// Parses "uniform", "zipf[:EXPONENT]", "sequential" or "strided[:STRIDE]".
+// Throws std::invalid_argument on malformed input.
+AccessPolicy parseAccessPolicy(const std::string& text);
+
+// What a marker does with a drawn index.
+enum class ClaimMode {
+    Drawn,      // mark that index, blocking if it is taken
+    Nearest     // mark the first free cell from there on; block once the array is full
+};
+
+// "drawn" or "nearest".
+ClaimMode parseClaimMode(const std::string& text);
+
+class IndexGenerator {
+public:
+    IndexGenerator(const AccessPolicy& policy, size_t size, uint64_t seed);
+
+    size_t next();
+
+private:
+    size_t nextZipf();
+
+    AccessPolicy policy;
+    size_t size;
+    Xoshiro256 rng;
+    size_t cursor;
+
+    // Rejection-inversion sampling constants (Hoermann & Derflinger), so
+    // Zipf draws are O(1) with no table over the array.
+    double hIntegralX1;
+    double hIntegralElements;
+    double squeeze;
+};
+
+#endif
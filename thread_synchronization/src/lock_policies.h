@@ -0,0 +1,182 @@
+#ifndef LOCK_POLICIES_H
+#define LOCK_POLICIES_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Locking granularity policies for ArrayManager. Each policy provides
+// lockIndex(index), guarding one element, lockAll(), guarding a full-array
+// pass, and lockKey(index), equal for indices that share a lock so batches
+// can take each lock once. Policies with kLockFree set guard nothing and the
+// manager uses compare-exchange on the elements instead. kLockAllExcludesWriters
+// is set when lockAll() really stops every writer for the pass.
+
+constexpr size_t kCacheLineSize = 64;
+
+class GlobalLockPolicy {
+public:
+    static constexpr bool kLockFree = false;
+    static constexpr bool kLockAllExcludesWriters = true;
+
+    GlobalLockPolicy(size_t /*elementCount*/, size_t /*stripeCount*/) {}
+
+    std::unique_lock<std::mutex> lockIndex(size_t /*index*/) const {
+        return std::unique_lock<std::mutex>(globalMutex);
+    }
+
+    std::unique_lock<std::mutex> lockAll() const {
+        return std::unique_lock<std::mutex>(globalMutex);
+    }
+
+    size_t lockKey(size_t /*index*/) const {
+        return 0;
+    }
+
+private:
+    mutable std::mutex globalMutex;
+};
+
+class StripedLockPolicy {
+public:
+    static constexpr bool kLockFree = false;
+    static constexpr bool kLockAllExcludesWriters = true;
+    static constexpr size_t kDefaultStripeCount = 64;
+
+    // The stripe count is rounded up to a power of two and never exceeds the
+    // element count.
+    StripedLockPolicy(size_t elementCount, size_t stripeCount) {
+        size_t requested = stripeCount == 0 ? kDefaultStripeCount : stripeCount;
+        if (elementCount > 0 && requested > elementCount) {
+            requested = elementCount;
+        }
+        
+        size_t count = 1;
+        while (count < requested) {
+            count <<= 1;
+        }
+        
+        stripeMask = count - 1;
+        stripes = std::make_unique<Stripe[]>(count);
+    }
+
+    std::unique_lock<std::mutex> lockIndex(size_t index) const {
+        return std::unique_lock<std::mutex>(stripes[lockKey(index)].stripeMutex);
+    }
+
+    size_t lockKey(size_t index) const {
+        return index & stripeMask;
+    }
+
+    // Locks every stripe in ascending order; this is the only multi-stripe
+    // acquisition, so it cannot deadlock with lockIndex.
+    std::vector<std::unique_lock<std::mutex>> lockAll() const {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(stripeMask + 1);
+        for (size_t i = 0; i <= stripeMask; ++i) {
+            locks.emplace_back(stripes[i].stripeMutex);
+        }
+        return locks;
+    }
+
+    size_t getStripeCount() const {
+        return stripeMask + 1;
+    }
+
+private:
+    struct alignas(kCacheLineSize) Stripe {
+        std::mutex stripeMutex;
+    };
+
+    std::unique_ptr<Stripe[]> stripes;
+    size_t stripeMask;
+};
+
+class PerElementLockPolicy {
+public:
+    static constexpr bool kLockFree = false;
+    // Holding every element's spinlock at once would cost a lock per cell.
+    static constexpr bool kLockAllExcludesWriters = false;
+
+    // A std::mutex per element would cost 40 bytes each, so every element
+    // gets a one-byte test-and-test-and-set spinlock instead.
+    class ElementGuard {
+    public:
+        explicit ElementGuard(std::atomic<unsigned char>& flag) : flag(&flag) {
+            while (this->flag->exchange(1, std::memory_order_acquire) != 0) {
+                while (this->flag->load(std::memory_order_relaxed) != 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        ~ElementGuard() {
+            if (flag) {
+                flag->store(0, std::memory_order_release);
+            }
+        }
+
+        ElementGuard(const ElementGuard&) = delete;
+        ElementGuard& operator=(const ElementGuard&) = delete;
+        ElementGuard(ElementGuard&& other) noexcept : flag(other.flag) {
+            other.flag = nullptr;
+        }
+        ElementGuard& operator=(ElementGuard&&) = delete;
+
+    private:
+        std::atomic<unsigned char>* flag;
+    };
+
+    struct NoGuard {};
+
+    PerElementLockPolicy(size_t elementCount, size_t /*stripeCount*/)
+        : flags(std::make_unique<std::atomic<unsigned char>[]>(elementCount)) {
+        for (size_t i = 0; i < elementCount; ++i) {
+            flags[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ElementGuard lockIndex(size_t index) const {
+        return ElementGuard(flags[index]);
+    }
+
+    size_t lockKey(size_t index) const {
+        return index;
+    }
+
+    // Full-array passes read the atomic elements without locking, so they
+    // see a per-element consistent but not globally atomic view.
+    NoGuard lockAll() const {
+        return {};
+    }
+
+private:
+    std::unique_ptr<std::atomic<unsigned char>[]> flags;
+};
+
+class LockFreePolicy {
+public:
+    static constexpr bool kLockFree = true;
+    static constexpr bool kLockAllExcludesWriters = false;
+
+    struct NoGuard {};
+
+    LockFreePolicy(size_t /*elementCount*/, size_t /*stripeCount*/) {}
+
+    NoGuard lockIndex(size_t /*index*/) const {
+        return {};
+    }
+
+    NoGuard lockAll() const {
+        return {};
+    }
+
+    size_t lockKey(size_t index) const {
+        return index;
+    }
+};
+
+#endif
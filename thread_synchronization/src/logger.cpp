@@ -0,0 +1,202 @@
+#include "logger.h"
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+constexpr auto kIdleWait = std::chrono::milliseconds(10);
+
+}
+
+Logger::Logger(std::ostream& out, std::ostream& err, size_t capacity, LogOverflow overflow)
+    : out(&out),
+      err(&err),
+      cells(std::make_unique<Cell[]>(capacity)),
+      mask(capacity - 1),
+      level(LogLevel::Info),
+      overflow(overflow),
+      enqueuePosition(0),
+      dequeuePosition(0),
+      pending(0),
+      written(0),
+      dropped(0),
+      stopping(false) {
+    
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        throw std::invalid_argument("Logger capacity must be a power of two");
+    }
+    for (size_t i = 0; i < capacity; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer = std::thread(&Logger::writerLoop, this);
+}
+
+Logger::~Logger() {
+    stopping.store(true);
+    pending.fetchAdd(1);
+    pending.wakeAll();
+    writer.join();
+}
+
+void Logger::setLevel(LogLevel newLevel) {
+    level.store(newLevel, std::memory_order_relaxed);
+}
+
+LogLevel Logger::getLevel() const {
+    return level.load(std::memory_order_relaxed);
+}
+
+void Logger::setOverflow(LogOverflow newOverflow) {
+    overflow.store(newOverflow, std::memory_order_relaxed);
+}
+
+bool Logger::write(LogLevel recordLevel, std::string_view message) {
+    if (!isEnabled(recordLevel)) {
+        return false;
+    }
+    const size_t length = std::min(message.size(), kMaxMessageLength);
+    
+    while (!tryPush(recordLevel, message.data(), length)) {
+        if (overflow.load(std::memory_order_relaxed) == LogOverflow::Drop ||
+            stopping.load(std::memory_order_relaxed)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    pending.fetchAdd(1);
+    pending.wakeAll();
+    return true;
+}
+
+bool Logger::tryPush(LogLevel recordLevel, const char* text, size_t length) {
+    // Bounded MPMC ring in the style of Vyukov: each cell's sequence tells a
+    // producer whether the slot is free for its ticket.
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    
+    cell->level = recordLevel;
+    cell->length = static_cast<uint16_t>(length);
+    std::memcpy(cell->text, text, length);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+void Logger::flush() {
+    const auto target = static_cast<uint32_t>(enqueuePosition.load(std::memory_order_acquire));
+    pending.fetchAdd(1);
+    pending.wakeAll();
+    written.waitUntil([target](uint32_t value) {
+        return static_cast<int32_t>(value - target) >= 0;
+    });
+}
+
+void Logger::setStreams(std::ostream& out, std::ostream& err) {
+    flush();
+    this->out.store(&out, std::memory_order_release);
+    this->err.store(&err, std::memory_order_release);
+}
+
+uint64_t Logger::getDropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+size_t Logger::drainBatch(std::string& outBatch, std::string& errBatch) {
+    size_t count = 0;
+    while (true) {
+        Cell& cell = cells[dequeuePosition & mask];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+            break;
+        }
+        
+        std::string& batch = cell.level >= LogLevel::Warning ? errBatch : outBatch;
+        batch.append(cell.text, cell.length);
+        batch.push_back('\n');
+        cell.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+        ++dequeuePosition;
+        ++count;
+    }
+    
+    if (!outBatch.empty()) {
+        std::ostream& stream = *out.load(std::memory_order_acquire);
+        stream.write(outBatch.data(), static_cast<std::streamsize>(outBatch.size()));
+        stream.flush();
+        outBatch.clear();
+    }
+    if (!errBatch.empty()) {
+        std::ostream& stream = *err.load(std::memory_order_acquire);
+        stream.write(errBatch.data(), static_cast<std::streamsize>(errBatch.size()));
+        stream.flush();
+        errBatch.clear();
+    }
+    written.store(static_cast<uint32_t>(dequeuePosition));
+    written.wakeAll();
+    return count;
+}
+
+void Logger::writerLoop() {
+    std::string outBatch;
+    std::string errBatch;
+    
+    while (true) {
+        const uint32_t seen = pending.load();
+        if (drainBatch(outBatch, errBatch) > 0) {
+            continue;
+        }
+        if (stopping.load()) {
+            break;
+        }
+        
+        const auto deadline = std::chrono::steady_clock::now() + kIdleWait;
+        pending.waitUntil([seen](uint32_t value) { return value != seen; }, &deadline);
+    }
+    // A producer may have reserved a slot just before stopping was set.
+    while (enqueuePosition.load(std::memory_order_acquire) != dequeuePosition) {
+        if (drainBatch(outBatch, errBatch) == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+Logger& defaultLogger() {
+    static Logger logger(std::cerr, std::cerr);
+    return logger;
+}
+
+LogLevel parseLogLevel(const std::string& text) {
+    if (text == "debug") {
+        return LogLevel::Debug;
+    } else if (text == "info") {
+        return LogLevel::Info;
+    } else if (text == "warning") {
+        return LogLevel::Warning;
+    } else if (text == "error") {
+        return LogLevel::Error;
+    } else if (text == "off") {
+        return LogLevel::Off;
+    }
+    throw std::invalid_argument("Invalid log level: " + text);
+}
+
+LogOverflow parseLogOverflow(const std::string& text) {
+    if (text == "drop") {
+        return LogOverflow::Drop;
+    } else if (text == "block") {
+        return LogOverflow::Block;
+    }
+    throw std::invalid_argument("Invalid log overflow policy: " + text);
+}
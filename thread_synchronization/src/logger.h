@@ -0,0 +1,146 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "lock_policies.h"
+#include "sync_primitives.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+
+// What a producer does when the queue is full.
+enum class LogOverflow {
+    Drop,       // discard the record and count it
+    Block       // wait for the writer thread to make room
+};
+
+// Asynchronous logger. Producers format a record on their own stack and push
+// it into a bounded lock-free multi-producer queue; a single writer thread
+// drains it in batches and writes each batch with one call per stream.
+// Records below Warning go to the output stream, the rest to the error stream.
+class Logger {
+public:
+    static constexpr size_t kDefaultCapacity = 4096;
+    // Longer records are truncated.
+    static constexpr size_t kMaxMessageLength = 240;
+
+    Logger(std::ostream& out, std::ostream& err, size_t capacity = kDefaultCapacity,
+           LogOverflow overflow = LogOverflow::Drop);
+    // Writes everything still queued.
+    ~Logger();
+    
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    
+    // Records already queued are written to the old streams first; ones
+    // pushed while the call runs may land on either.
+    void setStreams(std::ostream& out, std::ostream& err);
+    void setLevel(LogLevel level);
+    LogLevel getLevel() const;
+    void setOverflow(LogOverflow overflow);
+    bool isEnabled(LogLevel level) const {
+        return level >= this->level.load(std::memory_order_relaxed) && level != LogLevel::Off;
+    }
+    
+    // Concatenates strings, characters and numbers into one record. Returns
+    // false if the record was filtered out or dropped.
+    template <typename... Parts>
+    bool log(LogLevel level, const Parts&... parts);
+    bool write(LogLevel level, std::string_view message);
+    
+    // Blocks until every record pushed before the call has been written.
+    void flush();
+    uint64_t getDropped() const;
+
+private:
+    struct alignas(kCacheLineSize) Cell {
+        std::atomic<size_t> sequence;
+        LogLevel level;
+        uint16_t length;
+        char text[kMaxMessageLength];
+    };
+    
+    struct Buffer {
+        char text[kMaxMessageLength];
+        size_t length = 0;
+        
+        void append(std::string_view part) {
+            const size_t count = std::min(part.size(), kMaxMessageLength - length);
+            std::memcpy(text + length, part.data(), count);
+            length += count;
+        }
+        
+        template <typename T>
+        void append(const T& part) {
+            if constexpr (std::is_same_v<T, char>) {
+                append(std::string_view(&part, 1));
+            } else if constexpr (std::is_same_v<T, bool>) {
+                append(std::string_view(part ? "true" : "false"));
+            } else if constexpr (std::is_arithmetic_v<T>) {
+                const auto result = std::to_chars(text + length, text + kMaxMessageLength, part);
+                length = result.ec == std::errc() ? static_cast<size_t>(result.ptr - text) : kMaxMessageLength;
+            } else {
+                append(std::string_view(part));
+            }
+        }
+    };
+    
+    bool tryPush(LogLevel level, const char* text, size_t length);
+    void writerLoop();
+    // Writes everything currently queued; returns the number of records.
+    size_t drainBatch(std::string& outBatch, std::string& errBatch);
+    
+    // Read by the writer thread once per batch.
+    std::atomic<std::ostream*> out;
+    std::atomic<std::ostream*> err;
+    std::unique_ptr<Cell[]> cells;
+    const size_t mask;
+    std::atomic<LogLevel> level;
+    std::atomic<LogOverflow> overflow;
+    
+    alignas(kCacheLineSize) std::atomic<size_t> enqueuePosition;
+    alignas(kCacheLineSize) size_t dequeuePosition;
+    // Bumped by producers so a parked writer wakes up.
+    ParkingWord pending;
+    // Low 32 bits of dequeuePosition once the records are written.
+    ParkingWord written;
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> stopping;
+    std::thread writer;
+};
+
+template <typename... Parts>
+bool Logger::log(LogLevel level, const Parts&... parts) {
+    if (!isEnabled(level)) {
+        return false;
+    }
+    Buffer buffer;
+    (buffer.append(parts), ...);
+    return write(level, std::string_view(buffer.text, buffer.length));
+}
+
+// Process-wide logger writing every level to std::cerr, so a headless run's
+// std::cout only carries its report (summary, stats, array dumps). The
+// interactive session moves the status lines back to std::cout with
+// setStreams().
+Logger& defaultLogger();
+
+LogLevel parseLogLevel(const std::string& text);
+LogOverflow parseLogOverflow(const std::string& text);
+
+#endif
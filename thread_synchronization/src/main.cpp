@@ -1,81 +1,333 @@
+#include "array_dump.h"
 #include "array_manager.h"
+#include "driver_options.h"
+#include "logger.h"
+#ifdef THREAD_SYNC_PROCESSES
+#include "process_manager.h"
+#endif
 #include "thread_manager.h"
+#include "trace.h"
 #include "utils.h"
+#include "victim_policy.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
-int main() {
-    try {
-        std::cout << "Thread Synchronization Program" << std::endl;
-        std::cout << "------------------------------" << std::endl;
+namespace {
+
+// Marker output goes through the asynchronous logger; drain it before
+// anything is written to the console directly so the two never interleave.
+void prompt(const char* text) {
+    defaultLogger().flush();
+    std::cout << text << std::flush;
+}
+
+void printArray(const ArrayManager& arrayManager, ArrayDumper& dumper) {
+    defaultLogger().flush();
+    dumper.print(arrayManager, std::cout);
+}
+
+int runInteractive() {
+    Logger& log = defaultLogger();
+    // Status lines are part of the session here, not noise around a report.
+    log.setStreams(std::cout, std::cerr);
+    log.log(LogLevel::Info, "Thread Synchronization Program");
+    log.log(LogLevel::Info, "------------------------------");
+    
+    prompt("Enter array size: ");
+    const int arraySize = getValidInput(1, std::numeric_limits<int>::max());
+    
+    auto arrayManager = std::make_shared<ArrayManager>(static_cast<size_t>(arraySize));
+    ArrayDumper dumper;
+    printArray(*arrayManager, dumper);
+    
+    prompt("Enter number of marker threads: ");
+    const int threadCount = getValidInput(1, arrayManager->getMaxMarkerValue());
+    
+    auto threadManager = std::make_shared<ThreadManager>(arrayManager);
+    threadManager->createThreads(threadCount);
+    
+    log.log(LogLevel::Info, "Starting all marker threads...");
+    threadManager->startAllThreads();
+    
+    while (!threadManager->areAllThreadsFinished()) {
+        threadManager->waitForAllThreadsBlocked();
         
-        std::cout << "Enter array size: ";
-        const int arraySize = getValidInput(1, 1000);
+        log.log(LogLevel::Info, "All threads are now blocked.");
+        printArray(*arrayManager, dumper);
         
-        auto arrayManager = std::make_shared<ArrayManager>(static_cast<size_t>(arraySize));
-        arrayManager->printArray();
+        const auto activeThreadIds = threadManager->getActiveThreadIds();
+        if (activeThreadIds.empty()) {
+            break;
+        }
         
-        std::cout << "Enter number of marker threads: ";
-        const int threadCount = getValidInput(1, 100);
+        std::string activeList;
+        for (size_t i = 0; i < activeThreadIds.size(); ++i) {
+            activeList += std::to_string(activeThreadIds[i]);
+            if (i < activeThreadIds.size() - 1) {
+                activeList += ", ";
+            }
+        }
+        log.log(LogLevel::Info, "Active threads: ", activeList);
         
-        auto threadManager = std::make_shared<ThreadManager>(arrayManager);
-        threadManager->createThreads(threadCount);
+        prompt("Enter thread ID to terminate: ");
+        const int threadIdToTerminate = getValidInput(1, threadCount);
         
-        std::cout << "Starting all marker threads..." << std::endl;
-        threadManager->startAllThreads();
+        auto thread = threadManager->findThreadById(threadIdToTerminate);
+        if (!thread) {
+            log.log(LogLevel::Info, "Thread ", threadIdToTerminate, " is not active.");
+            continue;
+        }
         
-        while (!threadManager->areAllThreadsFinished()) {
-            threadManager->waitForAllThreadsBlocked();
-            
-            std::cout << "All threads are now blocked." << std::endl;
-            arrayManager->printArray();
-            
-            const auto activeThreadIds = threadManager->getActiveThreadIds();
-            if (activeThreadIds.empty()) {
-                break;
-            }
-            
-            std::cout << "Active threads: ";
-            for (size_t i = 0; i < activeThreadIds.size(); ++i) {
-                std::cout << activeThreadIds[i];
-                if (i < activeThreadIds.size() - 1) {
-                    std::cout << ", ";
-                }
-            }
-            std::cout << std::endl;
-            
-            std::cout << "Enter thread ID to terminate: ";
-            const int threadIdToTerminate = getValidInput(1, threadCount);
-            
-            auto thread = threadManager->findThreadById(threadIdToTerminate);
-            if (!thread) {
-                std::cout << "Thread " << threadIdToTerminate << " is not active." << std::endl;
-                continue;
+        log.log(LogLevel::Info, "Terminating thread ", threadIdToTerminate, "...");
+        threadManager->terminateThread(threadIdToTerminate);
+        
+        log.log(LogLevel::Info, "Thread ", threadIdToTerminate, " terminated.");
+        printArray(*arrayManager, dumper);
+        
+        if (threadManager->areAllThreadsFinished()) {
+            log.log(LogLevel::Info, "All threads have finished.");
+            break;
+        }
+        
+        log.log(LogLevel::Info, "Continuing other threads...");
+        threadManager->continueOtherThreads();
+    }
+    
+    log.log(LogLevel::Info, "Program finished successfully.");
+    return 0;
+}
+
+#ifdef THREAD_SYNC_PROCESSES
+std::vector<VictimCandidate> processCandidates(const ProcessManager& processManager) {
+    std::vector<VictimCandidate> candidates;
+    for (int id : processManager.getActiveProcessIds()) {
+        // Processes do not report when they blocked.
+        candidates.push_back({id, processManager.getMarkedCount(id), 0});
+    }
+    return candidates;
+}
+#endif
+
+// Mean and spread of the per-round times, release to release.
+void printRoundTimes(std::vector<std::chrono::nanoseconds> times) {
+    if (times.empty()) {
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    std::chrono::nanoseconds sum{0};
+    for (const auto& time : times) {
+        sum += time;
+    }
+    const auto at = [&times](size_t percent) {
+        return times[(times.size() - 1) * percent / 100].count() / 1000;
+    };
+    std::cout << "round_times mean_us=" << sum.count() / static_cast<int64_t>(times.size()) / 1000
+              << " p50_us=" << at(50)
+              << " p99_us=" << at(99)
+              << " max_us=" << times.back().count() / 1000
+              << "\n";
+}
+
+void printSummary(size_t rounds, size_t totalMarks, std::chrono::steady_clock::time_point startTime) {
+    const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << std::fixed << std::setprecision(3)
+              << "summary rounds=" << rounds
+              << " total_marks=" << totalMarks
+              << " wall_ms=" << wallSeconds * 1000.0
+              << " marks_per_sec=" << (wallSeconds > 0 ? static_cast<double>(totalMarks) / wallSeconds : 0.0)
+              << std::endl;
+}
+
+#ifdef THREAD_SYNC_PROCESSES
+// The headless rounds with a forked process per marker. Marker processes do
+// not record stats histograms or traces.
+int runProcessRounds(const DriverOptions& options, std::shared_ptr<ArrayManager> arrayManager,
+                     std::chrono::steady_clock::time_point startTime) {
+    if (!options.tracePath.empty()) {
+        throw std::invalid_argument("--trace is not supported for marker processes");
+    }
+    if (options.markBatch > 1) {
+        throw std::invalid_argument("--batch is not supported for marker processes");
+    }
+    if (options.claim != ClaimMode::Drawn) {
+        throw std::invalid_argument("--claim nearest is not supported for marker processes");
+    }
+    if (options.release != ReleaseMode::Eager) {
+        throw std::invalid_argument("--release lazy is not supported for marker processes");
+    }
+    
+    auto processManager = std::make_unique<ProcessManager>(arrayManager);
+    processManager->setPacing(options.pacing);
+    processManager->setAccessPolicy(options.access);
+    processManager->setAffinity(options.affinity);
+    processManager->createProcesses(options.markerCount);
+    processManager->startAllProcesses();
+    
+    ArrayDumper dumper(options.dumpMode);
+    VictimSelector victimSelector(options.termination, options.seed);
+    std::vector<std::chrono::nanoseconds> roundTimes;
+    size_t rounds = 0;
+    auto releasedAt = std::chrono::steady_clock::now();
+    
+    while (!processManager->areAllProcessesFinished() &&
+           (options.roundLimit == 0 || rounds < options.roundLimit)) {
+        processManager->waitForAllProcessesBlocked();
+        // Every remaining marker may have crashed while we waited.
+        if (processManager->areAllProcessesFinished()) {
+            break;
+        }
+        ++rounds;
+        auto roundTime = std::chrono::steady_clock::now() - releasedAt;
+        
+        const int victim = victimSelector.choose(processCandidates(*processManager));
+        if (options.verbosity != Verbosity::Quiet) {
+            defaultLogger().log(LogLevel::Info, "round=", rounds, " terminated=", victim,
+                                " marked=", processManager->getMarkedCount(victim));
+        }
+        if (options.verbosity == Verbosity::Full) {
+            printArray(*arrayManager, dumper);
+        }
+        
+        const auto cleanupStart = std::chrono::steady_clock::now();
+        processManager->terminateProcess(victim);
+        if (!processManager->areAllProcessesFinished()) {
+            processManager->continueOtherProcesses();
+        }
+        releasedAt = std::chrono::steady_clock::now();
+        roundTime += releasedAt - cleanupStart;
+        roundTimes.push_back(roundTime);
+    }
+    
+    const size_t totalMarks = processManager->getTotalMarks();
+    const size_t crashed = processManager->getCrashedIds().size();
+    processManager.reset();
+    defaultLogger().flush();
+    
+    if (options.verbosity != Verbosity::Quiet) {
+        std::cout << "processes crashed=" << crashed << "\n";
+        printRoundTimes(std::move(roundTimes));
+    }
+    printSummary(rounds, totalMarks, startTime);
+    return 0;
+}
+#endif
+
+int runHeadless(const DriverOptions& options) {
+    const auto startTime = std::chrono::steady_clock::now();
+    defaultLogger().setLevel(effectiveLogLevel(options));
+    defaultLogger().setOverflow(options.logOverflow);
+    
+    const CellWidth cellWidth = options.cellWidth.value_or(narrowestCellWidth(options.markerCount));
+    auto arrayManager = std::make_shared<ArrayManager>(options.arraySize, options.backend,
+                                                       options.stripeCount, options.storage, cellWidth);
+#ifdef THREAD_SYNC_PROCESSES
+    if (options.execution == ExecutionMode::Processes) {
+        return runProcessRounds(options, arrayManager, startTime);
+    }
+#endif
+
+    auto threadManager = std::make_shared<ThreadManager>(arrayManager);
+    threadManager->setPacing(options.pacing);
+    threadManager->setAccessPolicy(options.access);
+    if (options.claim == ClaimMode::Nearest && options.markBatch > 1) {
+        throw std::invalid_argument("--batch does not apply to --claim nearest");
+    }
+    threadManager->setMarkBatch(options.markBatch);
+    threadManager->setClaimMode(options.claim);
+    threadManager->setReleaseMode(options.release);
+    threadManager->setAffinity(options.affinity);
+    if (options.execution == ExecutionMode::Pool) {
+        threadManager->useWorkerPool(options.poolWorkers);
+    }
+    
+    ArrayDumper dumper(options.dumpMode);
+    std::shared_ptr<TraceRecorder> traceRecorder;
+    if (!options.tracePath.empty()) {
+        traceRecorder = std::make_shared<TraceRecorder>(options.tracePath, options.arraySize);
+        threadManager->setTraceRecorder(traceRecorder);
+    }
+    threadManager->createThreads(options.markerCount);
+    threadManager->startAllThreads();
+    
+    threadManager->setVictimPolicy(options.termination, options.seed);
+    std::vector<std::chrono::nanoseconds> roundTimes;
+    
+    while (!threadManager->areAllThreadsFinished() &&
+           (options.roundLimit == 0 || roundTimes.size() < options.roundLimit)) {
+        const RoundReport report = threadManager->runRound([&](const RoundReport& blocked) {
+            if (options.verbosity != Verbosity::Quiet) {
+                defaultLogger().log(LogLevel::Info, "round=", blocked.round, " terminated=", blocked.victim,
+                                    " marked=", blocked.victimMarked);
             }
-            
-            std::cout << "Terminating thread " << threadIdToTerminate << "..." << std::endl;
-            threadManager->terminateThread(threadIdToTerminate);
-            
-            std::cout << "Thread " << threadIdToTerminate << " terminated." << std::endl;
-            arrayManager->printArray();
-            
-            if (threadManager->areAllThreadsFinished()) {
-                std::cout << "All threads have finished." << std::endl;
-                break;
+            if (options.verbosity == Verbosity::Full) {
+                printArray(*arrayManager, dumper);
             }
-            
-            std::cout << "Continuing other threads..." << std::endl;
-            threadManager->continueOtherThreads();
+        });
+        if (report.victim == 0) {
+            break;
         }
-        
-        std::cout << "Program finished successfully." << std::endl;
+        roundTimes.push_back(report.total);
+    }
+    const size_t rounds = roundTimes.size();
+    
+    const size_t totalMarks = threadManager->getTotalMarks();
+    const StatsSnapshot stats = threadManager->snapshotStats();
+    threadManager.reset();
+    if (traceRecorder) {
+        traceRecorder->stop();
+        defaultLogger().log(LogLevel::Warning, "trace events=", traceRecorder->getWritten(),
+                            " dropped=", traceRecorder->getDropped());
+    }
+    defaultLogger().flush();
+    
+    if (options.verbosity != Verbosity::Quiet) {
+        const MarkerStatsSnapshot& total = stats.total;
+        std::cout << "stats attempts=" << total.markAttempts
+                  << " collisions=" << total.collisions
+                  << " blocked_ms=" << total.blockedNanos / 1000000
+                  << " resume_p50_us=" << total.resumeLatency.percentile(50) / 1000
+                  << " resume_p99_us=" << total.resumeLatency.percentile(99) / 1000
+                  << " cleanup_p50_us=" << total.cleanupDuration.percentile(50) / 1000
+                  << " cleanup_p99_us=" << total.cleanupDuration.percentile(99) / 1000
+                  << "\n";
+        printRoundTimes(std::move(roundTimes));
+    }
+    printSummary(rounds, totalMarks, startTime);
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    DriverOptions options;
+    try {
+        options = parseDriverOptions(std::vector<std::string>(argv + 1, argv + argc));
+    } catch (const std::invalid_argument& e) {
+        defaultLogger().log(LogLevel::Error, "Error: ", e.what());
+        defaultLogger().flush();
+        printDriverUsage(std::cerr, argv[0]);
+        return 2;
+    }
+    
+    if (options.showHelp) {
+        printDriverUsage(std::cout, argv[0]);
         return 0;
+    }
+    
+    try {
+        return options.headless ? runHeadless(options) : runInteractive();
     } catch (const std::exception& e) {
-        std::cerr << "Fatal error: " << e.what() << std::endl;
+        defaultLogger().log(LogLevel::Error, "Fatal error: ", e.what());
         return 1;
     } catch (...) {
-        std::cerr << "Unknown fatal error occurred." << std::endl;
+        defaultLogger().log(LogLevel::Error, "Unknown fatal error occurred.");
         return 1;
     }
-}
\ No newline at end of file
+}
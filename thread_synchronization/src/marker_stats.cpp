@@ -0,0 +1,164 @@
+#include "marker_stats.h"
+#include <algorithm>
+#include <chrono>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Position of the highest set bit; value must not be zero.
+int highestSetBit(uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+}
+
+uint64_t statsNow() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot& other) {
+    if (counts.size() < other.counts.size()) {
+        counts.resize(other.counts.size(), 0);
+    }
+    for (size_t i = 0; i < other.counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+double HistogramSnapshot::mean() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count);
+}
+
+uint64_t HistogramSnapshot::percentile(double percent) const {
+    if (count == 0) {
+        return 0;
+    }
+    
+    const double clamped = std::min(std::max(percent, 0.0), 100.0);
+    uint64_t target = static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(count) + 0.5);
+    target = std::max<uint64_t>(target, 1);
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= target) {
+            return std::min(LatencyHistogram::bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+LatencyHistogram::LatencyHistogram() : count(0), sum(0), min(UINT64_MAX), max(0) {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::bucketFor(uint64_t value) {
+    constexpr uint64_t subBucketCount = uint64_t(1) << kSubBucketBits;
+    if (value < subBucketCount) {
+        return static_cast<size_t>(value);
+    }
+    
+    const int exponent = highestSetBit(value);
+    const int shift = exponent - kSubBucketBits;
+    const uint64_t subBucket = (value >> shift) & (subBucketCount - 1);
+    return (static_cast<size_t>(shift + 1) << kSubBucketBits) + static_cast<size_t>(subBucket);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t bucket) {
+    constexpr size_t subBucketCount = size_t(1) << kSubBucketBits;
+    if (bucket < subBucketCount) {
+        return bucket;
+    }
+    
+    const int shift = static_cast<int>(bucket >> kSubBucketBits) - 1;
+    const uint64_t subBucket = bucket & (subBucketCount - 1);
+    const uint64_t lower = (uint64_t(subBucketCount) + subBucket) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    bump(buckets[bucketFor(value)], 1);
+    bump(count, 1);
+    bump(sum, value);
+    if (value < min.load(std::memory_order_relaxed)) {
+        min.store(value, std::memory_order_relaxed);
+    }
+    if (value > max.load(std::memory_order_relaxed)) {
+        max.store(value, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::snapshotInto(HistogramSnapshot& snapshot) const {
+    HistogramSnapshot mine;
+    mine.counts.resize(kBucketCount);
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        mine.counts[i] = buckets[i].load(std::memory_order_relaxed);
+        mine.count += mine.counts[i];
+    }
+    // Derive count from the buckets so it always matches them; sum, min and
+    // max may be a few records behind under concurrent writes.
+    mine.sum = sum.load(std::memory_order_relaxed);
+    mine.min = min.load(std::memory_order_relaxed);
+    mine.max = max.load(std::memory_order_relaxed);
+    snapshot.merge(mine);
+}
+
+void MarkerStatsSnapshot::merge(const MarkerStatsSnapshot& other) {
+    markAttempts += other.markAttempts;
+    successfulMarks += other.successfulMarks;
+    collisions += other.collisions;
+    blockedNanos += other.blockedNanos;
+    blockDuration.merge(other.blockDuration);
+    resumeLatency.merge(other.resumeLatency);
+    cleanupDuration.merge(other.cleanupDuration);
+}
+
+void MarkerStats::countAttempt(bool success) {
+    bump(markAttempts);
+    bump(success ? successfulMarks : collisions);
+}
+
+void MarkerStats::recordBlock(uint64_t blocked, uint64_t resumeLatencyNanos) {
+    bump(blockedNanos, blocked);
+    blockDuration.record(blocked);
+    resumeLatency.record(resumeLatencyNanos);
+}
+
+void MarkerStats::recordCleanup(uint64_t nanos) {
+    cleanupDuration.record(nanos);
+}
+
+MarkerStatsSnapshot MarkerStats::snapshot(int markerId) const {
+    MarkerStatsSnapshot result;
+    result.markerId = markerId;
+    result.markAttempts = markAttempts.load(std::memory_order_relaxed);
+    result.successfulMarks = successfulMarks.load(std::memory_order_relaxed);
+    result.collisions = collisions.load(std::memory_order_relaxed);
+    result.blockedNanos = blockedNanos.load(std::memory_order_relaxed);
+    blockDuration.snapshotInto(result.blockDuration);
+    resumeLatency.snapshotInto(result.resumeLatency);
+    cleanupDuration.snapshotInto(result.cleanupDuration);
+    return result;
+}
@@ -0,0 +1,100 @@
+#ifndef MARKER_STATS_H
+#define MARKER_STATS_H
+
+#include "lock_policies.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Merged, immutable view of one or more LatencyHistograms.
+struct HistogramSnapshot {
+    std::vector<uint64_t> counts;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+
+    void merge(const HistogramSnapshot& other);
+    double mean() const;
+    // Upper bound of the bucket holding the given percentile (0-100).
+    uint64_t percentile(double percent) const;
+};
+
+// Log-linear (HDR-style) histogram: exact below 8, then 8 sub-buckets per
+// power of two, i.e. roughly 12% relative precision over the full 64-bit
+// range. Single writer; readers take lock-free snapshots at any time.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+    static constexpr size_t kBucketCount = (64 - kSubBucketBits + 1) << kSubBucketBits;
+
+    LatencyHistogram();
+
+    void record(uint64_t value);
+    void snapshotInto(HistogramSnapshot& snapshot) const;
+
+    static size_t bucketFor(uint64_t value);
+    static uint64_t bucketUpperBound(size_t bucket);
+
+private:
+    // Only the owning thread writes, so updates are plain load/store pairs
+    // rather than read-modify-write operations.
+    static void bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> min;
+    std::atomic<uint64_t> max;
+};
+
+struct MarkerStatsSnapshot {
+    int markerId = 0;
+    uint64_t markAttempts = 0;
+    uint64_t successfulMarks = 0;
+    uint64_t collisions = 0;
+    uint64_t blockedNanos = 0;
+    HistogramSnapshot blockDuration;
+    HistogramSnapshot resumeLatency;
+    HistogramSnapshot cleanupDuration;
+
+    void merge(const MarkerStatsSnapshot& other);
+};
+
+// Hot-path counters for one marker, written only by that marker's thread and
+// padded to its own cache lines so markers never share a line.
+class alignas(kCacheLineSize) MarkerStats {
+public:
+    void countAttempt(bool success);
+    // Duration of one park, and the delay from the release broadcast to the
+    // marker running again.
+    void recordBlock(uint64_t blockedNanos, uint64_t resumeLatencyNanos);
+    void recordCleanup(uint64_t nanos);
+    MarkerStatsSnapshot snapshot(int markerId) const;
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t delta = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> markAttempts{0};
+    std::atomic<uint64_t> successfulMarks{0};
+    std::atomic<uint64_t> collisions{0};
+    std::atomic<uint64_t> blockedNanos{0};
+    LatencyHistogram blockDuration;
+    LatencyHistogram resumeLatency;
+    LatencyHistogram cleanupDuration;
+};
+
+struct StatsSnapshot {
+    std::vector<MarkerStatsSnapshot> markers;
+    MarkerStatsSnapshot total;
+};
+
+// Nanoseconds on the steady clock, used for all stats timestamps.
+uint64_t statsNow();
+
+#endif
@@ -0,0 +1,433 @@
+#include "marker_thread.h"
+#include "logger.h"
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+void RoundControl::start() {
+    startEvent.signal();
+    resumeParked();
+}
+
+void RoundControl::release() {
+    releaseNanos.store(statsNow(), std::memory_order_relaxed);
+    releaseEpoch.advance();
+    resumeParked();
+}
+
+void RoundControl::resumeParked() {
+    std::vector<MarkerThread*> waking;
+    {
+        std::lock_guard<std::mutex> lock(parkedMutex);
+        waking.swap(parked);
+    }
+    for (MarkerThread* marker : waking) {
+        marker->resume();
+    }
+}
+
+MarkerThread::MarkerThread(int id, std::shared_ptr<ArrayManager> arrayManager,
+                           std::shared_ptr<RoundControl> round)
+    : id(id), 
+      arrayManager(arrayManager),
+      round(round ? round : std::make_shared<RoundControl>()),
+      running(false),
+      batchSize(1),
+      claimMode(ClaimMode::Drawn),
+      cpu(-1),
+      traceRing(nullptr),
+      command(MarkerCommand::Continue),
+      blocked(false),
+      failed(false),
+      markedCount(0),
+      totalMarks(0),
+      blockedIndex(0),
+      phase(Phase::Start),
+      seenEpoch(0),
+      blockedAt(0),
+      finished(true) {
+    
+    if (!arrayManager) {
+        throw std::invalid_argument("Array manager cannot be null");
+    }
+}
+
+MarkerThread::~MarkerThread() {
+    if (running.load()) {
+        try {
+            sendCommand(MarkerCommand::Terminate);
+            join();
+        } catch (const std::exception& e) {
+            defaultLogger().log(LogLevel::Error, "Error during marker thread shutdown: ", e.what());
+        }
+    }
+}
+
+void MarkerThread::setPacing(const PacingPolicy& policy) {
+    if (running.load()) {
+        throw std::logic_error("Cannot change pacing of a running thread");
+    }
+    pacing = policy;
+}
+
+void MarkerThread::setAccessPolicy(const AccessPolicy& policy) {
+    if (running.load()) {
+        throw std::logic_error("Cannot change access policy of a running thread");
+    }
+    access = policy;
+}
+
+void MarkerThread::setTraceRecorder(std::shared_ptr<TraceRecorder> recorder) {
+    if (running.load()) {
+        throw std::logic_error("Cannot change trace recorder of a running thread");
+    }
+    traceRecorder = recorder;
+}
+
+void MarkerThread::setMarkBatch(size_t size) {
+    if (running.load()) {
+        throw std::logic_error("Cannot change the mark batch of a running thread");
+    }
+    if (size == 0) {
+        throw std::invalid_argument("Mark batch must be positive");
+    }
+    batchSize = size;
+}
+
+void MarkerThread::setClaimMode(ClaimMode mode) {
+    if (running.load()) {
+        throw std::logic_error("Cannot change the claim mode of a running thread");
+    }
+    claimMode = mode;
+}
+
+void MarkerThread::setPool(std::shared_ptr<WorkStealingPool> newPool) {
+    if (running.load()) {
+        throw std::logic_error("Cannot change the pool of a running thread");
+    }
+    pool = newPool;
+}
+
+void MarkerThread::setCpu(int newCpu) {
+    if (running.load()) {
+        throw std::logic_error("Cannot change the CPU of a running thread");
+    }
+    cpu = newCpu;
+}
+
+int MarkerThread::getCpu() const {
+    return cpu;
+}
+
+void MarkerThread::start() {
+    if (running.load()) {
+        throw std::logic_error("Thread already running");
+    }
+    
+    running.store(true);
+    phase = Phase::Start;
+    if (pool) {
+        {
+            std::lock_guard<std::mutex> lock(finishMutex);
+            finished = false;
+        }
+        pool->submit(this);
+    } else {
+        thread = std::thread(&MarkerThread::threadFunction, this);
+    }
+}
+
+void MarkerThread::signalStart() {
+    round->start();
+}
+
+void MarkerThread::waitForBlocking() {
+    blockedEvent.wait();
+}
+
+void MarkerThread::sendCommand(MarkerCommand cmd) {
+    command.store(cmd);
+    round->release();
+}
+
+void MarkerThread::setPendingCommand(MarkerCommand cmd) {
+    command.store(cmd);
+}
+
+void MarkerThread::join() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+    std::unique_lock<std::mutex> lock(finishMutex);
+    finishedCondition.wait(lock, [this] { return finished; });
+}
+
+bool MarkerThread::isRunning() const {
+    return running.load();
+}
+
+bool MarkerThread::isBlocked() const {
+    return blocked.load();
+}
+
+bool MarkerThread::hasFailed() const {
+    return failed.load();
+}
+
+int MarkerThread::getId() const {
+    return id;
+}
+
+size_t MarkerThread::getMarkedCount() const {
+    return markedCount.load();
+}
+
+size_t MarkerThread::getTotalMarks() const {
+    return totalMarks.load(std::memory_order_relaxed);
+}
+
+size_t MarkerThread::getBlockedIndex() const {
+    return blockedIndex.load();
+}
+
+uint64_t MarkerThread::getBlockedAt() const {
+    return blockedAt.load(std::memory_order_relaxed);
+}
+
+MarkerStatsSnapshot MarkerThread::snapshotStats() const {
+    return stats.snapshot(id);
+}
+
+void MarkerThread::resume() {
+    pool->submit(this);
+}
+
+void MarkerThread::threadFunction() {
+    // Pin before anything the marker allocates is first touched.
+    if (cpu >= 0 && !pinCurrentThread({cpu})) {
+        defaultLogger().log(LogLevel::Warning, "Marker ", id, " could not be pinned to CPU ", cpu);
+    }
+    round->startEvent.wait();
+    
+    while (true) {
+        const Step next = step();
+        if (next.wait == Wait::Delay) {
+            std::this_thread::sleep_for(next.delay);
+        } else if (next.wait == Wait::Release) {
+            // A shutdown may have set Terminate and released while this
+            // marker was still running; its release is then already spent.
+            if (command.load() != MarkerCommand::Terminate) {
+                round->releaseEpoch.waitForChange(seenEpoch);
+            }
+        } else if (next.wait == Wait::Finished) {
+            break;
+        }
+    }
+    finish();
+}
+
+void MarkerThread::run() {
+    if (phase == Phase::Start &&
+        round->park(this, [this] { return round->startEvent.isSignaled(); })) {
+        return;
+    }
+    
+    for (size_t i = 0; i < kStepsPerSlice; ++i) {
+        const Step next = step();
+        switch (next.wait) {
+            case Wait::None:
+                continue;
+            case Wait::Delay:
+                pool->submitAfter(this, next.delay);
+                return;
+            case Wait::Release:
+                if (!round->park(this, [this] {
+                        return round->releaseEpoch.current() != seenEpoch ||
+                               command.load() == MarkerCommand::Terminate;
+                    })) {
+                    continue;
+                }
+                return;
+            case Wait::Finished:
+                finish();
+                return;
+        }
+    }
+    // Yield so markers queued behind this one get their turn.
+    pool->submit(this);
+}
+
+MarkerThread::Step MarkerThread::step() {
+    try {
+        switch (phase) {
+            case Phase::Start:
+                if (traceRecorder) {
+                    traceRing = traceRecorder->createRing();
+                }
+                pacer.emplace(pacing, static_cast<uint32_t>(id));
+                indices.emplace(access, arrayManager->getSize(), static_cast<uint64_t>(id));
+                phase = Phase::Mark;
+                return {Wait::None, {}};
+            
+            case Phase::Mark: {
+                if (!running.load()) {
+                    return {Wait::Finished, {}};
+                }
+                if (claimMode == ClaimMode::Nearest) {
+                    return claimNearest();
+                }
+                if (batchSize > 1) {
+                    return markBatch();
+                }
+                const size_t index = indices->next();
+                const bool marked = arrayManager->markElement(index, id);
+                stats.countAttempt(marked);
+                
+                if (marked) {
+                    totalMarks.fetch_add(1, std::memory_order_relaxed);
+                    trace(TraceEventType::Mark, index);
+                    phase = Phase::Count;
+                    return pace();
+                }
+                
+                trace(TraceEventType::Collision, index);
+                return block(index);
+            }
+            
+            case Phase::Count:
+                markedCount.store(arrayManager->countMarkedElements(id));
+                phase = Phase::Mark;
+                return pace();
+            
+            case Phase::Blocked: {
+                const uint64_t resumedAt = statsNow();
+                const uint64_t releasedAt = round->releaseNanos.load(std::memory_order_relaxed);
+                stats.recordBlock(resumedAt - blockedAt.load(std::memory_order_relaxed),
+                                  resumedAt > releasedAt ? resumedAt - releasedAt : 0);
+                blocked.store(false);
+                blockedEvent.reset();
+                trace(TraceEventType::Resume);
+                
+                if (command.load() == MarkerCommand::Terminate) {
+                    trace(TraceEventType::Terminate);
+                    resetMarkedElements();
+                    return {Wait::Finished, {}};
+                }
+                phase = Phase::Mark;
+                return {Wait::None, {}};
+            }
+        }
+    } catch (const std::exception& e) {
+        defaultLogger().log(LogLevel::Error, phase == Phase::Start ? "Fatal error" : "Error",
+                            " in marker thread ", id, ": ", e.what());
+        // Failed before the signal, so the manager sees why the countdown
+        // moved. No step signals before it throws, so the current round
+        // still completes, and the manager drops the marker from later ones.
+        failed.store(true);
+        round->blockedCountdown.signal();
+    }
+    return {Wait::Finished, {}};
+}
+
+MarkerThread::Step MarkerThread::markBatch() {
+    batch.resize(batchSize);
+    for (size_t& index : batch) {
+        index = indices->next();
+    }
+    // In batch order and stopping at the first collision, so the marker
+    // blocks where marking index by index would have.
+    const BatchMarkResult result = arrayManager->markElements(batch, id, true);
+    
+    for (size_t position = 0; position < result.firstCollision; ++position) {
+        stats.countAttempt(true);
+        trace(TraceEventType::Mark, batch[position]);
+    }
+    totalMarks.fetch_add(result.marked, std::memory_order_relaxed);
+    
+    if (result.firstCollision == batch.size()) {
+        phase = Phase::Count;
+        return pace();
+    }
+    
+    const size_t index = batch[result.firstCollision];
+    stats.countAttempt(false);
+    trace(TraceEventType::Collision, index);
+    return block(index);
+}
+
+MarkerThread::Step MarkerThread::claimNearest() {
+    const size_t hint = indices->next();
+    const std::optional<size_t> index = arrayManager->claimAnyFree(id, hint);
+    stats.countAttempt(index.has_value());
+    
+    if (index) {
+        totalMarks.fetch_add(1, std::memory_order_relaxed);
+        trace(TraceEventType::Mark, *index);
+        phase = Phase::Count;
+        return pace();
+    }
+    
+    // Nothing is free anywhere; block at the hint.
+    trace(TraceEventType::Collision, hint);
+    return block(hint);
+}
+
+MarkerThread::Step MarkerThread::block(size_t index) {
+    markedCount.store(arrayManager->countMarkedElements(id));
+    
+    defaultLogger().log(LogLevel::Info, "Marker ", id,
+                        " blocked. Marked elements: ", markedCount.load(),
+                        ", blocked at index: ", index);
+    
+    blockedIndex.store(index);
+    blocked.store(true);
+    
+    // Read the epoch before announcing the block, otherwise a release issued
+    // right after the announcement could be missed.
+    seenEpoch = round->releaseEpoch.current();
+    trace(TraceEventType::Block, index);
+    blockedAt.store(statsNow(), std::memory_order_relaxed);
+    phase = Phase::Blocked;
+    blockedEvent.signal();
+    round->blockedCountdown.signal();
+    return {Wait::Release, {}};
+}
+
+MarkerThread::Step MarkerThread::pace() {
+    // Pool workers must not sleep, so sleeps come back as delays for
+    // whoever runs the marker to take.
+    const auto delay = pacer->deferredPace();
+    return {delay.count() > 0 ? Wait::Delay : Wait::None, delay};
+}
+
+void MarkerThread::finish() {
+    running.store(false);
+    if (pool) {
+        // Once the lock is released join() may destroy the marker.
+        std::lock_guard<std::mutex> lock(finishMutex);
+        finished = true;
+        finishedCondition.notify_all();
+    }
+}
+
+void MarkerThread::resetMarkedElements() {
+    try {
+        const uint64_t startedAt = statsNow();
+        const size_t released = arrayManager->resetMarkedElements(id);
+        // A marker terminated through ThreadManager was already cleaned up by
+        // the manager; only count cleanups that actually released cells.
+        if (released > 0) {
+            stats.recordCleanup(statsNow() - startedAt);
+        }
+        markedCount.store(0);
+        trace(TraceEventType::Reset, released);
+    } catch (const std::exception& e) {
+        defaultLogger().log(LogLevel::Error, "Error while resetting marked elements: ", e.what());
+    }
+}
+
+void MarkerThread::trace(TraceEventType type, uint64_t index) {
+    if (traceRing) {
+        traceRing->record(type, static_cast<uint32_t>(id), index);
+    }
+}
@@ -2,19 +2,79 @@
 #define MARKER_THREAD_H
 
 #include "array_manager.h"
+#include "index_generator.h"
+#include "marker_stats.h"
+#include "pacing.h"
+#include "placement.h"
 #include "sync_primitives.h"
+#include "trace.h"
+#include "work_stealing_pool.h"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <thread>
+#include <vector>
 
 enum class MarkerCommand {
     Continue,
     Terminate
 };
 
-class MarkerThread {
+class MarkerThread;
+
+// Synchronization shared by every marker of one ThreadManager: a single
+// start gate, a countdown that is set once every active marker has blocked,
+// and a broadcast epoch that releases all blocked markers at once. Markers
+// running as pool tasks park here instead of waiting on the gate or epoch.
+struct RoundControl {
+    RoundControl() : blockedCountdown(0), releaseNanos(0) {}
+    
+    // Opens the start gate.
+    void start();
+    // Advances the epoch, stamping the release so markers can measure how
+    // long they took to resume.
+    void release();
+    // Parks a pool-mode marker until the next start() or release(), unless
+    // ready() already holds; returns whether it parked.
+    template <typename Ready>
+    bool park(MarkerThread* marker, Ready ready);
+    
+    Event startEvent;
+    CountdownEvent blockedCountdown;
+    EpochEvent releaseEpoch;
+    std::atomic<uint64_t> releaseNanos;
+
+private:
+    void resumeParked();
+    
+    std::mutex parkedMutex;
+    std::vector<MarkerThread*> parked;
+};
+
+template <typename Ready>
+bool RoundControl::park(MarkerThread* marker, Ready ready) {
+    // start() and release() publish before taking the lock, so checking
+    // under it cannot miss one.
+    std::lock_guard<std::mutex> lock(parkedMutex);
+    if (ready()) {
+        return false;
+    }
+    parked.push_back(marker);
+    return true;
+}
+
+// A marker runs either on a dedicated thread or, after setPool(), as a task
+// multiplexed with other markers onto a WorkStealingPool. Both run the same
+// step() state machine; they differ only in how they wait.
+class MarkerThread : private PoolTask {
 public:
-    MarkerThread(int id, std::shared_ptr<ArrayManager> arrayManager);
+    // Without a shared round the marker gets a private one, so start and
+    // commands only affect this marker.
+    MarkerThread(int id, std::shared_ptr<ArrayManager> arrayManager,
+                 std::shared_ptr<RoundControl> round = nullptr);
     ~MarkerThread();
     
     MarkerThread(const MarkerThread&) = delete;
@@ -22,34 +82,123 @@ public:
     MarkerThread(MarkerThread&&) = delete;
     MarkerThread& operator=(MarkerThread&&) = delete;
     
+    // Must be called before start().
+    void setPacing(const PacingPolicy& policy);
+    void setAccessPolicy(const AccessPolicy& policy);
+    void setTraceRecorder(std::shared_ptr<TraceRecorder> recorder);
+    // Draws this many indices at a time and submits them as one
+    // ArrayManager::markElements() batch, pacing once per batch. 1 (the
+    // default) marks index by index.
+    void setMarkBatch(size_t size);
+    // With ClaimMode::Nearest each drawn index is only a hint for
+    // ArrayManager::claimAnyFree(); the mark batch is then not used.
+    void setClaimMode(ClaimMode mode);
+    // Runs the marker as a pool task instead of on its own thread.
+    void setPool(std::shared_ptr<WorkStealingPool> pool);
+    // The marker pins itself to cpu when it starts; -1 leaves it unpinned.
+    // Pool-mode markers run wherever the pool's workers are pinned.
+    void setCpu(int cpu);
+    int getCpu() const;
     void start();
     void signalStart();
     void waitForBlocking();
+    // Sets the command and releases every marker sharing this round.
     void sendCommand(MarkerCommand command);
+    // Sets the command without releasing; it is acted on at the next release.
+    void setPendingCommand(MarkerCommand command);
     void join();
     bool isRunning() const;
     bool isBlocked() const;
+    // Set when a step threw and the marker gave up. It still counted itself
+    // as blocked for the round it failed in, but will never block again.
+    bool hasFailed() const;
     int getId() const;
     size_t getMarkedCount() const;
+    // Successful marks over the marker's lifetime, including released ones.
+    size_t getTotalMarks() const;
     size_t getBlockedIndex() const;
+    // statsNow() when the marker last blocked; only meaningful while it is.
+    uint64_t getBlockedAt() const;
+    // Lock-free; may be a few events behind while the marker is running.
+    MarkerStatsSnapshot snapshotStats() const;
+    // Requeues a parked pool-mode marker; called by RoundControl.
+    void resume();
 
 private:
+    enum class Phase {
+        Start,      // nothing set up yet
+        Mark,       // about to try the next index
+        Count,      // marked; publish the count after pacing
+        Blocked     // waiting for a release
+    };
+    
+    enum class Wait {
+        None,       // step again right away
+        Delay,      // step again after Step::delay
+        Release,    // step again after the next release
+        Finished
+    };
+    
+    struct Step {
+        Wait wait;
+        std::chrono::microseconds delay;
+    };
+    
+    // Steps a pool task takes before yielding its worker.
+    static constexpr size_t kStepsPerSlice = 64;
+    
     void threadFunction();
+    // PoolTask
+    void run() override;
+    Step step();
+    Step markBatch();
+    Step claimNearest();
+    // Announces the block at index and waits for the next release.
+    Step block(size_t index);
+    Step pace();
+    void finish();
     void resetMarkedElements();
+    void trace(TraceEventType type, uint64_t index = 0);
     
     int id;
     std::shared_ptr<ArrayManager> arrayManager;
+    std::shared_ptr<RoundControl> round;
     std::thread thread;
     std::atomic<bool> running;
+    PacingPolicy pacing;
+    AccessPolicy access;
+    size_t batchSize;
+    ClaimMode claimMode;
+    std::shared_ptr<TraceRecorder> traceRecorder;
+    std::shared_ptr<WorkStealingPool> pool;
+    int cpu;
+    // Owned by traceRecorder; only touched by whichever thread runs the marker.
+    TraceRing* traceRing;
     
-    Event startEvent;
     Event blockedEvent;
-    Event commandEvent;
     
     std::atomic<MarkerCommand> command;
     std::atomic<bool> blocked;
+    std::atomic<bool> failed;
     std::atomic<size_t> markedCount;
+    std::atomic<size_t> totalMarks;
     std::atomic<size_t> blockedIndex;
+    MarkerStats stats;
+    
+    // Step state; only touched by whichever thread runs the marker.
+    Phase phase;
+    std::optional<Pacer> pacer;
+    std::optional<IndexGenerator> indices;
+    std::vector<size_t> batch;
+    uint32_t seenEpoch;
+    // Also read by the manager to pick the longest-blocked victim.
+    std::atomic<uint64_t> blockedAt;
+    
+    // Pool-mode join() waits on these; a condition variable, unlike an
+    // Event, is not touched by the signalling worker once the waiter runs.
+    std::mutex finishMutex;
+    std::condition_variable finishedCondition;
+    bool finished;
 };
 
 #endif
\ No newline at end of file
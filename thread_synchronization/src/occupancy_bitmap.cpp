@@ -0,0 +1,230 @@
+#include "occupancy_bitmap.h"
+
+namespace {
+
+int lowestSetBit(uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int bit = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+size_t countSetBits(uint64_t bits) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_popcountll(bits));
+#else
+    size_t count = 0;
+    for (; bits != 0; bits &= bits - 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Bits at and above position bit.
+uint64_t bitsFrom(size_t bit) {
+    return ~uint64_t(0) << bit;
+}
+
+}
+
+OccupancyBitmap::OccupancyBitmap(size_t size)
+    : cellCount(size),
+      wordCount(wordsFor(size)),
+      groupCount(wordsFor(wordCount)),
+      superCount(wordsFor(groupCount)),
+      cellMemory(MappedRegion::anonymous(wordCount * sizeof(uint64_t), HugePageMode::None)),
+      cellBits(static_cast<std::atomic<uint64_t>*>(cellMemory.data())),
+      fullWords(std::make_unique<std::atomic<uint64_t>[]>(groupCount)),
+      fullGroups(std::make_unique<std::atomic<uint64_t>[]>(superCount)) {
+    
+    for (size_t group = 0; group < groupCount; ++group) {
+        fullWords[group].store(0, std::memory_order_relaxed);
+    }
+    for (size_t super = 0; super < superCount; ++super) {
+        fullGroups[super].store(0, std::memory_order_relaxed);
+    }
+    markPadding();
+}
+
+void OccupancyBitmap::set(size_t index) {
+    const size_t word = index / 64;
+    const uint64_t bit = uint64_t(1) << (index % 64);
+    const uint64_t old = cellBits[word].fetch_or(bit);
+    if (old & bit) {
+        return;
+    }
+    
+    counts[shardOf(index)].count.fetch_add(1, std::memory_order_relaxed);
+    if ((old | bit) == kFull) {
+        summarizeFull(word);
+    }
+}
+
+void OccupancyBitmap::clear(size_t index) {
+    const size_t word = index / 64;
+    const uint64_t bit = uint64_t(1) << (index % 64);
+    const uint64_t old = cellBits[word].fetch_and(~bit);
+    if (!(old & bit)) {
+        return;
+    }
+    
+    counts[shardOf(index)].count.fetch_sub(1, std::memory_order_relaxed);
+    if (old == kFull) {
+        summarizeOpen(word);
+    }
+}
+
+bool OccupancyBitmap::test(size_t index) const {
+    return (cellBits[index / 64].load() >> (index % 64)) & 1;
+}
+
+size_t OccupancyBitmap::findFree(size_t from) const {
+    if (from >= cellCount) {
+        return kNone;
+    }
+    
+    size_t word = from / 64;
+    uint64_t open = ~cellBits[word].load() & bitsFrom(from % 64);
+    // A summary can still call a word open that has just filled up; the
+    // search then moves on to the next one.
+    while (open == 0) {
+        word = nextOpenWord(word + 1);
+        if (word == kNone) {
+            return kNone;
+        }
+        open = ~cellBits[word].load();
+    }
+    return word * 64 + static_cast<size_t>(lowestSetBit(open));
+}
+
+size_t OccupancyBitmap::getOccupiedCount() const {
+    size_t total = 0;
+    for (const auto& shard : counts) {
+        total += shard.count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t OccupancyBitmap::size() const {
+    return cellCount;
+}
+
+size_t OccupancyBitmap::wordsFor(size_t bits) {
+    return bits == 0 ? 1 : (bits + 63) / 64;
+}
+
+size_t OccupancyBitmap::shardOf(size_t index) {
+    // One shard per word of cell bits, round-robin; a marker setting a bit
+    // already holds that word's cache line.
+    return (index / 64) % kCountShards;
+}
+
+void OccupancyBitmap::markPadding() {
+    if (cellCount % 64 != 0 || cellCount == 0) {
+        cellBits[wordCount - 1].fetch_or(bitsFrom(cellCount % 64));
+    }
+    if (wordCount % 64 != 0) {
+        fullWords[groupCount - 1].fetch_or(bitsFrom(wordCount % 64));
+    }
+    if (groupCount % 64 != 0) {
+        fullGroups[superCount - 1].fetch_or(bitsFrom(groupCount % 64));
+    }
+    // The last word may be nothing but padding.
+    if (cellBits[wordCount - 1].load() == kFull) {
+        summarizeFull(wordCount - 1);
+    }
+}
+
+void OccupancyBitmap::rebuildSummaries() {
+    for (size_t group = 0; group < groupCount; ++group) {
+        fullWords[group].store(0, std::memory_order_relaxed);
+    }
+    for (size_t super = 0; super < superCount; ++super) {
+        fullGroups[super].store(0, std::memory_order_relaxed);
+    }
+    for (auto& shard : counts) {
+        shard.count.store(0, std::memory_order_relaxed);
+    }
+    
+    // Padding goes in after counting, so only real cells are counted.
+    for (size_t word = 0; word < wordCount; ++word) {
+        const uint64_t bits = cellBits[word].load(std::memory_order_relaxed);
+        counts[shardOf(word * 64)].count.fetch_add(countSetBits(bits), std::memory_order_relaxed);
+    }
+    markPadding();
+    for (size_t word = 0; word < wordCount; ++word) {
+        if (cellBits[word].load(std::memory_order_relaxed) == kFull) {
+            summarizeFull(word);
+        }
+    }
+}
+
+void OccupancyBitmap::summarizeFull(size_t word) {
+    const size_t group = word / 64;
+    const uint64_t wordBit = uint64_t(1) << (word % 64);
+    const uint64_t oldGroup = fullWords[group].fetch_or(wordBit);
+    // Whoever frees a cell meanwhile clears the summary after this check or
+    // made it fail.
+    if (cellBits[word].load() != kFull) {
+        summarizeOpen(word);
+        return;
+    }
+    if ((oldGroup | wordBit) != kFull) {
+        return;
+    }
+    
+    const uint64_t groupBit = uint64_t(1) << (group % 64);
+    fullGroups[group / 64].fetch_or(groupBit);
+    if (fullWords[group].load() != kFull) {
+        fullGroups[group / 64].fetch_and(~groupBit);
+    }
+}
+
+void OccupancyBitmap::summarizeOpen(size_t word) {
+    const size_t group = word / 64;
+    const uint64_t oldGroup = fullWords[group].fetch_and(~(uint64_t(1) << (word % 64)));
+    if (oldGroup == kFull) {
+        fullGroups[group / 64].fetch_and(~(uint64_t(1) << (group % 64)));
+    }
+}
+
+size_t OccupancyBitmap::nextOpenWord(size_t word) const {
+    if (word >= wordCount) {
+        return kNone;
+    }
+    
+    size_t group = word / 64;
+    uint64_t open = ~fullWords[group].load() & bitsFrom(word % 64);
+    while (open == 0) {
+        group = nextOpenGroup(group + 1);
+        if (group == kNone) {
+            return kNone;
+        }
+        open = ~fullWords[group].load();
+    }
+    return group * 64 + static_cast<size_t>(lowestSetBit(open));
+}
+
+size_t OccupancyBitmap::nextOpenGroup(size_t group) const {
+    if (group >= groupCount) {
+        return kNone;
+    }
+    
+    // The top level is scanned linearly: one word per 262144 cells.
+    size_t super = group / 64;
+    uint64_t open = ~fullGroups[super].load() & bitsFrom(group % 64);
+    while (open == 0) {
+        if (++super >= superCount) {
+            return kNone;
+        }
+        open = ~fullGroups[super].load();
+    }
+    return super * 64 + static_cast<size_t>(lowestSetBit(open));
+}
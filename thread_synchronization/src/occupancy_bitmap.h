@@ -0,0 +1,94 @@
+#ifndef OCCUPANCY_BITMAP_H
+#define OCCUPANCY_BITMAP_H
+
+#include "element_storage.h"
+#include "lock_policies.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// One bit per array cell, set while the cell is marked, under two summary
+// levels: a level-1 bit is set when its 64-cell word is full and a level-2
+// bit when its 64 level-1 words are. Finding a free cell skips full regions
+// 4096 or 262144 cells at a time with count-trailing-zeros.
+//
+// Bits follow the cells with a short lag: ArrayManager sets a bit after
+// claiming its cell and clears it before releasing the cell, so a clear bit
+// can briefly belong to a cell being claimed, never to one that stays
+// marked. Summary bits are only ever set by a thread that then confirms the
+// level below is still full, and may always be cleared, so a region with a
+// free cell is never left summarized as full.
+class OccupancyBitmap {
+public:
+    static constexpr size_t kNone = SIZE_MAX;
+    
+    explicit OccupancyBitmap(size_t size);
+    
+    OccupancyBitmap(const OccupancyBitmap&) = delete;
+    OccupancyBitmap& operator=(const OccupancyBitmap&) = delete;
+    
+    void set(size_t index);
+    void clear(size_t index);
+    bool test(size_t index) const;
+    // The first index at or after from whose bit is clear, or kNone.
+    size_t findFree(size_t from) const;
+    // Sums a fixed number of counters, so O(1) in the array size. Exact
+    // when no bit is changing.
+    size_t getOccupiedCount() const;
+    size_t size() const;
+    // Recomputes every level from occupied(index). Not safe against
+    // concurrent set() or clear().
+    template <typename Occupied>
+    void rebuild(Occupied occupied);
+
+private:
+    static constexpr uint64_t kFull = ~uint64_t(0);
+    static constexpr size_t kCountShards = 64;
+    
+    // Spread over cache lines by 64-cell word, so markers working on
+    // different words seldom share a counter, even in a small array.
+    struct alignas(kCacheLineSize) CountShard {
+        std::atomic<size_t> count{0};
+    };
+    
+    static size_t wordsFor(size_t bits);
+    static size_t shardOf(size_t index);
+    // Sets the padding bits past the end of each level, so the last words
+    // can be full and searches never return them.
+    void markPadding();
+    // The rest of rebuild() once the cell bits are in place.
+    void rebuildSummaries();
+    void summarizeFull(size_t word);
+    void summarizeOpen(size_t word);
+    size_t nextOpenWord(size_t word) const;
+    size_t nextOpenGroup(size_t group) const;
+    
+    const size_t cellCount;
+    const size_t wordCount;
+    const size_t groupCount;
+    const size_t superCount;
+    // Mapped lazily, like the cells, so an untouched array costs nothing.
+    MappedRegion cellMemory;
+    std::atomic<uint64_t>* cellBits;
+    std::unique_ptr<std::atomic<uint64_t>[]> fullWords;
+    std::unique_ptr<std::atomic<uint64_t>[]> fullGroups;
+    CountShard counts[kCountShards];
+};
+
+template <typename Occupied>
+void OccupancyBitmap::rebuild(Occupied occupied) {
+    for (size_t word = 0; word < wordCount; ++word) {
+        uint64_t bits = 0;
+        const size_t first = word * 64;
+        for (size_t bit = 0; bit < 64 && first + bit < cellCount; ++bit) {
+            if (occupied(first + bit)) {
+                bits |= uint64_t(1) << bit;
+            }
+        }
+        cellBits[word].store(bits, std::memory_order_relaxed);
+    }
+    rebuildSummaries();
+}
+
+#endif
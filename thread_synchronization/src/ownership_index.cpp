@@ -0,0 +1,107 @@
+#include "ownership_index.h"
+#include <stdexcept>
+
+namespace {
+
+// Returns what slot points to, installing a fresh T first if it is empty.
+// Racing installers agree on whichever CAS won.
+template <typename T, typename Make>
+T* obtainSlot(std::atomic<T*>& slot, Make make) {
+    T* current = slot.load(std::memory_order_acquire);
+    if (current != nullptr) {
+        return current;
+    }
+    T* fresh = make();
+    if (slot.compare_exchange_strong(current, fresh, std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+        return fresh;
+    }
+    delete[] fresh;
+    return current;
+}
+
+} // namespace
+
+OwnershipIndex::OwnershipIndex(size_t elementCount)
+    : slotMemory(MappedRegion::anonymous(elementCount * sizeof(size_t), HugePageMode::None)),
+      slots(static_cast<size_t*>(slotMemory.data())) {
+    for (auto& page : pages) {
+        page.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+OwnershipIndex::~OwnershipIndex() {
+    for (auto& slot : pages) {
+        Page* page = slot.load(std::memory_order_relaxed);
+        if (page == nullptr) {
+            continue;
+        }
+        for (auto& chunk : *page) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+        delete[] page;
+    }
+}
+
+OwnershipIndex::Record& OwnershipIndex::obtain(int markerValue) {
+    if (markerValue <= 0 || markerValue > kMaxMarkerValue) {
+        throw std::invalid_argument("Marker value out of range");
+    }
+    
+    const size_t value = static_cast<size_t>(markerValue);
+    Page* page = obtainSlot(pages[value / (kChunkSize * kPageSize)], [] {
+        // Value-initialized, so every chunk pointer starts out null.
+        return new Page[1]();
+    });
+    PaddedRecord* chunk = obtainSlot((*page)[value / kChunkSize % kPageSize], [] {
+        return new PaddedRecord[kChunkSize];
+    });
+    return chunk[value % kChunkSize];
+}
+
+const OwnershipIndex::Record* OwnershipIndex::find(int markerValue) const {
+    if (markerValue <= 0 || markerValue > kMaxMarkerValue) {
+        return nullptr;
+    }
+    
+    const size_t value = static_cast<size_t>(markerValue);
+    const Page* page = pages[value / (kChunkSize * kPageSize)].load(std::memory_order_acquire);
+    if (page == nullptr) {
+        return nullptr;
+    }
+    const PaddedRecord* chunk = (*page)[value / kChunkSize % kPageSize].load(std::memory_order_acquire);
+    return chunk ? &chunk[value % kChunkSize] : nullptr;
+}
+
+size_t OwnershipIndex::count(int markerValue) const {
+    const Record* record = find(markerValue);
+    return record ? record->count.load(std::memory_order_acquire) : 0;
+}
+
+bool OwnershipIndex::isRetired(int markerValue) const {
+    const Record* record = find(markerValue);
+    return record && record->retired.load(std::memory_order_acquire);
+}
+
+void OwnershipIndex::add(Record& record, size_t index) {
+    slots[index] = record.indices.size();
+    record.indices.push_back(index);
+    record.count.store(record.indices.size(), std::memory_order_release);
+}
+
+void OwnershipIndex::remove(Record& record, size_t index) {
+    const size_t position = slots[index];
+    const size_t last = record.indices.back();
+    
+    record.indices[position] = last;
+    slots[last] = position;
+    record.indices.pop_back();
+    record.count.store(record.indices.size(), std::memory_order_release);
+}
+
+std::vector<size_t> OwnershipIndex::takeAll(Record& record) {
+    std::vector<size_t> owned;
+    owned.swap(record.indices);
+    record.count.store(0, std::memory_order_release);
+    return owned;
+}
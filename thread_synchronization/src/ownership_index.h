@@ -0,0 +1,65 @@
+#ifndef OWNERSHIP_INDEX_H
+#define OWNERSHIP_INDEX_H
+
+#include "element_storage.h"
+#include <array>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+// Tracks which array indices each marker currently owns so that counting is
+// O(1) and releasing a marker costs O(elements it owns) instead of O(N).
+// Records cover every positive int but are allocated in chunks on first use,
+// so an index only pays for the marker values that were ever used.
+class OwnershipIndex {
+public:
+    static constexpr int kMaxMarkerValue = std::numeric_limits<int>::max();
+
+    struct Record {
+        std::mutex recordMutex;
+        std::vector<size_t> indices;
+        std::atomic<size_t> count{0};
+        // Set while cells of a retired marker may still hold its value; see
+        // ArrayManager::releaseMarkedElements.
+        std::atomic<bool> retired{false};
+    };
+
+    explicit OwnershipIndex(size_t elementCount);
+    ~OwnershipIndex();
+
+    OwnershipIndex(const OwnershipIndex&) = delete;
+    OwnershipIndex& operator=(const OwnershipIndex&) = delete;
+
+    // Returns the record for a marker, creating it on first use. The caller
+    // must hold record.recordMutex around add/remove/takeAll.
+    Record& obtain(int markerValue);
+    size_t count(int markerValue) const;
+    bool isRetired(int markerValue) const;
+
+    void add(Record& record, size_t index);
+    void remove(Record& record, size_t index);
+    std::vector<size_t> takeAll(Record& record);
+
+private:
+    // Records come in chunks, and chunk pointers in pages, so the fixed part
+    // is one small page table however large the value range is.
+    static constexpr size_t kChunkSize = 256;
+    static constexpr size_t kPageSize = 4096;
+    static constexpr size_t kPageCount =
+        (size_t(kMaxMarkerValue) + kChunkSize * kPageSize) / (kChunkSize * kPageSize);
+
+    struct alignas(64) PaddedRecord : Record {};
+    using Page = std::array<std::atomic<PaddedRecord*>, kPageSize>;
+
+    const Record* find(int markerValue) const;
+
+    std::array<std::atomic<Page*>, kPageCount> pages;
+    // Position of each element inside its current owner's index list; only
+    // accessed under that owner's recordMutex. Mapped lazily so untouched
+    // parts of a large array cost no memory here either.
+    MappedRegion slotMemory;
+    size_t* slots;
+};
+
+#endif
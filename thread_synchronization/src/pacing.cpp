@@ -0,0 +1,125 @@
+#include "pacing.h"
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PACING_HAS_TSC 1
+#endif
+
+namespace {
+
+uint64_t parseNumber(const std::string& text, const std::string& original) {
+    size_t pos = 0;
+    unsigned long long value = 0;
+    try {
+        if (text.empty() || text[0] == '-') {
+            throw std::invalid_argument(text);
+        }
+        value = std::stoull(text, &pos);
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Invalid pacing: " + original);
+    }
+    if (pos != text.size()) {
+        throw std::invalid_argument("Invalid pacing: " + original);
+    }
+    return value;
+}
+
+void spinFor(uint64_t cycles) {
+#ifdef PACING_HAS_TSC
+    const uint64_t start = __rdtsc();
+    while (__rdtsc() - start < cycles) {
+        _mm_pause();
+    }
+#else
+    // Without a cycle counter, treat one cycle as one nanosecond.
+    const auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(cycles);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+#endif
+}
+
+}
+
+PacingPolicy PacingPolicy::none() {
+    PacingPolicy policy;
+    policy.mode = PacingMode::None;
+    return policy;
+}
+
+PacingPolicy PacingPolicy::spin(uint64_t cycles) {
+    PacingPolicy policy;
+    policy.mode = PacingMode::Spin;
+    policy.spinCycles = cycles;
+    return policy;
+}
+
+PacingPolicy PacingPolicy::sleep(std::chrono::microseconds duration, std::chrono::microseconds jitter) {
+    if (duration.count() < 0 || jitter.count() < 0) {
+        throw std::invalid_argument("Sleep duration and jitter cannot be negative");
+    }
+    
+    PacingPolicy policy;
+    policy.mode = PacingMode::Sleep;
+    policy.sleepDuration = duration;
+    policy.sleepJitter = jitter;
+    return policy;
+}
+
+PacingPolicy parsePacingPolicy(const std::string& text) {
+    if (text == "none") {
+        return PacingPolicy::none();
+    }
+    
+    const size_t colon = text.find(':');
+    const std::string mode = text.substr(0, colon);
+    if (colon == std::string::npos) {
+        throw std::invalid_argument("Invalid pacing: " + text);
+    }
+    const std::string arguments = text.substr(colon + 1);
+    
+    if (mode == "spin") {
+        return PacingPolicy::spin(parseNumber(arguments, text));
+    }
+    if (mode == "sleep") {
+        const size_t jitterColon = arguments.find(':');
+        const auto duration = std::chrono::microseconds(parseNumber(arguments.substr(0, jitterColon), text));
+        const auto jitter = jitterColon == std::string::npos
+            ? std::chrono::microseconds(0)
+            : std::chrono::microseconds(parseNumber(arguments.substr(jitterColon + 1), text));
+        return PacingPolicy::sleep(duration, jitter);
+    }
+    
+    throw std::invalid_argument("Invalid pacing: " + text);
+}
+
+Pacer::Pacer(const PacingPolicy& policy, uint32_t seed) : policy(policy), jitterSource(seed + 1) {}
+
+void Pacer::pace() {
+    if (policy.mode == PacingMode::Sleep) {
+        std::this_thread::sleep_for(deferredPace());
+    } else {
+        deferredPace();
+    }
+}
+
+std::chrono::microseconds Pacer::deferredPace() {
+    switch (policy.mode) {
+        case PacingMode::None:
+            break;
+        case PacingMode::Spin:
+            spinFor(policy.spinCycles);
+            break;
+        case PacingMode::Sleep: {
+            auto duration = policy.sleepDuration;
+            if (policy.sleepJitter.count() > 0) {
+                std::uniform_int_distribution<long long> jitter(0, policy.sleepJitter.count());
+                duration += std::chrono::microseconds(jitter(jitterSource));
+            }
+            return duration;
+        }
+    }
+    return std::chrono::microseconds(0);
+}
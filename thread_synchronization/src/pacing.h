@@ -0,0 +1,48 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+
+enum class PacingMode {
+    None,   // no delay, maximum throughput
+    Spin,   // busy-spin, simulating CPU work between steps
+    Sleep   // sleep for a fixed or jittered duration
+};
+
+// How long a marker waits around each successful mark. The default matches
+// the original fixed 5ms sleeps.
+struct PacingPolicy {
+    PacingMode mode = PacingMode::Sleep;
+    uint64_t spinCycles = 0;
+    std::chrono::microseconds sleepDuration{5000};
+    // Each sleep adds a uniformly random extra delay in [0, sleepJitter].
+    std::chrono::microseconds sleepJitter{0};
+
+    static PacingPolicy none();
+    static PacingPolicy spin(uint64_t cycles);
+    static PacingPolicy sleep(std::chrono::microseconds duration,
+                              std::chrono::microseconds jitter = std::chrono::microseconds(0));
+};
+
+// Parses "none", "spin:CYCLES" or "sleep:MICROSECONDS[:JITTER_MICROSECONDS]".
+// Throws std::invalid_argument on malformed input.
+PacingPolicy parsePacingPolicy(const std::string& text);
+
+class Pacer {
+public:
+    Pacer(const PacingPolicy& policy, uint32_t seed);
+
+    void pace();
+    // Like pace(), but returns a sleep instead of taking it, for callers
+    // that must not block their thread.
+    std::chrono::microseconds deferredPace();
+
+private:
+    PacingPolicy policy;
+    std::minstd_rand jitterSource;
+};
+
+#endif
@@ -0,0 +1,378 @@
+#include "placement.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PLACEMENT_HAS_LINUX 1
+#endif
+
+namespace {
+
+// From <linux/mempolicy.h>, which needs kernel headers.
+constexpr int kMpolInterleave = 3;
+
+bool readLine(const std::string& path, std::string& line) {
+    std::ifstream in(path);
+    return static_cast<bool>(std::getline(in, line));
+}
+
+int readInt(const std::string& path, int fallback) {
+    std::string line;
+    if (!readLine(path, line)) {
+        return fallback;
+    }
+    try {
+        return std::stoi(line);
+    } catch (const std::exception&) {
+        return fallback;
+    }
+}
+
+int parseCpuNumber(const std::string& text, const std::string& original) {
+    size_t pos = 0;
+    int value = -1;
+    try {
+        if (text.empty() || text[0] == '-') {
+            throw std::invalid_argument(text);
+        }
+        value = std::stoi(text, &pos);
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Invalid CPU list: " + original);
+    }
+    if (pos != text.size()) {
+        throw std::invalid_argument("Invalid CPU list: " + original);
+    }
+    return value;
+}
+
+std::vector<int> allowedCpus() {
+    std::vector<int> allowed;
+#ifdef PLACEMENT_HAS_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                allowed.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (allowed.empty()) {
+        const unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int cpu = 0; cpu < count; ++cpu) {
+            allowed.push_back(static_cast<int>(cpu));
+        }
+    }
+    return allowed;
+}
+
+}
+
+CpuTopology::CpuTopology(std::vector<CpuInfo> cpus) : cpus(std::move(cpus)) {
+    if (this->cpus.empty()) {
+        throw std::invalid_argument("CPU topology needs at least one CPU");
+    }
+    std::sort(this->cpus.begin(), this->cpus.end(),
+              [](const CpuInfo& a, const CpuInfo& b) { return a.cpu < b.cpu; });
+}
+
+CpuTopology CpuTopology::detect() {
+    const std::string cpuRoot = "/sys/devices/system/cpu/cpu";
+    const std::string nodeRoot = "/sys/devices/system/node/";
+    
+    std::map<int, int> nodeOfCpu;
+    std::string line;
+    if (readLine(nodeRoot + "online", line)) {
+        try {
+            for (int node : parseCpuList(line)) {
+                std::string cpuList;
+                if (readLine(nodeRoot + "node" + std::to_string(node) + "/cpulist", cpuList) &&
+                    !cpuList.empty()) {
+                    for (int cpu : parseCpuList(cpuList)) {
+                        nodeOfCpu[cpu] = node;
+                    }
+                }
+            }
+        } catch (const std::invalid_argument&) {
+            nodeOfCpu.clear();
+        }
+    }
+    
+    std::vector<CpuInfo> cpus;
+    for (int cpu : allowedCpus()) {
+        const std::string topology = cpuRoot + std::to_string(cpu) + "/topology/";
+        const auto node = nodeOfCpu.find(cpu);
+        cpus.push_back({cpu,
+                        node != nodeOfCpu.end() ? node->second : 0,
+                        readInt(topology + "physical_package_id", 0),
+                        readInt(topology + "core_id", cpu)});
+    }
+    return CpuTopology(std::move(cpus));
+}
+
+const std::vector<CpuInfo>& CpuTopology::getCpus() const {
+    return cpus;
+}
+
+std::vector<int> CpuTopology::getNodes() const {
+    std::vector<int> nodes;
+    for (const auto& info : cpus) {
+        nodes.push_back(info.node);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    return nodes;
+}
+
+std::vector<int> CpuTopology::cpusOfNode(int node) const {
+    std::vector<int> result;
+    for (const auto& info : cpus) {
+        if (info.node == node) {
+            result.push_back(info.cpu);
+        }
+    }
+    return result;
+}
+
+bool CpuTopology::hasCpu(int cpu) const {
+    return std::any_of(cpus.begin(), cpus.end(), [cpu](const CpuInfo& info) { return info.cpu == cpu; });
+}
+
+std::vector<int> CpuTopology::compactOrder() const {
+    std::vector<CpuInfo> ordered = cpus;
+    std::sort(ordered.begin(), ordered.end(), [](const CpuInfo& a, const CpuInfo& b) {
+        return std::tie(a.node, a.package, a.core, a.cpu) < std::tie(b.node, b.package, b.core, b.cpu);
+    });
+    
+    std::vector<int> result;
+    for (const auto& info : ordered) {
+        result.push_back(info.cpu);
+    }
+    return result;
+}
+
+std::vector<int> CpuTopology::scatterOrder() const {
+    // Rank each CPU among the hyperthreads of its core; cpus is sorted by
+    // number, so the lowest-numbered sibling gets rank 0.
+    std::map<std::tuple<int, int, int>, int> siblingsSeen;
+    std::map<int, std::vector<std::tuple<int, int, int, int>>> byNode;
+    for (const auto& info : cpus) {
+        const int rank = siblingsSeen[std::make_tuple(info.node, info.package, info.core)]++;
+        byNode[info.node].emplace_back(rank, info.package, info.core, info.cpu);
+    }
+    
+    std::vector<std::vector<std::tuple<int, int, int, int>>> queues;
+    for (auto& entry : byNode) {
+        std::sort(entry.second.begin(), entry.second.end());
+        queues.push_back(std::move(entry.second));
+    }
+    
+    std::vector<int> result;
+    for (size_t position = 0; result.size() < cpus.size(); ++position) {
+        for (const auto& queue : queues) {
+            if (position < queue.size()) {
+                result.push_back(std::get<3>(queue[position]));
+            }
+        }
+    }
+    return result;
+}
+
+const CpuTopology& systemTopology() {
+    static const CpuTopology topology = CpuTopology::detect();
+    return topology;
+}
+
+AffinityPolicy AffinityPolicy::none() {
+    return AffinityPolicy();
+}
+
+AffinityPolicy AffinityPolicy::compact() {
+    AffinityPolicy policy;
+    policy.kind = AffinityKind::Compact;
+    return policy;
+}
+
+AffinityPolicy AffinityPolicy::scatter() {
+    AffinityPolicy policy;
+    policy.kind = AffinityKind::Scatter;
+    return policy;
+}
+
+AffinityPolicy AffinityPolicy::explicitCpus(std::vector<int> cpus) {
+    if (cpus.empty()) {
+        throw std::invalid_argument("Explicit affinity needs at least one CPU");
+    }
+    
+    AffinityPolicy policy;
+    policy.kind = AffinityKind::Explicit;
+    policy.cpus = std::move(cpus);
+    return policy;
+}
+
+AffinityPolicy parseAffinityPolicy(const std::string& text) {
+    if (text == "none") {
+        return AffinityPolicy::none();
+    } else if (text == "compact") {
+        return AffinityPolicy::compact();
+    } else if (text == "scatter") {
+        return AffinityPolicy::scatter();
+    } else if (text.rfind("cpus:", 0) == 0) {
+        return AffinityPolicy::explicitCpus(parseCpuList(text.substr(5)));
+    }
+    throw std::invalid_argument("Invalid affinity: " + text);
+}
+
+std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t end = text.find(',', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string range = text.substr(begin, end - begin);
+        const size_t dash = range.find('-');
+        
+        if (dash == std::string::npos) {
+            cpus.push_back(parseCpuNumber(range, text));
+        } else {
+            const int first = parseCpuNumber(range.substr(0, dash), text);
+            const int last = parseCpuNumber(range.substr(dash + 1), text);
+            if (last < first) {
+                throw std::invalid_argument("Invalid CPU list: " + text);
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        begin = end + 1;
+    }
+    return cpus;
+}
+
+int affinityCpu(const AffinityPolicy& policy, const CpuTopology& topology, size_t slot) {
+    switch (policy.kind) {
+        case AffinityKind::None:
+            return -1;
+        case AffinityKind::Compact: {
+            const std::vector<int> order = topology.compactOrder();
+            return order[slot % order.size()];
+        }
+        case AffinityKind::Scatter: {
+            const std::vector<int> order = topology.scatterOrder();
+            return order[slot % order.size()];
+        }
+        case AffinityKind::Explicit:
+            return policy.cpus[slot % policy.cpus.size()];
+    }
+    return -1;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+#ifdef PLACEMENT_HAS_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+NumaPlacement parseNumaPlacement(const std::string& text) {
+    if (text == "default") {
+        return NumaPlacement::Default;
+    } else if (text == "first-touch") {
+        return NumaPlacement::FirstTouch;
+    } else if (text == "interleave") {
+        return NumaPlacement::Interleave;
+    }
+    throw std::invalid_argument("Invalid NUMA placement: " + text);
+}
+
+bool interleaveMemory(void* base, size_t bytes, const CpuTopology& topology) {
+#if defined(PLACEMENT_HAS_LINUX) && defined(SYS_mbind)
+    const std::vector<int> nodes = topology.getNodes();
+    constexpr size_t kBitsPerWord = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(static_cast<size_t>(nodes.back()) / kBitsPerWord + 1, 0);
+    for (int node : nodes) {
+        mask[static_cast<size_t>(node) / kBitsPerWord] |= 1UL << (static_cast<size_t>(node) % kBitsPerWord);
+    }
+    
+    // mbind wants page-aligned ranges; a heap block may start mid-page.
+    const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t begin = (reinterpret_cast<uintptr_t>(base) + pageSize - 1) & ~(pageSize - 1);
+    const uintptr_t end = reinterpret_cast<uintptr_t>(base) + bytes;
+    if (begin >= end) {
+        return true;
+    }
+    // The kernel reads one bit fewer than maxnode.
+    return syscall(SYS_mbind, begin, end - begin, kMpolInterleave, mask.data(),
+                   mask.size() * kBitsPerWord + 1, 0) == 0;
+#else
+    (void)base;
+    (void)bytes;
+    (void)topology;
+    return false;
+#endif
+}
+
+void firstTouchMemory(void* base, size_t bytes, bool write, const CpuTopology& topology) {
+    if (bytes == 0) {
+        return;
+    }
+
+#ifdef PLACEMENT_HAS_LINUX
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    const size_t pageSize = 4096;
+#endif
+    const std::vector<int> nodes = topology.getNodes();
+    const size_t pages = (bytes + pageSize - 1) / pageSize;
+    const size_t slicePages = (pages + nodes.size() - 1) / nodes.size();
+    char* const bytesBase = static_cast<char*>(base);
+    
+    std::vector<std::thread> touchers;
+    for (size_t slice = 0; slice < nodes.size(); ++slice) {
+        const size_t firstPage = slice * slicePages;
+        const size_t lastPage = std::min(pages, firstPage + slicePages);
+        if (firstPage >= lastPage) {
+            break;
+        }
+        
+        touchers.emplace_back([=, &topology] {
+            // Unpinned touching still faults the pages in, just on whichever
+            // node the thread happens to run.
+            pinCurrentThread(topology.cpusOfNode(nodes[slice]));
+            for (size_t page = firstPage; page < lastPage; ++page) {
+                volatile char* cell = bytesBase + page * pageSize;
+                if (write) {
+                    *cell = *cell;
+                } else {
+                    (void)*cell;
+                }
+            }
+        });
+    }
+    for (auto& toucher : touchers) {
+        toucher.join();
+    }
+}
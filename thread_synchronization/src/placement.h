@@ -0,0 +1,84 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct CpuInfo {
+    int cpu;
+    int node;
+    int package;
+    int core;
+};
+
+// The CPUs this process may run on, with the NUMA node and physical core
+// each belongs to.
+class CpuTopology {
+public:
+    explicit CpuTopology(std::vector<CpuInfo> cpus);
+
+    // Reads /sys/devices/system/cpu, restricted to the process's affinity
+    // mask. Without sysfs every allowed CPU is its own core on node 0.
+    static CpuTopology detect();
+
+    const std::vector<CpuInfo>& getCpus() const;
+    std::vector<int> getNodes() const;
+    std::vector<int> cpusOfNode(int node) const;
+    bool hasCpu(int cpu) const;
+    // Fills one node before the next, hyperthread siblings back to back.
+    std::vector<int> compactOrder() const;
+    // Alternates between nodes, one thread per physical core before any
+    // core's siblings.
+    std::vector<int> scatterOrder() const;
+
+private:
+    std::vector<CpuInfo> cpus;
+};
+
+// Detected once on first use.
+const CpuTopology& systemTopology();
+
+enum class AffinityKind {
+    None,       // the scheduler places markers freely
+    Compact,    // pack markers onto as few nodes and cores as possible
+    Scatter,    // spread markers across nodes and cores
+    Explicit    // marker i runs on cpus[i % cpus.size()]
+};
+
+struct AffinityPolicy {
+    AffinityKind kind = AffinityKind::None;
+    std::vector<int> cpus;
+
+    static AffinityPolicy none();
+    static AffinityPolicy compact();
+    static AffinityPolicy scatter();
+    static AffinityPolicy explicitCpus(std::vector<int> cpus);
+};
+
+// "none", "compact", "scatter" or "cpus:LIST" with LIST like "0,2,8-11".
+AffinityPolicy parseAffinityPolicy(const std::string& text);
+// Linux CPU list syntax, as in /sys/devices/system/cpu/online.
+std::vector<int> parseCpuList(const std::string& text);
+// CPU for the marker in the given slot, or -1 to leave it unpinned. Slots
+// past the number of CPUs wrap around.
+int affinityCpu(const AffinityPolicy& policy, const CpuTopology& topology, size_t slot);
+// Restricts the calling thread to the given CPUs; false if the OS refused.
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+enum class NumaPlacement {
+    Default,        // the kernel's local allocation on first touch
+    FirstTouch,     // fault pages in up front, an equal slice from each node
+    Interleave      // round-robin pages across every node
+};
+
+NumaPlacement parseNumaPlacement(const std::string& text);
+// Sets an interleave policy on a not yet touched region; false where the
+// kernel does not support it.
+bool interleaveMemory(void* base, size_t bytes, const CpuTopology& topology);
+// Faults a region in from one thread per node, each pinned to its node and
+// touching a contiguous slice, so pages end up spread evenly over nodes.
+// With write false pages are only read, which keeps file contents intact.
+void firstTouchMemory(void* base, size_t bytes, bool write, const CpuTopology& topology);
+
+#endif
@@ -0,0 +1,318 @@
+#include "process_manager.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+std::string describeExit(int status) {
+    if (WIFSIGNALED(status)) {
+        return std::string("killed by ") + strsignal(WTERMSIG(status));
+    }
+    return "exited with status " + std::to_string(WEXITSTATUS(status));
+}
+
+}
+
+ProcessManager::SharedRound::SharedRound()
+    : startEvent(ParkingScope::Shared),
+      releaseEpoch(ParkingScope::Shared),
+      blockedSignal(0, ParkingScope::Shared) {}
+
+ProcessManager::ProcessManager(std::shared_ptr<ArrayManager> arrayManager)
+    : arrayManager(arrayManager),
+      round(nullptr),
+      slots(nullptr),
+      topology(systemTopology()) {
+    
+    if (!arrayManager) {
+        throw std::invalid_argument("Array manager cannot be null");
+    }
+    if (!arrayManager->getStorage().isShared()) {
+        throw std::invalid_argument("Marker processes need shm or file storage");
+    }
+    if (arrayManager->getBackend() != ArrayBackend::LockFree) {
+        throw std::invalid_argument("Marker processes need the lock-free backend");
+    }
+    
+    // One slot per possible marker id; untouched slots cost no memory.
+    const size_t slotCount = static_cast<size_t>(maxMarkerId()) + 1;
+    control = MappedRegion::shared(sizeof(MarkerSlot) * (slotCount + 1), HugePageMode::None);
+    static_assert(sizeof(SharedRound) <= sizeof(MarkerSlot), "Round state must fit the first slot");
+    round = new (control.data()) SharedRound();
+    slots = static_cast<MarkerSlot*>(control.data()) + 1;
+}
+
+ProcessManager::~ProcessManager() {
+    try {
+        for (const auto& marker : markers) {
+            slotOf(marker.id).command.store(static_cast<uint32_t>(MarkerCommand::Terminate));
+        }
+        round->startEvent.signal();
+        round->releaseEpoch.advance();
+        
+        for (const auto& marker : markers) {
+            if (marker.pid > 0) {
+                waitpid(marker.pid, nullptr, 0);
+            }
+        }
+        reapRetiredMarkers();
+    } catch (const std::exception& e) {
+        defaultLogger().log(LogLevel::Error, "Error during process manager shutdown: ", e.what());
+    }
+}
+
+void ProcessManager::setPacing(const PacingPolicy& policy) {
+    pacing = policy;
+}
+
+void ProcessManager::setAccessPolicy(const AccessPolicy& policy) {
+    access = policy;
+}
+
+void ProcessManager::setAffinity(const AffinityPolicy& policy, const CpuTopology& cpuTopology) {
+    for (int cpu : policy.cpus) {
+        if (!cpuTopology.hasCpu(cpu)) {
+            throw std::invalid_argument("CPU " + std::to_string(cpu) + " is not available");
+        }
+    }
+    
+    affinity = policy;
+    topology = cpuTopology;
+    for (auto& marker : markers) {
+        if (marker.pid < 0) {
+            marker.cpu = affinityCpu(affinity, topology, static_cast<size_t>(marker.id - 1));
+        }
+    }
+}
+
+void ProcessManager::createProcesses(int count) {
+    if (count <= 0) {
+        throw std::invalid_argument("Process count must be positive");
+    }
+    
+    const int firstId = nextId;
+    if (count > arrayManager->getMaxMarkerValue() - firstId + 1) {
+        throw std::invalid_argument("Marker ids would not fit the array's cells");
+    }
+    if (count > maxMarkerId() - firstId + 1) {
+        throw std::invalid_argument("Marker processes are limited to ids up to " +
+                                    std::to_string(kMaxMarkerId));
+    }
+    // Thread markers that ran on this array before may have left these ids
+    // retired.
+    arrayManager->sweepRetired();
+    for (int id = firstId; id < firstId + count; ++id) {
+        MarkerSlot& slot = slotOf(id);
+        slot.command.store(static_cast<uint32_t>(MarkerCommand::Continue));
+        slot.blockedEpoch.store(kRunning);
+        markers.push_back({id, -1, affinityCpu(affinity, topology, static_cast<size_t>(id - 1))});
+    }
+    nextId += count;
+}
+
+void ProcessManager::startAllProcesses() {
+    // Whatever is queued for the logger would otherwise be inherited, and
+    // its writer thread is not.
+    defaultLogger().flush();
+    
+    for (auto& marker : markers) {
+        if (marker.pid >= 0) {
+            continue;
+        }
+        const pid_t pid = fork();
+        if (pid < 0) {
+            throw std::runtime_error(std::string("Cannot fork marker process: ") + std::strerror(errno));
+        }
+        if (pid == 0) {
+            runMarker(marker);
+        }
+        marker.pid = pid;
+    }
+    round->startEvent.signal();
+}
+
+void ProcessManager::waitForAllProcessesBlocked() {
+    while (true) {
+        // Read before checking so an announcement made meanwhile is not
+        // slept through.
+        const uint32_t seen = round->blockedSignal.load();
+        reapDeadMarkers();
+        if (allBlocked()) {
+            return;
+        }
+        const ParkingWord::Deadline deadline = std::chrono::steady_clock::now() + kReapInterval;
+        round->blockedSignal.waitUntil([seen](uint32_t value) { return value != seen; }, &deadline);
+    }
+}
+
+void ProcessManager::terminateProcess(int id) {
+    auto it = std::find_if(markers.begin(), markers.end(),
+                           [id](const MarkerProcess& marker) { return marker.id == id; });
+    if (it == markers.end()) {
+        throw std::invalid_argument("Process " + std::to_string(id) + " is not active");
+    }
+    
+    // The marker is parked, so its cells are released here instead of waking
+    // it. Its ownership index lives in its own process, hence the scan.
+    MarkerSlot& slot = slotOf(id);
+    slot.command.store(static_cast<uint32_t>(MarkerCommand::Terminate));
+    arrayManager->sweepMarkedElements(id);
+    
+    retiredMarks += slot.totalMarks.load();
+    retiredMarkers.push_back(*it);
+    markers.erase(it);
+}
+
+void ProcessManager::continueOtherProcesses() {
+    round->releaseEpoch.advance();
+    reapRetiredMarkers();
+}
+
+bool ProcessManager::areAllProcessesFinished() const {
+    return markers.empty();
+}
+
+size_t ProcessManager::getActiveProcessCount() const {
+    return markers.size();
+}
+
+std::vector<int> ProcessManager::getActiveProcessIds() const {
+    std::vector<int> ids;
+    ids.reserve(markers.size());
+    for (const auto& marker : markers) {
+        ids.push_back(marker.id);
+    }
+    return ids;
+}
+
+pid_t ProcessManager::getPid(int id) const {
+    for (const auto& marker : markers) {
+        if (marker.id == id) {
+            return marker.pid;
+        }
+    }
+    return -1;
+}
+
+size_t ProcessManager::getMarkedCount(int id) const {
+    return slotOf(id).markedCount.load();
+}
+
+size_t ProcessManager::getBlockedIndex(int id) const {
+    return slotOf(id).blockedIndex.load();
+}
+
+size_t ProcessManager::getTotalMarks() const {
+    size_t total = retiredMarks;
+    for (const auto& marker : markers) {
+        total += slotOf(marker.id).totalMarks.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::vector<int> ProcessManager::getCrashedIds() const {
+    return crashedIds;
+}
+
+void ProcessManager::runMarker(const MarkerProcess& marker) {
+    // Only the forking thread exists here: no logging, and _exit so nothing
+    // the parent owns is destroyed or flushed twice.
+    int status = 0;
+    try {
+        if (marker.cpu >= 0) {
+            pinCurrentThread({marker.cpu});
+        }
+        markerLoop(slotOf(marker.id), marker.id);
+    } catch (...) {
+        status = 1;
+    }
+    _exit(status);
+}
+
+void ProcessManager::markerLoop(MarkerSlot& slot, int id) {
+    round->startEvent.wait();
+    Pacer pacer(pacing, static_cast<uint32_t>(id));
+    IndexGenerator indices(access, arrayManager->getSize(), static_cast<uint64_t>(id));
+    
+    while (true) {
+        const size_t index = indices.next();
+        if (arrayManager->markElement(index, id)) {
+            slot.totalMarks.fetch_add(1, std::memory_order_relaxed);
+            pacer.pace();
+            slot.markedCount.store(arrayManager->countMarkedElements(id));
+            pacer.pace();
+            continue;
+        }
+        
+        slot.markedCount.store(arrayManager->countMarkedElements(id));
+        slot.blockedIndex.store(index);
+        // Read the epoch before announcing the block, otherwise a release
+        // issued right after the announcement could be missed.
+        const uint32_t seenEpoch = round->releaseEpoch.current();
+        slot.blockedEpoch.store(seenEpoch);
+        round->blockedSignal.fetchAdd(1);
+        round->blockedSignal.wakeAll();
+        
+        // A shutdown may have set Terminate and released while this marker
+        // was still running; its release is then already spent.
+        if (slot.command.load() != static_cast<uint32_t>(MarkerCommand::Terminate)) {
+            round->releaseEpoch.waitForChange(seenEpoch);
+        }
+        slot.blockedEpoch.store(kRunning);
+        
+        if (slot.command.load() == static_cast<uint32_t>(MarkerCommand::Terminate)) {
+            // Usually a no-op: the manager has already swept these cells.
+            arrayManager->resetMarkedElements(id);
+            slot.markedCount.store(0);
+            return;
+        }
+    }
+}
+
+bool ProcessManager::allBlocked() const {
+    const uint32_t epoch = round->releaseEpoch.current();
+    return std::all_of(markers.begin(), markers.end(), [this, epoch](const MarkerProcess& marker) {
+        return slotOf(marker.id).blockedEpoch.load() == epoch;
+    });
+}
+
+void ProcessManager::reapDeadMarkers() {
+    for (auto it = markers.begin(); it != markers.end();) {
+        int status = 0;
+        if (it->pid <= 0 || waitpid(it->pid, &status, WNOHANG) != it->pid) {
+            ++it;
+            continue;
+        }
+        
+        const size_t released = arrayManager->sweepMarkedElements(it->id);
+        defaultLogger().log(LogLevel::Warning, "Marker process ", it->id, " ", describeExit(status),
+                            "; released ", released, " elements");
+        retiredMarks += slotOf(it->id).totalMarks.load();
+        crashedIds.push_back(it->id);
+        it = markers.erase(it);
+    }
+}
+
+void ProcessManager::reapRetiredMarkers() {
+    for (const auto& marker : retiredMarkers) {
+        if (marker.pid > 0) {
+            waitpid(marker.pid, nullptr, 0);
+        }
+    }
+    retiredMarkers.clear();
+}
+
+int ProcessManager::maxMarkerId() const {
+    return std::min(arrayManager->getMaxMarkerValue(), kMaxMarkerId);
+}
+
+ProcessManager::MarkerSlot& ProcessManager::slotOf(int id) const {
+    return slots[id];
+}
@@ -0,0 +1,128 @@
+#ifndef PROCESS_MANAGER_H
+#define PROCESS_MANAGER_H
+
+#include "array_manager.h"
+#include "element_storage.h"
+#include "index_generator.h"
+#include "marker_thread.h"
+#include "pacing.h"
+#include "placement.h"
+#include "sync_primitives.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sys/types.h>
+#include <vector>
+
+// ThreadManager's round protocol with every marker in a forked process of
+// its own. The array must live in shared storage and use the lock-free
+// backend: lock policies and the ownership index are private to each
+// process, so markers only meet on the cells themselves. The start gate,
+// block announcements and release epoch are process-shared futex words in a
+// shared control segment. A marker process that dies is contained: the
+// manager releases its cells by scanning the array and drops it from the
+// round.
+//
+// Marked counts come from the markers' shared slots; the manager's own
+// ArrayManager::countMarkedElements() and snapshot validation do not see
+// writes made by marker processes.
+class ProcessManager {
+public:
+    // Highest marker id a process may take. The control segment has a slot
+    // for every id up to this, whatever the array's cell width allows.
+    static constexpr int kMaxMarkerId = 65535;
+    
+    // Throws std::invalid_argument unless the array is shared and lock-free.
+    explicit ProcessManager(std::shared_ptr<ArrayManager> arrayManager);
+    // Terminates every marker process and reaps it.
+    ~ProcessManager();
+    
+    ProcessManager(const ProcessManager&) = delete;
+    ProcessManager& operator=(const ProcessManager&) = delete;
+    ProcessManager(ProcessManager&&) = delete;
+    ProcessManager& operator=(ProcessManager&&) = delete;
+    
+    // All three apply to markers created afterwards and to created but not
+    // yet started ones.
+    void setPacing(const PacingPolicy& policy);
+    void setAccessPolicy(const AccessPolicy& policy);
+    void setAffinity(const AffinityPolicy& policy, const CpuTopology& topology = systemTopology());
+    // Throws std::invalid_argument if the ids would pass the cell width's
+    // maximum or kMaxMarkerId.
+    void createProcesses(int count);
+    // Forks every marker created since the last start.
+    void startAllProcesses();
+    // Also reaps markers that died, releasing their cells.
+    void waitForAllProcessesBlocked();
+    void terminateProcess(int id);
+    void continueOtherProcesses();
+    bool areAllProcessesFinished() const;
+    size_t getActiveProcessCount() const;
+    std::vector<int> getActiveProcessIds() const;
+    // -1 for a marker that is not active or not started.
+    pid_t getPid(int id) const;
+    size_t getMarkedCount(int id) const;
+    size_t getBlockedIndex(int id) const;
+    size_t getTotalMarks() const;
+    // Markers whose process died without being terminated.
+    std::vector<int> getCrashedIds() const;
+
+private:
+    // One per marker id, written by the marker's process.
+    struct alignas(kCacheLineSize) MarkerSlot {
+        std::atomic<uint32_t> command;
+        // Release epoch the marker blocked in, or kRunning.
+        std::atomic<uint32_t> blockedEpoch;
+        std::atomic<uint64_t> markedCount;
+        std::atomic<uint64_t> totalMarks;
+        std::atomic<uint64_t> blockedIndex;
+    };
+    
+    // Lives at the start of the control segment.
+    struct SharedRound {
+        SharedRound();
+        
+        Event startEvent;
+        EpochEvent releaseEpoch;
+        // Bumped after every block announcement so the manager can park.
+        ParkingWord blockedSignal;
+    };
+    
+    struct MarkerProcess {
+        int id;
+        pid_t pid;
+        int cpu;
+    };
+    
+    static constexpr uint32_t kRunning = UINT32_MAX;
+    // How often the manager looks for dead markers while it waits.
+    static constexpr std::chrono::milliseconds kReapInterval{10};
+    
+    [[noreturn]] void runMarker(const MarkerProcess& marker);
+    void markerLoop(MarkerSlot& slot, int id);
+    bool allBlocked() const;
+    // Drops active markers whose process exited, releasing their cells.
+    void reapDeadMarkers();
+    void reapRetiredMarkers();
+    // The lower of the cell width's maximum and kMaxMarkerId.
+    int maxMarkerId() const;
+    MarkerSlot& slotOf(int id) const;
+    
+    std::shared_ptr<ArrayManager> arrayManager;
+    MappedRegion control;
+    SharedRound* round;
+    MarkerSlot* slots;
+    std::vector<MarkerProcess> markers;
+    PacingPolicy pacing;
+    AccessPolicy access;
+    AffinityPolicy affinity;
+    CpuTopology topology;
+    // Terminated markers stay parked until the next release lets them exit.
+    std::vector<MarkerProcess> retiredMarkers;
+    size_t retiredMarks = 0;
+    std::vector<int> crashedIds;
+    int nextId = 1;
+};
+
+#endif
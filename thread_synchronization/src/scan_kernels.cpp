@@ -0,0 +1,574 @@
+#include "scan_kernels.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline void countValue(size_t* bins, size_t binCount, int value, size_t amount) {
+    if (value >= 0 && static_cast<size_t>(value) < binCount) {
+        bins[value] += amount;
+    }
+}
+
+size_t countEqualScalar(const int* data, size_t size, int value) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        count += (data[i] == value);
+    }
+    return count;
+}
+
+size_t resetEqualScalar(int* data, size_t size, int value) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == value) {
+            data[i] = 0;
+            ++count;
+        }
+    }
+    return count;
+}
+
+void histogramScalar(const int* data, size_t size, size_t* bins, size_t binCount) {
+    for (size_t i = 0; i < size; ++i) {
+        countValue(bins, binCount, data[i], 1);
+    }
+}
+
+template <typename Cell>
+size_t countEqualNarrowScalar(const Cell* data, size_t size, Cell value) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        count += (data[i] == value);
+    }
+    return count;
+}
+
+template <typename Cell>
+size_t resetEqualNarrowScalar(Cell* data, size_t size, Cell value) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == value) {
+            data[i] = 0;
+            ++count;
+        }
+    }
+    return count;
+}
+
+template <typename Cell>
+void histogramNarrowScalar(const Cell* data, size_t size, size_t* bins, size_t binCount) {
+    for (size_t i = 0; i < size; ++i) {
+        countValue(bins, binCount, data[i], 1);
+    }
+}
+
+#ifdef SCAN_KERNELS_X86
+
+// Writes zero to the lanes selected by mask, one scalar store per match.
+inline size_t resetLanes(int* block, unsigned long long mask) {
+    size_t count = 0;
+    while (mask != 0) {
+        block[__builtin_ctzll(mask)] = 0;
+        mask &= mask - 1;
+        ++count;
+    }
+    return count;
+}
+
+// Narrow cells use GCC vector extensions so one body serves both widths; the
+// wrappers below compile it for each ISA. Byte and word compares would need
+// AVX-512BW, and at these widths AVX2 already streams at memory bandwidth, so
+// the AVX-512 table reuses the AVX2 versions. The compare-and-count
+// histogram uses the same vectors for int cells as well.
+//
+// Vectors only cross helper boundaries by reference: passing them by value
+// from code compiled without AVX would change the calling convention.
+template <typename Cell, size_t Bytes>
+struct LaneVector {
+    typedef Cell Type __attribute__((vector_size(Bytes)));
+    static constexpr size_t kLanes = Bytes / sizeof(Cell);
+    
+    __attribute__((always_inline)) static void load(Type& block, const Cell* data) {
+        std::memcpy(&block, data, sizeof(block));
+    }
+    
+    __attribute__((always_inline)) static void broadcast(Type& block, Cell value) {
+        block = Type{} + value;
+    }
+    
+    // Lane masks are all-ones or zero, so testing whole 64-bit words suffices.
+    __attribute__((always_inline)) static bool any(const Type& mask) {
+        uint64_t words[Bytes / 8];
+        std::memcpy(words, &mask, sizeof(words));
+        uint64_t combined = 0;
+        for (uint64_t word : words) {
+            combined |= word;
+        }
+        return combined != 0;
+    }
+    
+    __attribute__((always_inline)) static bool all(const Type& mask) {
+        uint64_t words[Bytes / 8];
+        std::memcpy(words, &mask, sizeof(words));
+        uint64_t combined = ~uint64_t(0);
+        for (uint64_t word : words) {
+            combined &= word;
+        }
+        return combined == ~uint64_t(0);
+    }
+};
+
+// Histograms take one of two routes. With few bins, every block is compared
+// against each bin's value and the matches are summed in per-bin vector
+// counters, so mixed blocks cost no scalar work at all. The passes over the
+// array grow with the bin count, so beyond kCompareBinLanes bins per lane
+// the kernels instead test each block for "every lane equals lane 0", count
+// uniform blocks (all free, or one marker's run) at once and update mixed
+// ones element by element.
+constexpr size_t kCompareBinGroup = 8;
+constexpr size_t kCompareBinLanes = 2;
+
+template <typename Cell, size_t Bytes>
+constexpr bool compareHistogramFits(size_t binCount) {
+    return binCount <= kCompareBinLanes * LaneVector<Cell, Bytes>::kLanes;
+}
+
+// One pass counting the bins firstBin..firstBin+binCount-1, at most Group of
+// them, over data[0, size); size is a multiple of the lane count. Group is a
+// compile-time constant so the counters stay in registers.
+template <typename Cell, size_t Bytes, size_t Group>
+__attribute__((always_inline)) inline
+void histogramComparePass(const Cell* data, size_t size, size_t* bins, size_t firstBin, size_t binCount) {
+    using Vector = LaneVector<Cell, Bytes>;
+    // Lanes count in cell-wide integers, so flush before they can wrap.
+    constexpr size_t kFlushBlocks = sizeof(Cell) >= 4 ? size_t(1) << 30
+                                                      : (size_t(1) << (8 * sizeof(Cell))) - 1;
+    // Values past binCount repeat the first bin; their counts are never read.
+    Cell values[Group];
+    for (size_t bin = 0; bin < Group; ++bin) {
+        values[bin] = static_cast<Cell>(firstBin + (bin < binCount ? bin : 0));
+    }
+    typename Vector::Type block{};
+    
+    size_t i = 0;
+    while (i < size) {
+        typename Vector::Type acc[Group] = {};
+        for (size_t blocks = 0; blocks < kFlushBlocks && i < size; ++blocks) {
+            Vector::load(block, data + i);
+            for (size_t bin = 0; bin < Group; ++bin) {
+                // The broadcasts are loop-invariant and stay in registers.
+                acc[bin] -= (typename Vector::Type)(block == (typename Vector::Type{} + values[bin]));
+            }
+            i += Vector::kLanes;
+        }
+        for (size_t bin = 0; bin < binCount; ++bin) {
+            for (size_t lane = 0; lane < Vector::kLanes; ++lane) {
+                bins[firstBin + bin] += static_cast<size_t>(acc[bin][lane]);
+            }
+        }
+    }
+}
+
+template <typename Cell, size_t Bytes>
+__attribute__((always_inline)) inline
+void histogramCompareVector(const Cell* data, size_t size, size_t* bins, size_t binCount) {
+    const size_t vectorEnd = size - size % LaneVector<Cell, Bytes>::kLanes;
+    for (size_t firstBin = 0; firstBin < binCount; firstBin += kCompareBinGroup) {
+        const size_t groupSize = std::min(kCompareBinGroup, binCount - firstBin);
+        if (groupSize <= kCompareBinGroup / 2) {
+            histogramComparePass<Cell, Bytes, kCompareBinGroup / 2>(data, vectorEnd, bins, firstBin, groupSize);
+        } else {
+            histogramComparePass<Cell, Bytes, kCompareBinGroup>(data, vectorEnd, bins, firstBin, groupSize);
+        }
+    }
+    
+    for (size_t i = vectorEnd; i < size; ++i) {
+        countValue(bins, binCount, data[i], 1);
+    }
+}
+
+__attribute__((target("sse2")))
+size_t countEqualSSE2(const int* data, size_t size, int value) {
+    // Lanes count in 32 bits, so flush the accumulator well before overflow.
+    constexpr size_t kFlushInterval = size_t(1) << 30;
+    const __m128i needle = _mm_set1_epi32(value);
+    const size_t vectorEnd = size & ~size_t(3);
+    size_t count = 0;
+    size_t i = 0;
+    
+    while (i < vectorEnd) {
+        const size_t chunkEnd = vectorEnd - i > kFlushInterval ? i + kFlushInterval : vectorEnd;
+        __m128i acc = _mm_setzero_si128();
+        for (; i < chunkEnd; i += 4) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(block, needle));
+        }
+        
+        alignas(16) unsigned int lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        count += static_cast<size_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    
+    return count + countEqualScalar(data + i, size - i, value);
+}
+
+__attribute__((target("sse2")))
+size_t resetEqualSSE2(int* data, size_t size, int value) {
+    const __m128i needle = _mm_set1_epi32(value);
+    size_t count = 0;
+    size_t i = 0;
+    
+    for (; i + 4 <= size; i += 4) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, needle)));
+        if (mask != 0) {
+            count += resetLanes(data + i, static_cast<unsigned long long>(mask));
+        }
+    }
+    
+    return count + resetEqualScalar(data + i, size - i, value);
+}
+
+__attribute__((target("sse2")))
+void histogramSSE2(const int* data, size_t size, size_t* bins, size_t binCount) {
+    if (compareHistogramFits<int, 16>(binCount)) {
+        histogramCompareVector<int, 16>(data, size, bins, binCount);
+        return;
+    }
+    
+    size_t i = 0;
+    
+    for (; i + 4 <= size; i += 4) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i first = _mm_shuffle_epi32(block, 0);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(block, first)) == 0xFFFF) {
+            countValue(bins, binCount, data[i], 4);
+        } else {
+            histogramScalar(data + i, 4, bins, binCount);
+        }
+    }
+    
+    histogramScalar(data + i, size - i, bins, binCount);
+}
+
+__attribute__((target("avx2")))
+size_t countEqualAVX2(const int* data, size_t size, int value) {
+    const __m256i needle = _mm256_set1_epi32(value);
+    size_t count = 0;
+    size_t i = 0;
+    
+    for (; i + 8 <= size; i += 8) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, needle)));
+        count += static_cast<size_t>(__builtin_popcount(static_cast<unsigned int>(mask)));
+    }
+    
+    return count + countEqualScalar(data + i, size - i, value);
+}
+
+__attribute__((target("avx2")))
+size_t resetEqualAVX2(int* data, size_t size, int value) {
+    const __m256i needle = _mm256_set1_epi32(value);
+    size_t count = 0;
+    size_t i = 0;
+    
+    for (; i + 8 <= size; i += 8) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, needle)));
+        if (mask != 0) {
+            count += resetLanes(data + i, static_cast<unsigned long long>(mask));
+        }
+    }
+    
+    return count + resetEqualScalar(data + i, size - i, value);
+}
+
+__attribute__((target("avx2")))
+void histogramAVX2(const int* data, size_t size, size_t* bins, size_t binCount) {
+    if (compareHistogramFits<int, 32>(binCount)) {
+        histogramCompareVector<int, 32>(data, size, bins, binCount);
+        return;
+    }
+    
+    size_t i = 0;
+    
+    for (; i + 8 <= size; i += 8) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i first = _mm256_set1_epi32(data[i]);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(block, first)) == -1) {
+            countValue(bins, binCount, data[i], 8);
+        } else {
+            histogramScalar(data + i, 8, bins, binCount);
+        }
+    }
+    
+    histogramScalar(data + i, size - i, bins, binCount);
+}
+
+__attribute__((target("avx512f")))
+size_t countEqualAVX512(const int* data, size_t size, int value) {
+    const __m512i needle = _mm512_set1_epi32(value);
+    size_t count = 0;
+    size_t i = 0;
+    
+    for (; i + 16 <= size; i += 16) {
+        const __m512i block = _mm512_loadu_si512(data + i);
+        const __mmask16 mask = _mm512_cmpeq_epi32_mask(block, needle);
+        count += static_cast<size_t>(__builtin_popcount(mask));
+    }
+    
+    if (i < size) {
+        const __mmask16 tail = static_cast<__mmask16>((1u << (size - i)) - 1);
+        const __m512i block = _mm512_maskz_loadu_epi32(tail, data + i);
+        count += static_cast<size_t>(__builtin_popcount(_mm512_mask_cmpeq_epi32_mask(tail, block, needle)));
+    }
+    
+    return count;
+}
+
+__attribute__((target("avx512f")))
+size_t resetEqualAVX512(int* data, size_t size, int value) {
+    const __m512i needle = _mm512_set1_epi32(value);
+    const __m512i zero = _mm512_setzero_si512();
+    size_t count = 0;
+    
+    for (size_t i = 0; i < size; i += 16) {
+        const __mmask16 lanes = size - i >= 16
+            ? static_cast<__mmask16>(0xFFFF)
+            : static_cast<__mmask16>((1u << (size - i)) - 1);
+        const __m512i block = _mm512_maskz_loadu_epi32(lanes, data + i);
+        const __mmask16 mask = _mm512_mask_cmpeq_epi32_mask(lanes, block, needle);
+        if (mask != 0) {
+            // Masked stores only write the selected lanes.
+            _mm512_mask_storeu_epi32(data + i, mask, zero);
+            count += static_cast<size_t>(__builtin_popcount(mask));
+        }
+    }
+    
+    return count;
+}
+
+__attribute__((target("avx512f")))
+void histogramAVX512(const int* data, size_t size, size_t* bins, size_t binCount) {
+    if (compareHistogramFits<int, 64>(binCount)) {
+        histogramCompareVector<int, 64>(data, size, bins, binCount);
+        return;
+    }
+    
+    size_t i = 0;
+    
+    for (; i + 16 <= size; i += 16) {
+        const __m512i block = _mm512_loadu_si512(data + i);
+        const __m512i first = _mm512_set1_epi32(data[i]);
+        if (_mm512_cmpeq_epi32_mask(block, first) == 0xFFFF) {
+            countValue(bins, binCount, data[i], 16);
+        } else {
+            histogramScalar(data + i, 16, bins, binCount);
+        }
+    }
+    
+    histogramScalar(data + i, size - i, bins, binCount);
+}
+
+template <typename Cell, size_t Bytes>
+__attribute__((always_inline)) inline
+size_t countEqualNarrowVector(const Cell* data, size_t size, Cell value) {
+    using Vector = LaneVector<Cell, Bytes>;
+    // Lanes count in cell-wide integers, so flush before they can wrap.
+    constexpr size_t kFlushBlocks = (size_t(1) << (8 * sizeof(Cell))) - 1;
+    typename Vector::Type needle{};
+    typename Vector::Type block{};
+    Vector::broadcast(needle, value);
+    size_t count = 0;
+    size_t i = 0;
+    
+    while (i + Vector::kLanes <= size) {
+        typename Vector::Type acc = {};
+        for (size_t blocks = 0; blocks < kFlushBlocks && i + Vector::kLanes <= size; ++blocks) {
+            Vector::load(block, data + i);
+            acc -= (typename Vector::Type)(block == needle);
+            i += Vector::kLanes;
+        }
+        for (size_t lane = 0; lane < Vector::kLanes; ++lane) {
+            count += acc[lane];
+        }
+    }
+    
+    return count + countEqualNarrowScalar(data + i, size - i, value);
+}
+
+template <typename Cell, size_t Bytes>
+__attribute__((always_inline)) inline
+size_t resetEqualNarrowVector(Cell* data, size_t size, Cell value) {
+    using Vector = LaneVector<Cell, Bytes>;
+    typename Vector::Type needle{};
+    typename Vector::Type block{};
+    Vector::broadcast(needle, value);
+    size_t count = 0;
+    size_t i = 0;
+    
+    for (; i + Vector::kLanes <= size; i += Vector::kLanes) {
+        Vector::load(block, data + i);
+        const typename Vector::Type mask = (typename Vector::Type)(block == needle);
+        if (Vector::any(mask)) {
+            // Only matching cells are written, as in the int kernels.
+            count += resetEqualNarrowScalar(data + i, Vector::kLanes, value);
+        }
+    }
+    
+    return count + resetEqualNarrowScalar(data + i, size - i, value);
+}
+
+template <typename Cell, size_t Bytes>
+__attribute__((always_inline)) inline
+void histogramNarrowVector(const Cell* data, size_t size, size_t* bins, size_t binCount) {
+    if (compareHistogramFits<Cell, Bytes>(binCount)) {
+        histogramCompareVector<Cell, Bytes>(data, size, bins, binCount);
+        return;
+    }
+    
+    using Vector = LaneVector<Cell, Bytes>;
+    typename Vector::Type first{};
+    typename Vector::Type block{};
+    size_t i = 0;
+    
+    for (; i + Vector::kLanes <= size; i += Vector::kLanes) {
+        Vector::load(block, data + i);
+        Vector::broadcast(first, data[i]);
+        const typename Vector::Type mask = (typename Vector::Type)(block == first);
+        if (Vector::all(mask)) {
+            countValue(bins, binCount, data[i], Vector::kLanes);
+        } else {
+            histogramNarrowScalar(data + i, Vector::kLanes, bins, binCount);
+        }
+    }
+    
+    histogramNarrowScalar(data + i, size - i, bins, binCount);
+}
+
+template <typename Cell>
+__attribute__((target("sse2")))
+size_t countEqualNarrowSSE2(const Cell* data, size_t size, Cell value) {
+    return countEqualNarrowVector<Cell, 16>(data, size, value);
+}
+
+template <typename Cell>
+__attribute__((target("sse2")))
+size_t resetEqualNarrowSSE2(Cell* data, size_t size, Cell value) {
+    return resetEqualNarrowVector<Cell, 16>(data, size, value);
+}
+
+template <typename Cell>
+__attribute__((target("sse2")))
+void histogramNarrowSSE2(const Cell* data, size_t size, size_t* bins, size_t binCount) {
+    histogramNarrowVector<Cell, 16>(data, size, bins, binCount);
+}
+
+template <typename Cell>
+__attribute__((target("avx2")))
+size_t countEqualNarrowAVX2(const Cell* data, size_t size, Cell value) {
+    return countEqualNarrowVector<Cell, 32>(data, size, value);
+}
+
+template <typename Cell>
+__attribute__((target("avx2")))
+size_t resetEqualNarrowAVX2(Cell* data, size_t size, Cell value) {
+    return resetEqualNarrowVector<Cell, 32>(data, size, value);
+}
+
+template <typename Cell>
+__attribute__((target("avx2")))
+void histogramNarrowAVX2(const Cell* data, size_t size, size_t* bins, size_t binCount) {
+    histogramNarrowVector<Cell, 32>(data, size, bins, binCount);
+}
+
+#endif
+
+template <typename Cell>
+constexpr NarrowScanKernels<Cell> narrowScalarKernels{
+    countEqualNarrowScalar<Cell>, resetEqualNarrowScalar<Cell>, histogramNarrowScalar<Cell>};
+
+const ScanKernels scalarKernels{countEqualScalar, resetEqualScalar, histogramScalar,
+                                narrowScalarKernels<uint8_t>, narrowScalarKernels<uint16_t>};
+
+#ifdef SCAN_KERNELS_X86
+template <typename Cell>
+constexpr NarrowScanKernels<Cell> narrowSSE2Kernels{
+    countEqualNarrowSSE2<Cell>, resetEqualNarrowSSE2<Cell>, histogramNarrowSSE2<Cell>};
+template <typename Cell>
+constexpr NarrowScanKernels<Cell> narrowAVX2Kernels{
+    countEqualNarrowAVX2<Cell>, resetEqualNarrowAVX2<Cell>, histogramNarrowAVX2<Cell>};
+
+const ScanKernels sse2Kernels{countEqualSSE2, resetEqualSSE2, histogramSSE2,
+                              narrowSSE2Kernels<uint8_t>, narrowSSE2Kernels<uint16_t>};
+const ScanKernels avx2Kernels{countEqualAVX2, resetEqualAVX2, histogramAVX2,
+                              narrowAVX2Kernels<uint8_t>, narrowAVX2Kernels<uint16_t>};
+const ScanKernels avx512Kernels{countEqualAVX512, resetEqualAVX512, histogramAVX512,
+                                narrowAVX2Kernels<uint8_t>, narrowAVX2Kernels<uint16_t>};
+#endif
+
+}
+
+bool isScanIsaSupported(ScanIsa isa) {
+    switch (isa) {
+        case ScanIsa::Scalar:
+            return true;
+#ifdef SCAN_KERNELS_X86
+        case ScanIsa::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case ScanIsa::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case ScanIsa::AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+ScanIsa bestScanIsa() {
+    for (ScanIsa isa : {ScanIsa::AVX512, ScanIsa::AVX2, ScanIsa::SSE2}) {
+        if (isScanIsaSupported(isa)) {
+            return isa;
+        }
+    }
+    return ScanIsa::Scalar;
+}
+
+const char* scanIsaName(ScanIsa isa) {
+    switch (isa) {
+        case ScanIsa::Scalar: return "scalar";
+        case ScanIsa::SSE2: return "sse2";
+        case ScanIsa::AVX2: return "avx2";
+        case ScanIsa::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+const ScanKernels& scanKernels(ScanIsa isa) {
+    if (!isScanIsaSupported(isa)) {
+        throw std::invalid_argument(std::string("Scan ISA not supported: ") + scanIsaName(isa));
+    }
+    
+    switch (isa) {
+#ifdef SCAN_KERNELS_X86
+        case ScanIsa::SSE2: return sse2Kernels;
+        case ScanIsa::AVX2: return avx2Kernels;
+        case ScanIsa::AVX512: return avx512Kernels;
+#endif
+        default: return scalarKernels;
+    }
+}
+
+const ScanKernels& scanKernels() {
+    static const ScanKernels& best = scanKernels(bestScanIsa());
+    return best;
+}
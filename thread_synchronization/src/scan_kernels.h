@@ -0,0 +1,48 @@
+#ifndef SCAN_KERNELS_H
+#define SCAN_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class ScanIsa {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+// The same kernels for narrow cells (see CellWidth in array_manager.h).
+template <typename Cell>
+struct NarrowScanKernels {
+    size_t (*countEqual)(const Cell* data, size_t size, Cell value);
+    size_t (*resetEqual)(Cell* data, size_t size, Cell value);
+    void (*histogram)(const Cell* data, size_t size, size_t* bins, size_t binCount);
+};
+
+// Full-array scan kernels. Every ISA variant must produce exactly the same
+// results as the scalar one; the vector versions only exist to run the
+// unavoidable O(N) passes at memory bandwidth.
+struct ScanKernels {
+    size_t (*countEqual)(const int* data, size_t size, int value);
+    // Zeroes every element equal to value and returns how many were zeroed.
+    // Only matching elements are written, so concurrent writers to other
+    // elements are never overwritten.
+    size_t (*resetEqual)(int* data, size_t size, int value);
+    // Adds the number of occurrences of each value in [0, binCount) to bins.
+    // Values outside that range are ignored.
+    void (*histogram)(const int* data, size_t size, size_t* bins, size_t binCount);
+    
+    NarrowScanKernels<uint8_t> bytes;
+    NarrowScanKernels<uint16_t> halfwords;
+};
+
+bool isScanIsaSupported(ScanIsa isa);
+ScanIsa bestScanIsa();
+const char* scanIsaName(ScanIsa isa);
+
+// Throws std::invalid_argument if the ISA is not supported by this CPU/build.
+const ScanKernels& scanKernels(ScanIsa isa);
+// Kernels for the best ISA available at runtime, resolved once.
+const ScanKernels& scanKernels();
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include "lock_policies.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// How a SegmentedSeqLock::read() copy came out.
+enum class SeqLockRead {
+    Consistent,          // one pass saw no concurrent write
+    SegmentsConsistent,  // each segment is consistent, the whole may not be
+    Failed               // some segment kept changing; the copy is unusable
+};
+
+// Sequence words that let readers take consistent copies of the array without
+// ever blocking writers. The array is split into fixed segments, each with
+// its own word, plus one word for writes spanning many segments.
+//
+// Unlike a classic seqlock several writers may be inside one segment at once
+// (the lock-free backend has no writer lock), so a word packs the number of
+// writers in flight into its low bits and a version into the high bits.
+// Readers retry while a segment has writers in flight or its word changed
+// during the copy.
+//
+// Readers are rare, so writers only touch the words while one is registered.
+// A writer that found no reader makes its store, then checks again and bumps
+// the segment's version if a reader arrived meanwhile: either the reader's
+// copy sees the store, or its validation sees the bump.
+class SegmentedSeqLock {
+public:
+    static constexpr size_t kSegmentShift = 10;
+    static constexpr size_t kSegmentSize = size_t(1) << kSegmentShift;
+
+    explicit SegmentedSeqLock(size_t elementCount)
+        : elementCount(elementCount),
+          segmentCount((elementCount + kSegmentSize - 1) >> kSegmentShift),
+          segments(std::make_unique<Segment[]>(segmentCount)) {}
+
+    // Runs store() as a write to element index and returns its result. The
+    // store must be sequentially consistent, so that it and the reader check
+    // after it cannot both miss a registering reader.
+    template <typename Store>
+    auto write(size_t index, Store store) {
+        if (readers.load() != 0) {
+            beginWrite(index);
+            auto result = store();
+            endWrite(index);
+            return result;
+        }
+        auto result = store();
+        if (readers.load() != 0) {
+            segments[index >> kSegmentShift].word.fetch_add(kVersionUnit, std::memory_order_release);
+        }
+        return result;
+    }
+
+    // beginWrite has acquire semantics so the data store cannot move above
+    // it; endWrite releases the store.
+    void beginWrite(size_t index) {
+        segments[index >> kSegmentShift].word.fetch_add(1, std::memory_order_acq_rel);
+    }
+    void endWrite(size_t index) {
+        segments[index >> kSegmentShift].word.fetch_add(kVersionUnit - 1, std::memory_order_release);
+    }
+    // Bulk writes are rare and always bracketed.
+    void beginBulkWrite() {
+        bulk.word.fetch_add(1, std::memory_order_acq_rel);
+    }
+    void endBulkWrite() {
+        bulk.word.fetch_add(kVersionUnit - 1, std::memory_order_release);
+    }
+
+    // Calls copy(begin, end) over element ranges covering the whole array
+    // until one pass saw no concurrent write. After maxAttempts failed
+    // whole-array passes it validates segment by segment, giving each
+    // segment as many attempts, and fails if one still never settles.
+    template <typename CopyRange>
+    SeqLockRead read(CopyRange copy, size_t maxAttempts) const;
+
+private:
+    static constexpr uint64_t kVersionUnit = uint64_t(1) << 32;
+    static constexpr uint64_t kWriterMask = kVersionUnit - 1;
+    // Yields a reader waits for a segment's writers to leave before it
+    // counts the attempt as failed.
+    static constexpr int kQuiescentYields = 64;
+
+    struct alignas(kCacheLineSize) Segment {
+        std::atomic<uint64_t> word{0};
+    };
+
+    // Registered for the whole of a read().
+    class ReaderGuard {
+    public:
+        explicit ReaderGuard(std::atomic<uint32_t>& readers) : readers(readers) {
+            readers.fetch_add(1);
+            // Pairs with the writers' store-then-check.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        ~ReaderGuard() {
+            readers.fetch_sub(1, std::memory_order_release);
+        }
+        ReaderGuard(const ReaderGuard&) = delete;
+        ReaderGuard& operator=(const ReaderGuard&) = delete;
+
+    private:
+        std::atomic<uint32_t>& readers;
+    };
+
+    static bool hasWriters(uint64_t word) {
+        return (word & kWriterMask) != 0;
+    }
+    // Loads a word once no writer is inside it; false if writers stayed.
+    static bool loadQuiescent(const Segment& segment, uint64_t& word) {
+        word = segment.word.load(std::memory_order_acquire);
+        for (int yields = 0; hasWriters(word); ++yields) {
+            if (yields == kQuiescentYields) {
+                return false;
+            }
+            std::this_thread::yield();
+            word = segment.word.load(std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    size_t elementCount;
+    size_t segmentCount;
+    std::unique_ptr<Segment[]> segments;
+    Segment bulk;
+    mutable std::atomic<uint32_t> readers{0};
+};
+
+template <typename CopyRange>
+SeqLockRead SegmentedSeqLock::read(CopyRange copy, size_t maxAttempts) const {
+    ReaderGuard guard(readers);
+    std::vector<uint64_t> seen(segmentCount);
+    
+    for (size_t attempt = 0; attempt < maxAttempts; ++attempt) {
+        uint64_t bulkSeen = 0;
+        bool quiescent = loadQuiescent(bulk, bulkSeen);
+        for (size_t s = 0; quiescent && s < segmentCount; ++s) {
+            quiescent = loadQuiescent(segments[s], seen[s]);
+        }
+        if (!quiescent) {
+            continue;
+        }
+        
+        copy(size_t(0), elementCount);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        
+        bool unchanged = bulk.word.load(std::memory_order_relaxed) == bulkSeen;
+        for (size_t s = 0; unchanged && s < segmentCount; ++s) {
+            unchanged = segments[s].word.load(std::memory_order_relaxed) == seen[s];
+        }
+        if (unchanged) {
+            return SeqLockRead::Consistent;
+        }
+    }
+    
+    for (size_t s = 0; s < segmentCount; ++s) {
+        const size_t begin = s << kSegmentShift;
+        const size_t end = std::min(begin + kSegmentSize, elementCount);
+        bool settled = false;
+        for (size_t attempt = 0; attempt < maxAttempts && !settled; ++attempt) {
+            uint64_t bulkSeen = 0;
+            uint64_t segmentSeen = 0;
+            if (!loadQuiescent(bulk, bulkSeen) || !loadQuiescent(segments[s], segmentSeen)) {
+                continue;
+            }
+            copy(begin, end);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            settled = segments[s].word.load(std::memory_order_relaxed) == segmentSeen &&
+                      bulk.word.load(std::memory_order_relaxed) == bulkSeen;
+        }
+        if (!settled) {
+            return SeqLockRead::Failed;
+        }
+    }
+    return SeqLockRead::SegmentsConsistent;
+}
+
+#endif
@@ -1,84 +1,248 @@
 #include "sync_primitives.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
 
-Event::Event() : signaled(false) {}
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+#endif
 
-void Event::signal() {
-    {
-        std::lock_guard<std::mutex> lock(eventMutex);
-        signaled = true;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "ParkingWord parks on the address of its atomic word");
+
+namespace {
+
+#if !defined(__linux__)
+// Fallback parking lot: waiters on a word share one of a fixed set of
+// mutex/condition variable buckets hashed from the word's address.
+struct ParkingBucket {
+    std::mutex bucketMutex;
+    std::condition_variable bucketCV;
+};
+
+ParkingBucket& bucketFor(const void* address) {
+    static ParkingBucket buckets[64];
+    return buckets[(reinterpret_cast<uintptr_t>(address) >> 4) % 64];
+}
+#endif
+
+}
+
+ParkingWord::ParkingWord(uint32_t initial, ParkingScope scope)
+    : word(initial), waiters(0), spinLimit(kMinSpin * 8), parkCount(0), scope(scope) {}
+
+uint32_t ParkingWord::load(std::memory_order order) const {
+    return word.load(order);
+}
+
+void ParkingWord::store(uint32_t value) {
+    word.store(value, std::memory_order_seq_cst);
+}
+
+uint32_t ParkingWord::fetchAdd(uint32_t delta) {
+    return word.fetch_add(delta, std::memory_order_seq_cst);
+}
+
+bool ParkingWord::compareExchange(uint32_t& expected, uint32_t desired) {
+    return word.compare_exchange_weak(expected, desired, std::memory_order_seq_cst);
+}
+
+uint32_t ParkingWord::getParkCount() const {
+    return parkCount.load(std::memory_order_relaxed);
+}
+
+void ParkingWord::wakeAll() {
+    // Pairs with the seq_cst increment/load in waitUntil: either the waiter
+    // sees the new value or we see the waiter.
+    if (waiters.load(std::memory_order_seq_cst) == 0) {
+        return;
     }
-    eventCV.notify_all();
+
+#if defined(__linux__)
+    // Private futexes are keyed by address within this process; shared ones
+    // by the underlying page, so every process mapping it sees the wake.
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word),
+            scope == ParkingScope::Shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, INT_MAX,
+            nullptr, nullptr, 0);
+#else
+    ParkingBucket& bucket = bucketFor(&word);
+    std::lock_guard<std::mutex> lock(bucket.bucketMutex);
+    bucket.bucketCV.notify_all();
+#endif
+}
+
+void ParkingWord::wakeOne() {
+    if (waiters.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word),
+            scope == ParkingScope::Shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, 1,
+            nullptr, nullptr, 0);
+#else
+    // Other words share the bucket, so notify_one could pick a waiter of
+    // theirs and lose this wake.
+    ParkingBucket& bucket = bucketFor(&word);
+    std::lock_guard<std::mutex> lock(bucket.bucketMutex);
+    bucket.bucketCV.notify_all();
+#endif
+}
+
+void ParkingWord::park(uint32_t expected, const Deadline* deadline) {
+#if defined(__linux__)
+    timespec timeout{};
+    timespec* timeoutPtr = nullptr;
+    if (deadline) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            *deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return;
+        }
+        timeout.tv_sec = static_cast<time_t>(remaining.count() / 1000000000);
+        timeout.tv_nsec = static_cast<long>(remaining.count() % 1000000000);
+        timeoutPtr = &timeout;
+    }
+    
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word),
+            scope == ParkingScope::Shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, expected,
+            timeoutPtr, nullptr, 0);
+#else
+    ParkingBucket& bucket = bucketFor(&word);
+    std::unique_lock<std::mutex> lock(bucket.bucketMutex);
+    if (word.load(std::memory_order_seq_cst) != expected) {
+        return;
+    }
+    Deadline until = deadline ? *deadline : Deadline::max();
+    if (scope == ParkingScope::Shared) {
+        until = std::min(until, std::chrono::steady_clock::now() + kSharedPollInterval);
+    }
+    if (until == Deadline::max()) {
+        bucket.bucketCV.wait(lock);
+    } else {
+        bucket.bucketCV.wait_until(lock, until);
+    }
+#endif
+}
+
+void ParkingWord::cpuRelax() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+Event::Event(ParkingScope scope) : state(0, scope) {}
+
+void Event::signal() {
+    state.store(1);
+    state.wakeAll();
 }
 
 void Event::reset() {
-    std::lock_guard<std::mutex> lock(eventMutex);
-    signaled = false;
+    // Nobody waits for the event to be cleared.
+    state.store(0);
 }
 
 void Event::wait() {
-    std::unique_lock<std::mutex> lock(eventMutex);
-    eventCV.wait(lock, [this] { return signaled; });
+    state.waitUntil([](uint32_t value) { return value != 0; });
 }
 
 bool Event::waitFor(std::chrono::milliseconds timeout) {
-    std::unique_lock<std::mutex> lock(eventMutex);
-    return eventCV.wait_for(lock, timeout, [this] { return signaled; });
+    const ParkingWord::Deadline deadline = std::chrono::steady_clock::now() + timeout;
+    return state.waitUntil([](uint32_t value) { return value != 0; }, &deadline);
 }
 
 bool Event::isSignaled() const {
-    std::lock_guard<std::mutex> lock(eventMutex);
-    return signaled;
+    return state.load() != 0;
+}
+
+uint32_t Event::getParkCount() const {
+    return state.getParkCount();
 }
 
-CountdownEvent::CountdownEvent(int initialCount) : remainingCount(initialCount) {
+CountdownEvent::CountdownEvent(int initialCount, ParkingScope scope) : remainingCount(0, scope) {
     if (initialCount < 0) {
         throw std::invalid_argument("Initial count cannot be negative");
     }
+    remainingCount.store(static_cast<uint32_t>(initialCount));
 }
 
 void CountdownEvent::addCount(int count) {
-    {
-        std::lock_guard<std::mutex> lock(countMutex);
-        if (remainingCount == 0) {
+    uint32_t current = remainingCount.load();
+    do {
+        if (current == 0) {
             throw std::logic_error("Cannot add to a countdown event that has already been signaled");
         }
-        remainingCount += count;
-    }
+    } while (!remainingCount.compareExchange(current, current + static_cast<uint32_t>(count)));
 }
 
 void CountdownEvent::signal() {
-    bool shouldSignal = false;
-    {
-        std::lock_guard<std::mutex> lock(countMutex);
-        if (remainingCount > 0) {
-            --remainingCount;
-        }
-        shouldSignal = (remainingCount == 0);
+    uint32_t current = remainingCount.load();
+    while (current > 0 && !remainingCount.compareExchange(current, current - 1)) {
     }
-    
-    if (shouldSignal) {
-        countCV.notify_all();
+    // Waiters only care about the count reaching zero.
+    if (current == 1) {
+        remainingCount.wakeAll();
     }
 }
 
 void CountdownEvent::wait() {
-    std::unique_lock<std::mutex> lock(countMutex);
-    countCV.wait(lock, [this] { return remainingCount == 0; });
+    remainingCount.waitUntil([](uint32_t value) { return value == 0; });
 }
 
 bool CountdownEvent::waitFor(std::chrono::milliseconds timeout) {
-    std::unique_lock<std::mutex> lock(countMutex);
-    return countCV.wait_for(lock, timeout, [this] { return remainingCount == 0; });
+    const ParkingWord::Deadline deadline = std::chrono::steady_clock::now() + timeout;
+    return remainingCount.waitUntil([](uint32_t value) { return value == 0; }, &deadline);
 }
 
 bool CountdownEvent::isSet() const {
-    std::lock_guard<std::mutex> lock(countMutex);
-    return remainingCount == 0;
+    return remainingCount.load() == 0;
 }
 
 void CountdownEvent::reset(int count) {
-    std::lock_guard<std::mutex> lock(countMutex);
-    remainingCount = count;
+    remainingCount.store(static_cast<uint32_t>(count));
+    if (count == 0) {
+        remainingCount.wakeAll();
+    }
+}
+
+uint32_t CountdownEvent::getParkCount() const {
+    return remainingCount.getParkCount();
+}
+
+EpochEvent::EpochEvent(ParkingScope scope) : epoch(0, scope) {}
+
+uint32_t EpochEvent::current() const {
+    return epoch.load();
+}
+
+uint32_t EpochEvent::advance() {
+    const uint32_t advanced = epoch.fetchAdd(1) + 1;
+    epoch.wakeAll();
+    return advanced;
+}
+
+void EpochEvent::waitForChange(uint32_t seenEpoch) {
+    epoch.waitUntil([seenEpoch](uint32_t value) { return value != seenEpoch; });
+}
+
+bool EpochEvent::waitForChangeFor(uint32_t seenEpoch, std::chrono::milliseconds timeout) {
+    const ParkingWord::Deadline deadline = std::chrono::steady_clock::now() + timeout;
+    return epoch.waitUntil([seenEpoch](uint32_t value) { return value != seenEpoch; }, &deadline);
+}
+
+uint32_t EpochEvent::getParkCount() const {
+    return epoch.getParkCount();
 }
 
 ThreadBarrier::ThreadBarrier(int count) 
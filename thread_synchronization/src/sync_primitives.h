@@ -1,30 +1,125 @@
 #ifndef SYNC_PRIMITIVES_H
 #define SYNC_PRIMITIVES_H
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <vector>
-#include <atomic>
 
+enum class ParkingScope {
+    Private,    // waiters are threads of this process
+    Shared      // the word lives in memory shared with other processes
+};
+
+// A 32-bit atomic word that threads can wait on. Waiters spin for an adaptive,
+// bounded number of iterations and then park on the word itself (futex on
+// Linux, a hashed mutex/condition variable elsewhere). Writers wake waiters
+// explicitly, and only enter the kernel when somebody is actually parked.
+class ParkingWord {
+public:
+    using Deadline = std::chrono::steady_clock::time_point;
+
+    explicit ParkingWord(uint32_t initial, ParkingScope scope = ParkingScope::Private);
+
+    uint32_t load(std::memory_order order = std::memory_order_acquire) const;
+    // Mutations only publish the new value; call wakeAll() after the ones a
+    // waiter can be waiting for, so other changes cost no wakeups.
+    void store(uint32_t value);
+    uint32_t fetchAdd(uint32_t delta);
+    bool compareExchange(uint32_t& expected, uint32_t desired);
+    void wakeAll();
+    // Wakes at most one parked waiter, for words where any one of them can
+    // take what the change published. Without futexes it wakes them all.
+    void wakeOne();
+    // How many times waiters have parked on the word. Each wake that did not
+    // make the predicate true shows up as one more park.
+    uint32_t getParkCount() const;
+
+    // Blocks until ready(value) holds; returns false if the deadline (when
+    // given) passes first.
+    template <typename Predicate>
+    bool waitUntil(Predicate ready, const Deadline* deadline = nullptr);
+
+private:
+    static constexpr uint32_t kMinSpin = 16;
+    static constexpr uint32_t kMaxSpin = 4096;
+    // Without futexes, wakes from another process cannot reach this one's
+    // parking buckets, so shared words are re-checked this often.
+    static constexpr std::chrono::milliseconds kSharedPollInterval{1};
+
+    // Sleeps while the word still holds expected; may return spuriously.
+    void park(uint32_t expected, const Deadline* deadline);
+    static void cpuRelax();
+
+    std::atomic<uint32_t> word;
+    std::atomic<uint32_t> waiters;
+    std::atomic<uint32_t> spinLimit;
+    std::atomic<uint32_t> parkCount;
+    const ParkingScope scope;
+};
+
+template <typename Predicate>
+bool ParkingWord::waitUntil(Predicate ready, const Deadline* deadline) {
+    uint32_t value = word.load(std::memory_order_acquire);
+    if (ready(value)) {
+        return true;
+    }
+    
+    // Spin first: most handshakes complete within microseconds. The limit
+    // grows when spinning pays off and shrinks when we end up parking anyway.
+    const uint32_t limit = spinLimit.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < limit; ++i) {
+        cpuRelax();
+        value = word.load(std::memory_order_acquire);
+        if (ready(value)) {
+            spinLimit.store(limit < kMaxSpin ? limit * 2 : kMaxSpin, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    spinLimit.store(limit > kMinSpin ? limit / 2 : kMinSpin, std::memory_order_relaxed);
+    
+    while (true) {
+        if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+            return false;
+        }
+        
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        value = word.load(std::memory_order_seq_cst);
+        if (!ready(value)) {
+            parkCount.fetch_add(1, std::memory_order_relaxed);
+            park(value, deadline);
+            value = word.load(std::memory_order_acquire);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        
+        if (ready(value)) {
+            return true;
+        }
+    }
+}
+
+// Event, CountdownEvent and EpochEvent only work across processes when
+// built with ParkingScope::Shared inside a shared mapping.
 class Event {
 public:
-    Event();
+    explicit Event(ParkingScope scope = ParkingScope::Private);
     
     void signal();
     void reset();
     void wait();
     bool waitFor(std::chrono::milliseconds timeout);
     bool isSignaled() const;
+    uint32_t getParkCount() const;
 
 private:
-    std::mutex eventMutex;
-    std::condition_variable eventCV;
-    bool signaled;
+    ParkingWord state;
 };
 
 class CountdownEvent {
 public:
-    explicit CountdownEvent(int initialCount);
+    explicit CountdownEvent(int initialCount, ParkingScope scope = ParkingScope::Private);
     
     void addCount(int count = 1);
     void signal();
@@ -32,11 +127,26 @@ public:
     bool waitFor(std::chrono::milliseconds timeout);
     bool isSet() const;
     void reset(int count);
+    uint32_t getParkCount() const;
+
+private:
+    ParkingWord remainingCount;
+};
+
+// Broadcast generation counter: advance() releases every thread waiting for
+// the epoch to move past the value it observed, with a single wake.
+class EpochEvent {
+public:
+    explicit EpochEvent(ParkingScope scope = ParkingScope::Private);
+    
+    uint32_t current() const;
+    uint32_t advance();
+    void waitForChange(uint32_t seenEpoch);
+    bool waitForChangeFor(uint32_t seenEpoch, std::chrono::milliseconds timeout);
+    uint32_t getParkCount() const;
 
 private:
-    mutable std::mutex countMutex;
-    std::condition_variable countCV;
-    int remainingCount;
+    ParkingWord epoch;
 };
 
 class ThreadBarrier {
@@ -1,136 +1,360 @@
-#include "marker_thread.h"
-#include <chrono>
-#include <iostream>
+#include "thread_manager.h"
+#include "logger.h"
+#include <algorithm>
 #include <stdexcept>
+#include <string>
 
-using namespace std::chrono_literals;
-
-MarkerThread::MarkerThread(int id, std::shared_ptr<ArrayManager> arrayManager)
-    : id(id), 
-      arrayManager(arrayManager),
-      running(false),
-      command(MarkerCommand::Continue),
-      blocked(false),
-      markedCount(0),
-      blockedIndex(0) {
+ThreadManager::ThreadManager(std::shared_ptr<ArrayManager> arrayManager)
+    : arrayManager(arrayManager),
+      round(std::make_shared<RoundControl>()),
+      topology(systemTopology()) {
     
     if (!arrayManager) {
         throw std::invalid_argument("Array manager cannot be null");
     }
 }
 
-MarkerThread::~MarkerThread() {
-    if (running.load()) {
-        try {
-            sendCommand(MarkerCommand::Terminate);
-            join();
-        } catch (const std::exception& e) {
-            std::cerr << "Error during marker thread shutdown: " << e.what() << std::endl;
+ThreadManager::~ThreadManager() {
+    stopSweeper();
+    try {
+        for (const auto& thread : threads) {
+            thread->setPendingCommand(MarkerCommand::Terminate);
+        }
+        round->start();
+        round->release();
+        
+        for (const auto& thread : threads) {
+            thread->join();
+        }
+        joinRetiredThreads();
+    } catch (const std::exception& e) {
+        defaultLogger().log(LogLevel::Error, "Error during thread manager shutdown: ", e.what());
+    }
+}
+
+void ThreadManager::setPacing(const PacingPolicy& policy) {
+    pacing = policy;
+    for (const auto& thread : threads) {
+        if (!thread->isRunning()) {
+            thread->setPacing(policy);
+        }
+    }
+}
+
+void ThreadManager::setAccessPolicy(const AccessPolicy& policy) {
+    access = policy;
+    for (const auto& thread : threads) {
+        if (!thread->isRunning()) {
+            thread->setAccessPolicy(policy);
+        }
+    }
+}
+
+void ThreadManager::setMarkBatch(size_t size) {
+    if (size == 0) {
+        throw std::invalid_argument("Mark batch must be positive");
+    }
+    markBatch = size;
+    for (const auto& thread : threads) {
+        if (!thread->isRunning()) {
+            thread->setMarkBatch(size);
+        }
+    }
+}
+
+void ThreadManager::setClaimMode(ClaimMode mode) {
+    // Drawn claims never read the bitmap, so only nearest ones pay for it.
+    if (mode == ClaimMode::Nearest) {
+        arrayManager->trackOccupancy();
+    }
+    claimMode = mode;
+    for (const auto& thread : threads) {
+        if (!thread->isRunning()) {
+            thread->setClaimMode(mode);
         }
     }
 }
 
-void MarkerThread::start() {
-    if (running.load()) {
-        throw std::logic_error("Thread already running");
+void ThreadManager::setReleaseMode(ReleaseMode mode) {
+    releaseMode = mode;
+    if (mode == ReleaseMode::Lazy && !sweeper.joinable()) {
+        sweeper = std::thread(&ThreadManager::runSweeper, this);
+    }
+}
+
+void ThreadManager::setAffinity(const AffinityPolicy& policy, const CpuTopology& cpuTopology) {
+    for (int cpu : policy.cpus) {
+        if (!cpuTopology.hasCpu(cpu)) {
+            throw std::invalid_argument("CPU " + std::to_string(cpu) + " is not available");
+        }
     }
     
-    running.store(true);
-    thread = std::thread(&MarkerThread::threadFunction, this);
+    affinity = policy;
+    topology = cpuTopology;
+    for (const auto& thread : threads) {
+        if (!thread->isRunning()) {
+            thread->setCpu(affinityCpu(affinity, topology, static_cast<size_t>(thread->getId() - 1)));
+        }
+    }
 }
 
-void MarkerThread::signalStart() {
-    startEvent.signal();
+void ThreadManager::useWorkerPool(size_t workerCount) {
+    pool = std::make_shared<WorkStealingPool>(workerCount, affinity, topology);
 }
 
-void MarkerThread::waitForBlocking() {
-    blockedEvent.wait();
+std::shared_ptr<WorkStealingPool> ThreadManager::getWorkerPool() const {
+    return pool;
 }
 
-void MarkerThread::sendCommand(MarkerCommand cmd) {
-    command.store(cmd);
-    commandEvent.signal();
+void ThreadManager::setTraceRecorder(std::shared_ptr<TraceRecorder> recorder) {
+    traceRecorder = recorder;
+    traceRing = recorder ? recorder->createRing() : nullptr;
 }
 
-void MarkerThread::join() {
-    if (thread.joinable()) {
-        thread.join();
+void ThreadManager::createThreads(int count) {
+    if (count <= 0) {
+        throw std::invalid_argument("Thread count must be positive");
+    }
+    
+    const int firstId = nextId;
+    if (count > arrayManager->getMaxMarkerValue() - firstId + 1) {
+        throw std::invalid_argument("Marker ids would not fit the array's cells");
+    }
+    // A previous owner of the array may have retired these ids; they can
+    // mark again once their cells are drained.
+    arrayManager->sweepRetired();
+    threads.reserve(threads.size() + static_cast<size_t>(count));
+    for (int id = firstId; id < firstId + count; ++id) {
+        auto thread = std::make_shared<MarkerThread>(id, arrayManager, round);
+        thread->setPacing(pacing);
+        thread->setAccessPolicy(access);
+        thread->setMarkBatch(markBatch);
+        thread->setClaimMode(claimMode);
+        thread->setTraceRecorder(traceRecorder);
+        if (pool) {
+            thread->setPool(pool);
+        } else {
+            thread->setCpu(affinityCpu(affinity, topology, static_cast<size_t>(id - 1)));
+        }
+        threads.push_back(thread);
     }
+    nextId += count;
 }
 
-bool MarkerThread::isRunning() const {
-    return running.load();
+void ThreadManager::startAllThreads() {
+    round->blockedCountdown.reset(static_cast<int>(threads.size()));
+    
+    for (const auto& thread : threads) {
+        thread->start();
+    }
+    releasedAt = std::chrono::steady_clock::now();
+    round->start();
 }
 
-bool MarkerThread::isBlocked() const {
-    return blocked.load();
+void ThreadManager::waitForAllThreadsBlocked() {
+    round->blockedCountdown.wait();
+    dropFailedThreads();
 }
 
-int MarkerThread::getId() const {
-    return id;
+void ThreadManager::terminateThread(int id) {
+    auto it = std::find_if(threads.begin(), threads.end(),
+                           [id](const auto& thread) { return thread->getId() == id; });
+    if (it == threads.end()) {
+        throw std::invalid_argument("Thread " + std::to_string(id) + " is not active");
+    }
+    
+    // The marker is parked, so its cells are released here instead of waking
+    // it; it sees the Terminate command at the next release and exits.
+    (*it)->setPendingCommand(MarkerCommand::Terminate);
+    const uint64_t startedAt = statsNow();
+    const size_t released = releaseCells(id);
+    cleanupDuration.record(statsNow() - startedAt);
+    
+    if (traceRing) {
+        traceRing->record(TraceEventType::Terminate, static_cast<uint32_t>(id), 0);
+        traceRing->record(TraceEventType::Reset, static_cast<uint32_t>(id), released);
+    }
+    
+    retiredMarks += (*it)->getTotalMarks();
+    retiredThreads.push_back(*it);
+    threads.erase(it);
 }
 
-size_t MarkerThread::getMarkedCount() const {
-    return markedCount.load();
+void ThreadManager::continueOtherThreads() {
+    round->blockedCountdown.reset(static_cast<int>(threads.size()));
+    releasedAt = std::chrono::steady_clock::now();
+    round->release();
+    joinRetiredThreads();
 }
 
-size_t MarkerThread::getBlockedIndex() const {
-    return blockedIndex.load();
+void ThreadManager::setVictimPolicy(TerminationChoice choice, uint32_t seed) {
+    victimSelector = VictimSelector(choice, seed);
 }
 
-void MarkerThread::threadFunction() {
-    try {
-        startEvent.wait();
-        
-        srand(static_cast<unsigned int>(id));
-        
-        while (running.load()) {
-            size_t index = static_cast<size_t>(rand()) % arrayManager->getSize();
-            
-            try {
-                if (arrayManager->markElement(index, id)) {
-                    std::this_thread::sleep_for(5ms);
-                    markedCount.store(arrayManager->countMarkedElements(id));
-                    std::this_thread::sleep_for(5ms);
-                } else {
-                    std::cout << "Marker " << id 
-                              << " blocked. Marked elements: " << arrayManager->countMarkedElements(id) 
-                              << ", blocked at index: " << index << std::endl;
-                    
-                    markedCount.store(arrayManager->countMarkedElements(id));
-                    blockedIndex.store(index);
-                    blocked.store(true);
-                    blockedEvent.signal();
-                    
-                    commandEvent.wait();
-                    blocked.store(false);
-                    blockedEvent.reset();
-                    
-                    if (command.load() == MarkerCommand::Terminate) {
-                        resetMarkedElements();
-                        break;
-                    }
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "Error in marker thread " << id << ": " << e.what() << std::endl;
-                break;
-            }
+int ThreadManager::chooseVictim() {
+    if (threads.empty()) {
+        throw std::logic_error("No active markers to terminate");
+    }
+    
+    std::vector<VictimCandidate> candidates;
+    candidates.reserve(threads.size());
+    for (const auto& thread : threads) {
+        candidates.push_back({thread->getId(), thread->getMarkedCount(), thread->getBlockedAt()});
+    }
+    return victimSelector.choose(candidates);
+}
+
+RoundReport ThreadManager::runRound(const std::function<void(const RoundReport&)>& onBlocked) {
+    using Clock = std::chrono::steady_clock;
+    if (threads.empty()) {
+        throw std::logic_error("No active markers to run a round with");
+    }
+    
+    waitForAllThreadsBlocked();
+    const auto blockedAt = Clock::now();
+    
+    RoundReport report;
+    if (threads.empty()) {
+        return report;
+    }
+    report.round = ++roundsRun;
+    report.activeMarkers = threads.size();
+    report.victim = chooseVictim();
+    report.victimMarked = findThreadById(report.victim)->getMarkedCount();
+    report.blockWait = blockedAt - releasedAt;
+    if (onBlocked) {
+        onBlocked(report);
+    }
+    
+    const auto cleanupStart = Clock::now();
+    terminateThread(report.victim);
+    if (!threads.empty()) {
+        continueOtherThreads();
+    }
+    report.cleanup = Clock::now() - cleanupStart;
+    report.total = report.blockWait + report.cleanup;
+    return report;
+}
+
+std::vector<RoundReport> ThreadManager::runRounds(size_t maxRounds) {
+    std::vector<RoundReport> reports;
+    while (!threads.empty() && (maxRounds == 0 || reports.size() < maxRounds)) {
+        RoundReport report = runRound();
+        if (report.victim == 0) {
+            break;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Fatal error in marker thread " << id << ": " << e.what() << std::endl;
+        reports.push_back(report);
+    }
+    return reports;
+}
+
+bool ThreadManager::areAllThreadsFinished() const {
+    return threads.empty();
+}
+
+size_t ThreadManager::getActiveThreadCount() const {
+    return threads.size();
+}
+
+std::vector<int> ThreadManager::getActiveThreadIds() const {
+    std::vector<int> ids;
+    ids.reserve(threads.size());
+    for (const auto& thread : threads) {
+        ids.push_back(thread->getId());
     }
+    return ids;
+}
+
+std::shared_ptr<MarkerThread> ThreadManager::findThreadById(int id) {
+    for (const auto& thread : threads) {
+        if (thread->getId() == id) {
+            return thread;
+        }
+    }
+    return nullptr;
+}
+
+size_t ThreadManager::getTotalMarks() const {
+    size_t total = retiredMarks;
+    for (const auto& thread : threads) {
+        total += thread->getTotalMarks();
+    }
+    return total;
+}
+
+StatsSnapshot ThreadManager::snapshotStats() const {
+    StatsSnapshot snapshot;
+    snapshot.markers = retiredStats;
+    for (const auto& thread : retiredThreads) {
+        snapshot.markers.push_back(thread->snapshotStats());
+    }
+    for (const auto& thread : threads) {
+        snapshot.markers.push_back(thread->snapshotStats());
+    }
+    std::sort(snapshot.markers.begin(), snapshot.markers.end(),
+              [](const auto& a, const auto& b) { return a.markerId < b.markerId; });
     
-    running.store(false);
+    for (const auto& marker : snapshot.markers) {
+        snapshot.total.merge(marker);
+    }
+    cleanupDuration.snapshotInto(snapshot.total.cleanupDuration);
+    return snapshot;
 }
 
-void MarkerThread::resetMarkedElements() {
+void ThreadManager::runSweeper() {
     try {
-        const size_t arraySize = arrayManager->getSize();
-        
-        for (size_t i = 0; i < arraySize; ++i) {
-            arrayManager->resetElement(i, id);
+        while (true) {
+            // Read before sweeping, so a retirement made meanwhile is not
+            // slept through.
+            const uint32_t seen = sweepRequests.current();
+            arrayManager->sweepRetired();
+            if (sweeperStopping.load()) {
+                return;
+            }
+            sweepRequests.waitForChange(seen);
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error while resetting marked elements: " << e.what() << std::endl;
+        defaultLogger().log(LogLevel::Error, "Error in retired cell sweeper: ", e.what());
+    }
+}
+
+void ThreadManager::stopSweeper() {
+    if (sweeper.joinable()) {
+        sweeperStopping.store(true);
+        sweepRequests.advance();
+        sweeper.join();
     }
-}
\ No newline at end of file
+}
+
+void ThreadManager::dropFailedThreads() {
+    for (auto it = threads.begin(); it != threads.end();) {
+        if (!(*it)->hasFailed()) {
+            ++it;
+            continue;
+        }
+        
+        const size_t released = releaseCells((*it)->getId());
+        defaultLogger().log(LogLevel::Warning, "Marker ", (*it)->getId(), " failed; released ",
+                            released, " elements");
+        retiredMarks += (*it)->getTotalMarks();
+        retiredThreads.push_back(*it);
+        it = threads.erase(it);
+    }
+}
+
+size_t ThreadManager::releaseCells(int id) {
+    if (releaseMode == ReleaseMode::Eager) {
+        return arrayManager->resetMarkedElements(id);
+    }
+    const size_t retiredCount = arrayManager->retireMarkedElements(id);
+    sweepRequests.advance();
+    return retiredCount;
+}
+
+void ThreadManager::joinRetiredThreads() {
+    for (const auto& thread : retiredThreads) {
+        thread->join();
+        retiredStats.push_back(thread->snapshotStats());
+    }
+    retiredThreads.clear();
+}
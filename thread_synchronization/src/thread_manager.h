@@ -4,9 +4,31 @@
 #include "array_manager.h"
 #include "marker_thread.h"
 #include "sync_primitives.h"
+#include "victim_policy.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <thread>
 #include <vector>
 
+// What one unattended round did and how long it took.
+struct RoundReport {
+    size_t round = 0;
+    int victim = 0;
+    size_t victimMarked = 0;
+    // Active markers when the round blocked, the victim included.
+    size_t activeMarkers = 0;
+    // From the previous release (or the start) until every marker blocked.
+    std::chrono::nanoseconds blockWait{0};
+    // Terminating the victim and releasing the others.
+    std::chrono::nanoseconds cleanup{0};
+    // blockWait plus cleanup; time spent in the onBlocked callback is left
+    // out.
+    std::chrono::nanoseconds total{0};
+    // victim stays 0 when every marker left failed, with no one to terminate.
+};
+
 class ThreadManager {
 public:
     explicit ThreadManager(std::shared_ptr<ArrayManager> arrayManager);
@@ -17,21 +39,101 @@ public:
     ThreadManager(ThreadManager&&) = delete;
     ThreadManager& operator=(ThreadManager&&) = delete;
     
+    // Both apply to markers created afterwards and to created but not yet
+    // started ones.
+    void setPacing(const PacingPolicy& policy);
+    void setAccessPolicy(const AccessPolicy& policy);
+    // See MarkerThread::setMarkBatch(); applies like setPacing().
+    void setMarkBatch(size_t size);
+    void setClaimMode(ClaimMode mode);
+    // Lazy makes terminateThread() retire the victim's cells instead of
+    // resetting them, so continuing no longer waits on the victim's share of
+    // the array. A background thread, started here, resets them meanwhile.
+    void setReleaseMode(ReleaseMode mode);
+    // Markers created afterwards record into it; terminations are recorded
+    // on a ring owned by the manager's thread.
+    void setTraceRecorder(std::shared_ptr<TraceRecorder> recorder);
+    // Places markers created afterwards and created but not yet started
+    // ones by their id. Throws std::invalid_argument if an explicit CPU is
+    // not in the topology.
+    void setAffinity(const AffinityPolicy& policy, const CpuTopology& topology = systemTopology());
+    // Markers created afterwards run as tasks on a shared work-stealing pool
+    // of workerCount threads (0 = one per CPU) instead of a thread each. The
+    // workers, not the markers, are pinned with the current affinity.
+    void useWorkerPool(size_t workerCount = 0);
+    // Null unless useWorkerPool() was called.
+    std::shared_ptr<WorkStealingPool> getWorkerPool() const;
     void createThreads(int count);
     void startAllThreads();
+    // Also drops markers that failed instead of blocking, releasing their
+    // cells, so later rounds do not wait for them.
     void waitForAllThreadsBlocked();
     void terminateThread(int id);
     void continueOtherThreads();
+    // How runRound() picks its victim; restarts round-robin and random
+    // selection.
+    void setVictimPolicy(TerminationChoice choice, uint32_t seed = 1);
+    // The policy's pick among the active markers. Call while they are all
+    // blocked; throws std::logic_error if none are active.
+    int chooseVictim();
+    // One block/terminate/continue cycle without a human in the loop.
+    // onBlocked, if set, runs once every marker has blocked and the victim is
+    // chosen, before it is terminated.
+    RoundReport runRound(const std::function<void(const RoundReport&)>& onBlocked = nullptr);
+    // Runs rounds until every marker is terminated or maxRounds (0 = no
+    // limit) have run.
+    std::vector<RoundReport> runRounds(size_t maxRounds = 0);
     bool areAllThreadsFinished() const;
     size_t getActiveThreadCount() const;
     std::vector<int> getActiveThreadIds() const;
     std::shared_ptr<MarkerThread> findThreadById(int id);
+    size_t getTotalMarks() const;
+    // Merges every marker's counters, including terminated ones, without
+    // taking locks or pausing markers. Call from the managing thread.
+    StatsSnapshot snapshotStats() const;
 
 private:
+    void joinRetiredThreads();
+    void dropFailedThreads();
+    // Resets or, in lazy release mode, retires a marker's cells.
+    size_t releaseCells(int id);
+    void runSweeper();
+    void stopSweeper();
+    
     std::shared_ptr<ArrayManager> arrayManager;
+    // Every marker shares this round, so detecting "all blocked" is one
+    // countdown wait and continuing is one epoch broadcast.
+    std::shared_ptr<RoundControl> round;
+    // Declared before the markers so it outlives every task.
+    std::shared_ptr<WorkStealingPool> pool;
     std::vector<std::shared_ptr<MarkerThread>> threads;
-    CountdownEvent threadsBlockedEvent;
-    size_t activeThreadCount;
+    PacingPolicy pacing;
+    AccessPolicy access;
+    size_t markBatch = 1;
+    ClaimMode claimMode = ClaimMode::Drawn;
+    ReleaseMode releaseMode = ReleaseMode::Eager;
+    AffinityPolicy affinity;
+    CpuTopology topology;
+    std::shared_ptr<TraceRecorder> traceRecorder;
+    TraceRing* traceRing = nullptr;
+    // Ids are never reused, so a terminated marker's retired cells cannot
+    // block a new one.
+    int nextId = 1;
+    // Terminated markers stay parked until the next release lets them exit.
+    std::vector<std::shared_ptr<MarkerThread>> retiredThreads;
+    size_t retiredMarks = 0;
+    std::vector<MarkerStatsSnapshot> retiredStats;
+    // Cleanups done on this thread on behalf of terminated markers.
+    LatencyHistogram cleanupDuration;
+    VictimSelector victimSelector;
+    size_t roundsRun = 0;
+    // When the markers were last started or released.
+    std::chrono::steady_clock::time_point releasedAt;
+    // Lazy release only: each retirement advances the epoch, waking the
+    // sweeper.
+    EpochEvent sweepRequests;
+    std::atomic<bool> sweeperStopping{false};
+    std::thread sweeper;
 };
 
-#endif
\ No newline at end of file
+#endif
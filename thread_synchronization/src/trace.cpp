@@ -0,0 +1,195 @@
+#include "trace.h"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define TRACE_HAS_TSC 1
+#endif
+
+namespace {
+
+constexpr char kTraceMagic[8] = {'T', 'S', 'T', 'R', 'A', 'C', 'E', '\0'};
+constexpr uint32_t kTraceVersion = 1;
+
+double measureTicksPerNanosecond() {
+#ifdef TRACE_HAS_TSC
+    const auto wallStart = std::chrono::steady_clock::now();
+    const uint64_t tickStart = traceTimestamp();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const uint64_t tickEnd = traceTimestamp();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - wallStart);
+    return static_cast<double>(tickEnd - tickStart) / static_cast<double>(elapsed.count());
+#else
+    return 1.0;
+#endif
+}
+
+}
+
+uint64_t traceTimestamp() {
+#ifdef TRACE_HAS_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+TraceRing::TraceRing(size_t capacity)
+    : records(std::make_unique<TraceRecord[]>(capacity)),
+      mask(capacity - 1),
+      writeIndex(0),
+      cachedReadIndex(0),
+      readIndex(0),
+      dropped(0) {
+    
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        throw std::invalid_argument("Trace ring capacity must be a power of two");
+    }
+}
+
+size_t TraceRing::drainInto(std::vector<TraceRecord>& out) {
+    const uint64_t tail = readIndex.load(std::memory_order_relaxed);
+    const uint64_t head = writeIndex.load(std::memory_order_acquire);
+    
+    for (uint64_t i = tail; i != head; ++i) {
+        out.push_back(records[i & mask]);
+    }
+    readIndex.store(head, std::memory_order_release);
+    return static_cast<size_t>(head - tail);
+}
+
+uint64_t TraceRing::getDropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+TraceRecorder::TraceRecorder(const std::string& path, uint64_t arraySize, size_t ringCapacity)
+    : file(std::fopen(path.c_str(), "wb")),
+      ringCapacity(ringCapacity),
+      stopping(false),
+      written(0) {
+    
+    if (!file) {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+    
+    TraceFileHeader header{};
+    std::memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+    header.version = kTraceVersion;
+    header.recordSize = sizeof(TraceRecord);
+    header.arraySize = arraySize;
+    header.ticksPerNanosecond = measureTicksPerNanosecond();
+    std::fwrite(&header, sizeof(header), 1, file);
+    
+    drainThread = std::thread(&TraceRecorder::drainLoop, this);
+}
+
+TraceRecorder::~TraceRecorder() {
+    stop();
+}
+
+TraceRing* TraceRecorder::createRing() {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    rings.push_back(std::make_unique<TraceRing>(ringCapacity));
+    return rings.back().get();
+}
+
+void TraceRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    wakeCV.notify_all();
+    
+    if (drainThread.joinable()) {
+        drainThread.join();
+    }
+    
+    std::fclose(file);
+    file = nullptr;
+}
+
+uint64_t TraceRecorder::getDropped() const {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    uint64_t total = 0;
+    for (const auto& ring : rings) {
+        total += ring->getDropped();
+    }
+    return total;
+}
+
+uint64_t TraceRecorder::getWritten() const {
+    return written.load();
+}
+
+void TraceRecorder::drainLoop() {
+    std::vector<TraceRecord> buffer;
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCV.wait_for(lock, std::chrono::milliseconds(1), [this] { return stopping; });
+            if (stopping) {
+                break;
+            }
+        }
+        drainOnce(buffer);
+    }
+    
+    // Producers are gone by now; collect whatever is left.
+    drainOnce(buffer);
+}
+
+void TraceRecorder::drainOnce(std::vector<TraceRecord>& buffer) {
+    buffer.clear();
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const auto& ring : rings) {
+            ring->drainInto(buffer);
+        }
+    }
+    
+    if (!buffer.empty()) {
+        std::fwrite(buffer.data(), sizeof(TraceRecord), buffer.size(), file);
+        written.fetch_add(buffer.size());
+    }
+}
+
+TraceFile readTraceFile(const std::string& path) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+    if (!file) {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+    
+    TraceFile trace{};
+    if (std::fread(&trace.header, sizeof(trace.header), 1, file.get()) != 1 ||
+        std::memcmp(trace.header.magic, kTraceMagic, sizeof(kTraceMagic)) != 0 ||
+        trace.header.version != kTraceVersion ||
+        trace.header.recordSize != sizeof(TraceRecord)) {
+        throw std::runtime_error("Not a marker trace file: " + path);
+    }
+    
+    TraceRecord record;
+    while (std::fread(&record, sizeof(record), 1, file.get()) == 1) {
+        trace.records.push_back(record);
+    }
+    return trace;
+}
+
+const char* traceEventName(TraceEventType type) {
+    switch (type) {
+        case TraceEventType::Mark: return "mark";
+        case TraceEventType::Collision: return "collision";
+        case TraceEventType::Block: return "block";
+        case TraceEventType::Resume: return "resume";
+        case TraceEventType::Terminate: return "terminate";
+        case TraceEventType::Reset: return "reset";
+    }
+    return "unknown";
+}
@@ -0,0 +1,122 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class TraceEventType : uint32_t {
+    Mark,       // index = claimed element
+    Collision,  // index = element that was already marked
+    Block,      // index = element the marker blocked at
+    Resume,     // marker released after a block
+    Terminate,  // marker told to terminate
+    Reset       // index = number of elements released
+};
+
+struct TraceRecord {
+    uint64_t timestamp;
+    uint64_t index;
+    uint32_t markerId;
+    TraceEventType type;
+};
+static_assert(sizeof(TraceRecord) == 24, "Trace records are written to disk as-is");
+
+// File layout: one TraceFileHeader followed by TraceRecords in drain order
+// (sorted per producer, interleaved between producers). Host byte order.
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t arraySize;
+    double ticksPerNanosecond;
+};
+static_assert(sizeof(TraceFileHeader) == 32, "Trace header is written to disk as-is");
+
+// Cheap monotonic timestamp (TSC on x86, steady_clock ticks elsewhere).
+uint64_t traceTimestamp();
+
+// Single-producer/single-consumer ring owned by a TraceRecorder. The
+// producing thread never blocks: when the drain thread falls behind, new
+// records are dropped and counted.
+class TraceRing {
+public:
+    explicit TraceRing(size_t capacity);
+
+    void record(TraceEventType type, uint32_t markerId, uint64_t index) {
+        const uint64_t head = writeIndex.load(std::memory_order_relaxed);
+        if (head - cachedReadIndex > mask) {
+            cachedReadIndex = readIndex.load(std::memory_order_acquire);
+            if (head - cachedReadIndex > mask) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        records[head & mask] = TraceRecord{traceTimestamp(), index, markerId, type};
+        writeIndex.store(head + 1, std::memory_order_release);
+    }
+
+    // Consumer side: appends every available record to out.
+    size_t drainInto(std::vector<TraceRecord>& out);
+    uint64_t getDropped() const;
+
+private:
+    std::unique_ptr<TraceRecord[]> records;
+    const uint64_t mask;
+    alignas(64) std::atomic<uint64_t> writeIndex;
+    uint64_t cachedReadIndex;
+    alignas(64) std::atomic<uint64_t> readIndex;
+    std::atomic<uint64_t> dropped;
+};
+
+// Owns the rings and a background thread that drains them to a binary file.
+class TraceRecorder {
+public:
+    static constexpr size_t kDefaultRingCapacity = 1 << 16;
+
+    TraceRecorder(const std::string& path, uint64_t arraySize,
+                  size_t ringCapacity = kDefaultRingCapacity);
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // Each producing thread registers one ring; it stays valid until the
+    // recorder is destroyed.
+    TraceRing* createRing();
+    // Drains everything still buffered and closes the file. Idempotent.
+    void stop();
+    uint64_t getDropped() const;
+    uint64_t getWritten() const;
+
+private:
+    void drainLoop();
+    void drainOnce(std::vector<TraceRecord>& buffer);
+
+    std::FILE* file;
+    const size_t ringCapacity;
+    mutable std::mutex ringsMutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCV;
+    bool stopping;
+    std::atomic<uint64_t> written;
+    std::thread drainThread;
+};
+
+struct TraceFile {
+    TraceFileHeader header;
+    std::vector<TraceRecord> records;
+};
+
+// Throws std::runtime_error if the file is missing or malformed.
+TraceFile readTraceFile(const std::string& path);
+const char* traceEventName(TraceEventType type);
+
+#endif
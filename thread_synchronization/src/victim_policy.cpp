@@ -0,0 +1,68 @@
+#include "victim_policy.h"
+#include <algorithm>
+#include <stdexcept>
+
+TerminationChoice parseTerminationChoice(const std::string& text) {
+    if (text == "first") {
+        return TerminationChoice::First;
+    }
+    if (text == "last") {
+        return TerminationChoice::Last;
+    }
+    if (text == "most") {
+        return TerminationChoice::MostMarked;
+    }
+    if (text == "fewest") {
+        return TerminationChoice::FewestMarked;
+    }
+    if (text == "oldest") {
+        return TerminationChoice::Oldest;
+    }
+    if (text == "round-robin") {
+        return TerminationChoice::RoundRobin;
+    }
+    if (text == "random") {
+        return TerminationChoice::Random;
+    }
+    throw std::invalid_argument("Invalid value for terminate: " + text);
+}
+
+VictimSelector::VictimSelector(TerminationChoice choice, uint32_t seed)
+    : choice(choice),
+      rng(seed),
+      cursor(0) {}
+
+TerminationChoice VictimSelector::getChoice() const {
+    return choice;
+}
+
+int VictimSelector::choose(const std::vector<VictimCandidate>& candidates) {
+    if (candidates.empty()) {
+        throw std::invalid_argument("No markers to choose a victim from");
+    }
+    
+    // max_element and min_element keep the first of equal elements, so ties
+    // go to the earliest-created marker.
+    switch (choice) {
+        case TerminationChoice::First:
+            return candidates.front().id;
+        case TerminationChoice::Last:
+            return candidates.back().id;
+        case TerminationChoice::MostMarked:
+            return std::max_element(candidates.begin(), candidates.end(),
+                                    [](const auto& a, const auto& b) { return a.markedCount < b.markedCount; })->id;
+        case TerminationChoice::FewestMarked:
+            return std::min_element(candidates.begin(), candidates.end(),
+                                    [](const auto& a, const auto& b) { return a.markedCount < b.markedCount; })->id;
+        case TerminationChoice::Oldest:
+            return std::min_element(candidates.begin(), candidates.end(),
+                                    [](const auto& a, const auto& b) { return a.blockedAt < b.blockedAt; })->id;
+        case TerminationChoice::RoundRobin:
+            // One position further each round through the shrinking list,
+            // so victims are spread around it rather than taken from one end.
+            return candidates[cursor++ % candidates.size()].id;
+        case TerminationChoice::Random:
+            return candidates[std::uniform_int_distribution<size_t>(0, candidates.size() - 1)(rng)].id;
+    }
+    return candidates.front().id;
+}
@@ -0,0 +1,50 @@
+#ifndef VICTIM_POLICY_H
+#define VICTIM_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Which blocked marker a headless round terminates.
+enum class TerminationChoice {
+    First,          // lowest active id
+    Last,           // highest active id
+    MostMarked,     // holds the most cells; ties go to the lower id
+    FewestMarked,   // holds the fewest cells; ties go to the lower id
+    Oldest,         // has been blocked the longest
+    RoundRobin,     // steps one position through the active list per round
+    Random          // uniformly, from the run's seed
+};
+
+// "first", "last", "most", "fewest", "oldest", "round-robin" or "random".
+TerminationChoice parseTerminationChoice(const std::string& text);
+
+// What a policy may look at for one blocked marker.
+struct VictimCandidate {
+    int id;
+    size_t markedCount;
+    // When the marker blocked, in statsNow() nanoseconds; 0 if unknown,
+    // which counts as blocked longest.
+    uint64_t blockedAt;
+};
+
+// Applies a TerminationChoice round after round. Round-robin and random keep
+// state between rounds, so one selector serves a whole run.
+class VictimSelector {
+public:
+    explicit VictimSelector(TerminationChoice choice = TerminationChoice::First, uint32_t seed = 1);
+    
+    TerminationChoice getChoice() const;
+    // Candidates in creation order, as the managers list them. Throws
+    // std::invalid_argument if there are none.
+    int choose(const std::vector<VictimCandidate>& candidates);
+
+private:
+    TerminationChoice choice;
+    std::mt19937 rng;
+    size_t cursor;
+};
+
+#endif
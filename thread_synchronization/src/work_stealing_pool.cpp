@@ -0,0 +1,199 @@
+#include "work_stealing_pool.h"
+#include "logger.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// The worker the current thread is, if it belongs to a pool.
+thread_local const void* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+
+constexpr int64_t kNoDeadline = std::numeric_limits<int64_t>::max();
+
+}
+
+WorkStealingPool::WorkStealingPool(size_t workerCount, const AffinityPolicy& affinity,
+                                   const CpuTopology& topology)
+    : nextWorker(0),
+      stopping(false),
+      steals(0),
+      workAvailable(0),
+      idleWorkers(0),
+      nextDeadline(kNoDeadline) {
+    
+    if (workerCount == 0) {
+        workerCount = topology.getCpus().size();
+    }
+    
+    workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // Workers only start once every queue exists, since they steal from all.
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers[i]->thread = std::thread(&WorkStealingPool::workerLoop, this, i,
+                                         affinityCpu(affinity, topology, i));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    stopping.store(true);
+    // Every worker has to see stopping, so this is the one broadcast.
+    workAvailable.fetchAdd(1);
+    workAvailable.wakeAll();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+void WorkStealingPool::submit(PoolTask* task) {
+    if (currentPool == this) {
+        push(currentWorker, task);
+    } else {
+        push(nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size(), task);
+    }
+    wakeIdle(1);
+}
+
+void WorkStealingPool::submitAfter(PoolTask* task, std::chrono::microseconds delay) {
+    const auto deadline = std::chrono::steady_clock::now() + delay;
+    bool earliest = false;
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        timers.push({deadline, timerSequence++, task});
+        const int64_t ticks = deadline.time_since_epoch().count();
+        if (ticks < nextDeadline.load(std::memory_order_relaxed)) {
+            nextDeadline.store(ticks, std::memory_order_release);
+            earliest = true;
+        }
+    }
+    // Idle workers only need to recompute how long to sleep when the
+    // earliest deadline moves up.
+    if (earliest) {
+        wakeIdle(1);
+    }
+}
+
+size_t WorkStealingPool::getWorkerCount() const {
+    return workers.size();
+}
+
+uint64_t WorkStealingPool::getSteals() const {
+    return steals.load(std::memory_order_relaxed);
+}
+
+void WorkStealingPool::workerLoop(size_t index, int cpu) {
+    currentPool = this;
+    currentWorker = index;
+    if (cpu >= 0 && !pinCurrentThread({cpu})) {
+        defaultLogger().log(LogLevel::Warning, "Pool worker ", index, " could not be pinned to CPU ", cpu);
+    }
+    
+    while (!stopping.load(std::memory_order_acquire)) {
+        fireTimers(index);
+        if (PoolTask* task = takeTask(index)) {
+            task->run();
+            continue;
+        }
+        
+        // Out of work: count as idle so submitters wake us, then search once
+        // more. seen is read before that search so work submitted during it
+        // is not slept through.
+        idleWorkers.fetch_add(1);
+        const uint32_t seen = workAvailable.load();
+        const auto deadline = fireTimers(index);
+        PoolTask* task = takeTask(index);
+        if (!task) {
+            const auto idleDeadline = std::min(deadline, std::chrono::steady_clock::now() + kIdleWait);
+            workAvailable.waitUntil([seen](uint32_t value) { return value != seen; }, &idleDeadline);
+        }
+        idleWorkers.fetch_sub(1);
+        if (task) {
+            task->run();
+        }
+    }
+}
+
+PoolTask* WorkStealingPool::takeTask(size_t index) {
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.queueMutex);
+        if (!own.queue.empty()) {
+            PoolTask* task = own.queue.front();
+            own.queue.pop_front();
+            return task;
+        }
+    }
+    
+    for (size_t offset = 1; offset < workers.size(); ++offset) {
+        Worker& victim = *workers[(index + offset) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.queueMutex);
+        if (!victim.queue.empty()) {
+            PoolTask* task = victim.queue.back();
+            victim.queue.pop_back();
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+std::chrono::steady_clock::time_point WorkStealingPool::fireTimers(size_t index) {
+    using Clock = std::chrono::steady_clock;
+    const auto now = Clock::now() + kTimerSlack;
+    const int64_t pending = nextDeadline.load(std::memory_order_acquire);
+    if (pending > now.time_since_epoch().count()) {
+        return pending == kNoDeadline ? Clock::time_point::max() : Clock::time_point(Clock::duration(pending));
+    }
+    
+    std::vector<PoolTask*> due;
+    Clock::time_point next = Clock::time_point::max();
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        while (!timers.empty() && timers.top().deadline <= now) {
+            due.push_back(timers.top().task);
+            timers.pop();
+        }
+        if (!timers.empty()) {
+            next = timers.top().deadline;
+        }
+        nextDeadline.store(timers.empty() ? kNoDeadline : next.time_since_epoch().count(),
+                           std::memory_order_release);
+    }
+    
+    if (!due.empty()) {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.queueMutex);
+        own.queue.insert(own.queue.end(), due.begin(), due.end());
+    }
+    // Other workers may steal what just became runnable.
+    if (due.size() > 1) {
+        wakeIdle(due.size() - 1);
+    }
+    return next;
+}
+
+void WorkStealingPool::push(size_t index, PoolTask* task) {
+    if (!task) {
+        throw std::invalid_argument("Pool task cannot be null");
+    }
+    
+    Worker& worker = *workers[index];
+    std::lock_guard<std::mutex> lock(worker.queueMutex);
+    worker.queue.push_back(task);
+}
+
+void WorkStealingPool::wakeIdle(size_t count) {
+    // Pairs with the increment in workerLoop: a worker that this load misses
+    // searches the queues only after the caller's push.
+    const size_t idle = idleWorkers.load();
+    if (idle == 0) {
+        return;
+    }
+    workAvailable.fetchAdd(1);
+    for (size_t woken = 0; woken < std::min(count, idle); ++woken) {
+        workAvailable.wakeOne();
+    }
+}
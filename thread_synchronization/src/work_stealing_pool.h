@@ -0,0 +1,101 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include "lock_policies.h"
+#include "placement.h"
+#include "sync_primitives.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A unit of work the pool runs to completion. Tasks that want to run again
+// resubmit themselves; the pool never owns or deletes them.
+class PoolTask {
+public:
+    virtual ~PoolTask() = default;
+    virtual void run() = 0;
+};
+
+// A fixed set of worker threads, each with its own run queue. Workers take
+// their own tasks oldest first, so tasks that keep yielding share a worker
+// fairly, and steal the newest task of another worker when they run dry.
+// Delayed tasks wait in a timer queue rather than on a worker.
+class WorkStealingPool {
+public:
+    // workerCount 0 starts one worker per CPU of the topology. Worker i is
+    // pinned to affinityCpu(affinity, topology, i).
+    explicit WorkStealingPool(size_t workerCount = 0,
+                              const AffinityPolicy& affinity = AffinityPolicy::none(),
+                              const CpuTopology& topology = systemTopology());
+    // Stops the workers; tasks still queued are dropped without running.
+    ~WorkStealingPool();
+    
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    
+    // From a worker the task joins that worker's queue, otherwise the queue
+    // of the next worker in turn.
+    void submit(PoolTask* task);
+    void submitAfter(PoolTask* task, std::chrono::microseconds delay);
+    size_t getWorkerCount() const;
+    // Tasks taken from another worker's queue so far.
+    uint64_t getSteals() const;
+
+private:
+    struct alignas(kCacheLineSize) Worker {
+        std::mutex queueMutex;
+        std::deque<PoolTask*> queue;
+        std::thread thread;
+    };
+    
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t sequence;
+        PoolTask* task;
+        
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+    
+    static constexpr std::chrono::milliseconds kIdleWait{10};
+    // Timers due within this much of each other fire together; without it a
+    // worker wakes once per timer when thousands of tasks sleep at once.
+    static constexpr std::chrono::microseconds kTimerSlack{200};
+    
+    void workerLoop(size_t index, int cpu);
+    PoolTask* takeTask(size_t index);
+    // Moves due timers onto the given worker's queue; returns the next
+    // deadline still pending.
+    std::chrono::steady_clock::time_point fireTimers(size_t index);
+    void push(size_t index, PoolTask* task);
+    // Wakes up to count idle workers; does nothing while none is idle.
+    void wakeIdle(size_t count);
+    
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> nextWorker;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> steals;
+    // Bumped whenever work appears while a worker is idle, so idle workers
+    // can park on it.
+    ParkingWord workAvailable;
+    // Workers between giving up on their queues and waking up again. A
+    // worker counts itself before it searches, so a submitter that sees 0
+    // pushed before every search that could miss its task.
+    std::atomic<size_t> idleWorkers;
+    
+    std::mutex timerMutex;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t timerSequence = 0;
+    // Earliest timer deadline in steady_clock ticks, or max when none are
+    // pending; lets workers skip the timer lock.
+    std::atomic<int64_t> nextDeadline;
+};
+
+#endif
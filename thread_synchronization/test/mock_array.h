@@ -4,16 +4,52 @@
 #include <gmock/gmock.h>
 #include "array_manager.h"
 
+// Mocks the ArrayManager interface on top of a real backend: unless a test
+// sets its own expectations, every call is forwarded to the selected backend.
 class MockArrayManager : public ArrayManager {
 public:
-    explicit MockArrayManager(size_t size) : ArrayManager(size) {}
+    explicit MockArrayManager(size_t size,
+                              ArrayBackend backend = ArrayBackend::GlobalLock,
+                              size_t stripeCount = 0)
+        : ArrayManager(size, backend, stripeCount) {
+        ON_CALL(*this, markElement).WillByDefault([this](size_t index, int markerValue) {
+            return ArrayManager::markElement(index, markerValue);
+        });
+        ON_CALL(*this, resetElement).WillByDefault([this](size_t index, int markerValue) {
+            return ArrayManager::resetElement(index, markerValue);
+        });
+        ON_CALL(*this, countMarkedElements).WillByDefault([this](int markerValue) {
+            return ArrayManager::countMarkedElements(markerValue);
+        });
+        ON_CALL(*this, resetMarkedElements).WillByDefault([this](int markerValue) {
+            return ArrayManager::resetMarkedElements(markerValue);
+        });
+        ON_CALL(*this, recountMarkedElements).WillByDefault([this](int markerValue) {
+            return ArrayManager::recountMarkedElements(markerValue);
+        });
+        ON_CALL(*this, markerHistogram).WillByDefault([this](size_t binCount) {
+            return ArrayManager::markerHistogram(binCount);
+        });
+        ON_CALL(*this, printArray).WillByDefault([this] {
+            ArrayManager::printArray();
+        });
+        ON_CALL(*this, getSize).WillByDefault([this] {
+            return ArrayManager::getSize();
+        });
+        ON_CALL(*this, getElementAt).WillByDefault([this](size_t index) {
+            return ArrayManager::getElementAt(index);
+        });
+    }
     
     MOCK_METHOD(bool, markElement, (size_t index, int markerValue), (override));
     MOCK_METHOD(bool, resetElement, (size_t index, int markerValue), (override));
     MOCK_METHOD(size_t, countMarkedElements, (int markerValue), (const, override));
+    MOCK_METHOD(size_t, resetMarkedElements, (int markerValue), (override));
+    MOCK_METHOD(size_t, recountMarkedElements, (int markerValue), (const, override));
+    MOCK_METHOD(std::vector<size_t>, markerHistogram, (size_t binCount), (const, override));
     MOCK_METHOD(void, printArray, (), (const, override));
     MOCK_METHOD(size_t, getSize, (), (const, override));
     MOCK_METHOD(int, getElementAt, (size_t index), (const, override));
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,70 +1,817 @@
 #include <gtest/gtest.h>
+#include <gmock/gmock.h>
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <map>
 
 #include "array_manager.h"
+#include "array_dump.h"
 #include "marker_thread.h"
 #include "thread_manager.h"
 #include "sync_primitives.h"
+#include "scan_kernels.h"
+#include "mock_array.h"
+#include "driver_options.h"
+#include "pacing.h"
+#include "placement.h"
+#include "index_generator.h"
+#include "marker_stats.h"
+#include "logger.h"
+#include <sstream>
+#include "trace.h"
+#include "work_stealing_pool.h"
+#include "victim_policy.h"
+#include "occupancy_bitmap.h"
+#ifdef THREAD_SYNC_PROCESSES
+#include "process_manager.h"
+#include <csignal>
+#endif
+#ifdef THREAD_SYNC_COROUTINES
+#include "coro_marker.h"
+#include "coro_sync.h"
+#endif
 
 using namespace std::chrono_literals;
 
-class ArrayManagerTest : public ::testing::Test {
+class ArrayManagerTest : public ::testing::TestWithParam<ArrayBackend> {
 protected:
     void SetUp() override {
-        arrayManager = std::make_shared<ArrayManager>(10);
+        arrayManager = std::make_shared<ArrayManager>(10, GetParam());
     }
     
     std::shared_ptr<ArrayManager> arrayManager;
 };
 
-TEST_F(ArrayManagerTest, InitialArrayIsEmpty) {
+TEST_P(ArrayManagerTest, InitialArrayIsEmpty) {
     for (size_t i = 0; i < arrayManager->getSize(); ++i) {
         EXPECT_EQ(arrayManager->getElementAt(i), 0);
     }
 }
 
-TEST_F(ArrayManagerTest, MarkElementWorks) {
+TEST_P(ArrayManagerTest, MarkElementWorks) {
     EXPECT_TRUE(arrayManager->markElement(5, 1));
     EXPECT_EQ(arrayManager->getElementAt(5), 1);
 }
 
-TEST_F(ArrayManagerTest, MarkElementFailsWhenAlreadyMarked) {
+TEST_P(ArrayManagerTest, MarkElementFailsWhenAlreadyMarked) {
     EXPECT_TRUE(arrayManager->markElement(5, 1));
     EXPECT_FALSE(arrayManager->markElement(5, 2));
     EXPECT_EQ(arrayManager->getElementAt(5), 1);
 }
 
-TEST_F(ArrayManagerTest, ResetElementWorks) {
+TEST_P(ArrayManagerTest, ResetElementWorks) {
     EXPECT_TRUE(arrayManager->markElement(5, 1));
     EXPECT_TRUE(arrayManager->resetElement(5, 1));
     EXPECT_EQ(arrayManager->getElementAt(5), 0);
 }
 
-TEST_F(ArrayManagerTest, ResetElementFailsWithWrongMarker) {
+TEST_P(ArrayManagerTest, ResetElementFailsWithWrongMarker) {
     EXPECT_TRUE(arrayManager->markElement(5, 1));
     EXPECT_FALSE(arrayManager->resetElement(5, 2));
     EXPECT_EQ(arrayManager->getElementAt(5), 1);
 }
 
-TEST_F(ArrayManagerTest, CountMarkedElementsWorks) {
+TEST_P(ArrayManagerTest, CountMarkedElementsWorks) {
     EXPECT_TRUE(arrayManager->markElement(1, 1));
     EXPECT_TRUE(arrayManager->markElement(3, 1));
     EXPECT_TRUE(arrayManager->markElement(5, 1));
     EXPECT_TRUE(arrayManager->markElement(7, 2));
     
-    EXPECT_EQ(arrayManager->countMarkedElements(1), 3);
-    EXPECT_EQ(arrayManager->countMarkedElements(2), 1);
-    EXPECT_EQ(arrayManager->countMarkedElements(3), 0);
+    EXPECT_EQ(arrayManager->countMarkedElements(1), 3u);
+    EXPECT_EQ(arrayManager->countMarkedElements(2), 1u);
+    EXPECT_EQ(arrayManager->countMarkedElements(3), 0u);
 }
 
-TEST_F(ArrayManagerTest, OutOfBoundsAccess) {
+TEST_P(ArrayManagerTest, OutOfBoundsAccess) {
     EXPECT_THROW(arrayManager->markElement(20, 1), std::out_of_range);
     EXPECT_THROW(arrayManager->resetElement(20, 1), std::out_of_range);
     EXPECT_THROW(arrayManager->getElementAt(20), std::out_of_range);
 }
 
+TEST_P(ArrayManagerTest, CountTracksResets) {
+    EXPECT_TRUE(arrayManager->markElement(2, 1));
+    EXPECT_TRUE(arrayManager->markElement(4, 1));
+    EXPECT_TRUE(arrayManager->markElement(6, 1));
+    EXPECT_TRUE(arrayManager->resetElement(4, 1));
+    
+    EXPECT_EQ(arrayManager->countMarkedElements(1), 2u);
+    EXPECT_TRUE(arrayManager->markElement(4, 2));
+    EXPECT_EQ(arrayManager->countMarkedElements(2), 1u);
+}
+
+TEST_P(ArrayManagerTest, ResetMarkedElementsReleasesOnlyOwner) {
+    EXPECT_TRUE(arrayManager->markElement(0, 1));
+    EXPECT_TRUE(arrayManager->markElement(3, 2));
+    EXPECT_TRUE(arrayManager->markElement(9, 1));
+    
+    EXPECT_EQ(arrayManager->resetMarkedElements(1), 2u);
+    EXPECT_EQ(arrayManager->countMarkedElements(1), 0u);
+    EXPECT_EQ(arrayManager->getElementAt(0), 0);
+    EXPECT_EQ(arrayManager->getElementAt(9), 0);
+    EXPECT_EQ(arrayManager->getElementAt(3), 2);
+    EXPECT_EQ(arrayManager->resetMarkedElements(1), 0u);
+}
+
+TEST_P(ArrayManagerTest, FullScansMatchOwnershipIndex) {
+    EXPECT_TRUE(arrayManager->markElement(1, 1));
+    EXPECT_TRUE(arrayManager->markElement(2, 1));
+    EXPECT_TRUE(arrayManager->markElement(8, 3));
+    
+    EXPECT_EQ(arrayManager->recountMarkedElements(1), arrayManager->countMarkedElements(1));
+    EXPECT_EQ(arrayManager->recountMarkedElements(3), 1u);
+    
+    const auto histogram = arrayManager->markerHistogram(4);
+    EXPECT_EQ(histogram, (std::vector<size_t>{7, 2, 0, 1}));
+    
+    // Owning most of the array takes the bulk reset path.
+    EXPECT_EQ(arrayManager->resetMarkedElements(1), 2u);
+    EXPECT_EQ(arrayManager->recountMarkedElements(1), 0u);
+    EXPECT_EQ(arrayManager->getElementAt(8), 3);
+}
+
+TEST_P(ArrayManagerTest, InvalidMarkerValue) {
+    EXPECT_THROW(arrayManager->markElement(1, 0), std::invalid_argument);
+    EXPECT_THROW(arrayManager->markElement(1, -3), std::invalid_argument);
+    EXPECT_EQ(arrayManager->countMarkedElements(0), 0u);
+    
+    for (int markerValue : {0, -1}) {
+        EXPECT_THROW(arrayManager->resetElement(1, markerValue), std::invalid_argument);
+        EXPECT_THROW(arrayManager->markElements({1, 2}, markerValue), std::invalid_argument);
+        EXPECT_THROW(arrayManager->resetMarkedElements(markerValue), std::invalid_argument);
+        EXPECT_THROW(arrayManager->retireMarkedElements(markerValue), std::invalid_argument);
+        EXPECT_THROW(arrayManager->sweepMarkedElements(markerValue), std::invalid_argument);
+    }
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+
+TEST_P(ArrayManagerTest, ConcurrentMarkersClaimEachElementOnce) {
+    constexpr int markerCount = 4;
+    std::vector<std::thread> markers;
+    std::vector<size_t> claimed(markerCount + 1, 0);
+    
+    for (int id = 1; id <= markerCount; ++id) {
+        markers.emplace_back([this, id, &claimed] {
+            for (size_t i = 0; i < arrayManager->getSize(); ++i) {
+                if (arrayManager->markElement(i, id)) {
+                    ++claimed[id];
+                }
+            }
+        });
+    }
+    for (auto& marker : markers) {
+        marker.join();
+    }
+    
+    size_t total = 0;
+    for (int id = 1; id <= markerCount; ++id) {
+        EXPECT_EQ(arrayManager->countMarkedElements(id), claimed[id]);
+        total += claimed[id];
+    }
+    EXPECT_EQ(total, arrayManager->getSize());
+}
+
+TEST_P(ArrayManagerTest, SnapshotMatchesElements) {
+    arrayManager->markElement(2, 5);
+    arrayManager->markElement(7, 9);
+    
+    const ArraySnapshot copy = arrayManager->snapshot();
+    EXPECT_TRUE(copy.consistent);
+    ASSERT_EQ(copy.values.size(), arrayManager->getSize());
+    for (size_t i = 0; i < copy.values.size(); ++i) {
+        EXPECT_EQ(copy.values[i], arrayManager->getElementAt(i));
+    }
+}
+
+TEST_P(ArrayManagerTest, SnapshotsNeverSeePartialResets) {
+    ArrayManager manager(3 * SegmentedSeqLock::kSegmentSize + 17, GetParam());
+    std::atomic<bool> done{false};
+    
+    // Marks ascend and the bulk reset is atomic for readers, so any
+    // consistent copy must be a run of ones followed by zeros.
+    std::thread writer([&manager, &done] {
+        for (int pass = 0; pass < 20; ++pass) {
+            for (size_t i = 0; i < manager.getSize(); ++i) {
+                manager.markElement(i, 1);
+            }
+            manager.resetMarkedElements(1);
+        }
+        done.store(true);
+    });
+    
+    while (!done.load()) {
+        const ArraySnapshot copy = manager.snapshot();
+        if (!copy.consistent) {
+            continue;
+        }
+        const auto firstZero = std::find(copy.values.begin(), copy.values.end(), 0);
+        EXPECT_EQ(std::count(firstZero, copy.values.end(), 1), 0);
+    }
+    writer.join();
+    
+    EXPECT_TRUE(manager.snapshot().consistent);
+}
+
+TEST(SegmentedSeqLockTest, WritesDuringAReadForceARetry) {
+    SegmentedSeqLock lock(3 * SegmentedSeqLock::kSegmentSize);
+    std::atomic<int> cell{0};
+    int copies = 0;
+    
+    // Writers skip the sequence words only while nobody reads.
+    const SeqLockRead read = lock.read([&](size_t, size_t) {
+        if (copies++ == 0) {
+            lock.write(5, [&cell] {
+                cell.store(1);
+                return true;
+            });
+        }
+    }, 8);
+    EXPECT_EQ(read, SeqLockRead::Consistent);
+    EXPECT_EQ(copies, 2);
+}
+
+TEST(SegmentedSeqLockTest, ReadsGiveUpOnAStuckWriter) {
+    SegmentedSeqLock lock(3 * SegmentedSeqLock::kSegmentSize);
+    auto copy = [](size_t, size_t) {};
+    
+    lock.beginWrite(SegmentedSeqLock::kSegmentSize + 3);
+    EXPECT_EQ(lock.read(copy, 2), SeqLockRead::Failed);
+    lock.endWrite(SegmentedSeqLock::kSegmentSize + 3);
+    EXPECT_EQ(lock.read(copy, 2), SeqLockRead::Consistent);
+}
+
+TEST(ArraySnapshotTest, LockedFallbackIsConsistentOnlyWhenWritersStop) {
+    // The copy snapshot() takes once SegmentedSeqLock::read() has failed.
+    const std::vector<std::pair<ArrayBackend, bool>> cases = {
+        {ArrayBackend::GlobalLock, true},
+        {ArrayBackend::Striped, true},
+        {ArrayBackend::PerElement, false},
+        {ArrayBackend::LockFree, false},
+    };
+    for (const auto& [backend, consistent] : cases) {
+        ArrayManager manager(100, backend);
+        ASSERT_TRUE(manager.markElement(3, 2));
+        const ArraySnapshot copy = manager.lockedSnapshot();
+        EXPECT_EQ(copy.consistent, consistent);
+        EXPECT_EQ(copy.values[3], 2);
+        EXPECT_EQ(copy.values[4], 0);
+    }
+}
+
+TEST_P(ArrayManagerTest, BatchesMatchSingleCalls) {
+    ArrayManager manager(64, GetParam(), 4);
+    ASSERT_TRUE(manager.markElement(10, 2));
+    
+    // Unordered, with a duplicate and a cell another marker holds.
+    const BatchMarkResult all = manager.markElements({40, 7, 10, 7, 33, 1}, 1);
+    EXPECT_EQ(all.claimed, (std::vector<bool>{true, true, false, false, true, true}));
+    EXPECT_EQ(all.marked, 4u);
+    EXPECT_EQ(all.firstCollision, 2u);
+    EXPECT_EQ(manager.countMarkedElements(1), 4u);
+    EXPECT_EQ(manager.recountMarkedElements(1), 4u);
+    
+    // Nothing after the collision is tried.
+    const BatchMarkResult stopped = manager.markElements({50, 10, 51}, 1, true);
+    EXPECT_EQ(stopped.claimed, (std::vector<bool>{true, false, false}));
+    EXPECT_EQ(stopped.firstCollision, 1u);
+    EXPECT_EQ(manager.getElementAt(51), 0);
+    
+    EXPECT_THROW(manager.markElements({2, 64}, 1), std::out_of_range);
+    EXPECT_EQ(manager.getElementAt(2), 0);
+    
+    EXPECT_EQ(manager.resetElements({7, 10, 40, 40, 3}, 1), 2u);
+    EXPECT_EQ(manager.getElementAt(10), 2);
+    EXPECT_EQ(manager.countMarkedElements(1), 3u);
+    EXPECT_EQ(manager.resetMarkedElements(1), 3u);
+    EXPECT_EQ(manager.recountMarkedElements(0), 63u);
+}
+
+TEST_P(ArrayManagerTest, ClaimAnyFreeFillsEveryCell) {
+    ArrayManager manager(5000, GetParam());
+    ASSERT_TRUE(manager.markElement(4999, 2));
+    EXPECT_THROW(manager.claimAnyFree(1), std::logic_error);
+    EXPECT_THROW(manager.getOccupiedCount(), std::logic_error);
+    // Built from the cells, including the mark made before tracking.
+    manager.trackOccupancy();
+    EXPECT_EQ(manager.getOccupiedCount(), 1u);
+    
+    // From the hint onwards, then wrapping around.
+    EXPECT_EQ(manager.claimAnyFree(1, 4998), std::optional<size_t>(4998));
+    EXPECT_EQ(manager.claimAnyFree(1, 4998), std::optional<size_t>(0));
+    
+    std::mt19937 rng(3);
+    size_t claimed = 2;
+    while (manager.claimAnyFree(1, rng() % manager.getSize())) {
+        ++claimed;
+    }
+    EXPECT_EQ(claimed, 4999u);
+    EXPECT_TRUE(manager.isFull());
+    EXPECT_EQ(manager.countMarkedElements(1), 4999u);
+    
+    EXPECT_TRUE(manager.resetElement(1234, 1));
+    EXPECT_EQ(manager.getFreeCount(), 1u);
+    EXPECT_EQ(manager.claimAnyFree(3, 0), std::optional<size_t>(1234));
+    EXPECT_EQ(manager.resetMarkedElements(1), 4998u);
+    EXPECT_EQ(manager.getOccupiedCount(), 2u);
+    EXPECT_EQ(manager.claimAnyFree(1, 4999), std::optional<size_t>(0));
+}
+
+TEST_P(ArrayManagerTest, RetiredCellsReadFreeUntilSwept) {
+    ArrayManager manager(10000, GetParam());
+    manager.trackOccupancy();
+    for (size_t i = 0; i < manager.getSize(); ++i) {
+        ASSERT_TRUE(manager.markElement(i, i % 4 == 0 ? 2 : 1));
+    }
+    
+    EXPECT_EQ(manager.retireMarkedElements(1), 7500u);
+    EXPECT_TRUE(manager.isRetired(1));
+    EXPECT_EQ(manager.getElementAt(1), 0);
+    EXPECT_EQ(manager.countMarkedElements(1), 0u);
+    EXPECT_EQ(manager.recountMarkedElements(1), 0u);
+    EXPECT_EQ(manager.getOccupiedCount(), 2500u);
+    EXPECT_EQ(manager.snapshot().values[3], 0);
+    EXPECT_FALSE(manager.resetElement(1, 1));
+    EXPECT_THROW(manager.markElement(1, 1), std::invalid_argument);
+    
+    // Taken over in place, or found through the bitmap once the empty
+    // search has swept the rest.
+    EXPECT_TRUE(manager.markElement(1, 3));
+    EXPECT_FALSE(manager.markElement(4, 3));
+    EXPECT_EQ(manager.claimAnyFree(3, 2), std::optional<size_t>(2));
+    EXPECT_EQ(manager.getOccupiedCount(), 2502u);
+    EXPECT_EQ(manager.markerHistogram(4)[1], 0u);
+    EXPECT_EQ(manager.sweepRetired(), 0u);
+    // Drained, so the value can mark again.
+    EXPECT_FALSE(manager.isRetired(1));
+    EXPECT_TRUE(manager.markElement(3, 1));
+    EXPECT_EQ(manager.resetMarkedElements(1), 1u);
+    
+    EXPECT_EQ(manager.retireMarkedElements(2), 2500u);
+    EXPECT_EQ(manager.getOccupiedCount(), 2u);
+    EXPECT_EQ(manager.sweepRetired(), 2500u);
+    EXPECT_FALSE(manager.isRetired(2));
+    EXPECT_EQ(manager.getOccupiedCount(), 2u);
+    EXPECT_EQ(manager.recountMarkedElements(0), 9998u);
+    EXPECT_EQ(manager.resetMarkedElements(3), 2u);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, ArrayManagerTest,
+                         ::testing::Values(ArrayBackend::GlobalLock, ArrayBackend::Striped,
+                                           ArrayBackend::PerElement, ArrayBackend::LockFree));
+
+TEST(OccupancyBitmapTest, FindsFreeCellsAcrossLevels) {
+    // More than one top-level word, with a partial last word.
+    const size_t size = 64 * 64 * 64 + 1000;
+    OccupancyBitmap bitmap(size);
+    EXPECT_EQ(bitmap.findFree(0), 0u);
+    
+    for (size_t i = 0; i < size; ++i) {
+        bitmap.set(i);
+    }
+    EXPECT_EQ(bitmap.getOccupiedCount(), size);
+    EXPECT_EQ(bitmap.findFree(0), OccupancyBitmap::kNone);
+    
+    bitmap.clear(size - 1);
+    bitmap.clear(70000);
+    EXPECT_EQ(bitmap.findFree(0), 70000u);
+    EXPECT_EQ(bitmap.findFree(70001), size - 1);
+    EXPECT_EQ(bitmap.getOccupiedCount(), size - 2);
+    bitmap.set(70000);
+    EXPECT_EQ(bitmap.findFree(0), size - 1);
+    
+    bitmap.rebuild([](size_t index) { return index % 3 != 0; });
+    EXPECT_EQ(bitmap.findFree(1), 3u);
+    EXPECT_FALSE(bitmap.test(size - 1 - (size - 1) % 3));
+    EXPECT_EQ(bitmap.getOccupiedCount(), size - (size + 2) / 3);
+}
+
+TEST(OccupancyBitmapTest, ConcurrentClaimsTakeEachCellOnce) {
+    ArrayManager manager(100000, ArrayBackend::LockFree);
+    manager.trackOccupancy();
+    std::vector<size_t> claimed(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&manager, &claimed, t] {
+            // Shared hints make the markers race for the same cells.
+            size_t hint = 0;
+            while (auto index = manager.claimAnyFree(t + 1, hint)) {
+                ++claimed[static_cast<size_t>(t)];
+                hint = (*index * 7) % manager.getSize();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    size_t total = 0;
+    for (int t = 0; t < 4; ++t) {
+        EXPECT_EQ(manager.recountMarkedElements(t + 1), claimed[static_cast<size_t>(t)]);
+        total += claimed[static_cast<size_t>(t)];
+    }
+    EXPECT_EQ(total, manager.getSize());
+    EXPECT_TRUE(manager.isFull());
+}
+
+TEST(RetiredCellsTest, ConcurrentTakeoversAndSweepsCountEachCellOnce) {
+    ArrayManager manager(100000, ArrayBackend::LockFree);
+    manager.trackOccupancy();
+    while (manager.claimAnyFree(1)) {
+    }
+    manager.retireMarkedElements(1);
+    
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t) {
+        threads.emplace_back([&manager, t] {
+            std::mt19937 rng(static_cast<unsigned int>(t));
+            for (int i = 0; i < 20000; ++i) {
+                manager.markElement(rng() % manager.getSize(), t + 2);
+            }
+        });
+    }
+    threads.emplace_back([&manager] { manager.sweepRetired(); });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    manager.sweepRetired();
+    
+    size_t marked = 0;
+    for (int t = 0; t < 3; ++t) {
+        EXPECT_EQ(manager.recountMarkedElements(t + 2), manager.countMarkedElements(t + 2));
+        marked += manager.countMarkedElements(t + 2);
+    }
+    EXPECT_EQ(manager.getOccupiedCount(), marked);
+    EXPECT_EQ(manager.recountMarkedElements(0), manager.getFreeCount());
+}
+
+TEST(ArrayCellWidthTest, EveryWidthBehavesTheSame) {
+    for (CellWidth width : {CellWidth::Byte, CellWidth::Halfword, CellWidth::Word}) {
+        for (ArrayBackend backend : {ArrayBackend::GlobalLock, ArrayBackend::LockFree}) {
+            ArrayManager manager(3000, backend, 0, StorageOptions(), width);
+            
+            EXPECT_EQ(manager.getStorage().getCellBytes(), cellBytes(width));
+            EXPECT_TRUE(manager.markElement(0, 255));
+            EXPECT_FALSE(manager.markElement(0, 1));
+            for (size_t i = 1; i < 3000; i += 2) {
+                EXPECT_TRUE(manager.markElement(i, 7));
+            }
+            EXPECT_EQ(manager.getElementAt(0), 255);
+            EXPECT_EQ(manager.snapshot().values[1], 7);
+            EXPECT_EQ(manager.recountMarkedElements(7), 1500u);
+            EXPECT_EQ(manager.markerHistogram(8)[7], 1500u);
+            EXPECT_TRUE(manager.resetElement(1, 7));
+            // Above kBulkResetDivisor, so this goes through the reset kernel.
+            EXPECT_EQ(manager.resetMarkedElements(7), 1499u);
+            EXPECT_EQ(manager.recountMarkedElements(0), 2999u);
+        }
+    }
+    
+    EXPECT_EQ(narrowestCellWidth(255), CellWidth::Byte);
+    EXPECT_EQ(narrowestCellWidth(256), CellWidth::Halfword);
+}
+
+TEST(ArrayCellWidthTest, RejectsMarkersTooWideForCells) {
+    auto manager = std::make_shared<ArrayManager>(10, ArrayBackend::GlobalLock, 0, StorageOptions(),
+                                                  CellWidth::Byte);
+    EXPECT_EQ(manager->getMaxMarkerValue(), 255);
+    EXPECT_THROW(manager->markElement(0, 256), std::invalid_argument);
+    EXPECT_EQ(manager->recountMarkedElements(256), 0u);
+    EXPECT_EQ(manager->getElementAt(0), 0);
+    
+    ThreadManager threadManager(manager);
+    EXPECT_THROW(threadManager.createThreads(256), std::invalid_argument);
+    EXPECT_NO_THROW(threadManager.createThreads(255));
+}
+
+TEST(ArrayCellWidthTest, WordCellsTakeEveryPositiveInt) {
+    ArrayManager manager(10, ArrayBackend::GlobalLock, 0, StorageOptions(), CellWidth::Word);
+    EXPECT_EQ(manager.getMaxMarkerValue(), std::numeric_limits<int>::max());
+    
+    for (int marker : {70000, 1 << 24, std::numeric_limits<int>::max()}) {
+        EXPECT_TRUE(manager.markElement(1, marker));
+        EXPECT_EQ(manager.countMarkedElements(marker), 1u);
+        EXPECT_EQ(manager.retireMarkedElements(marker), 1u);
+        EXPECT_TRUE(manager.isRetired(marker));
+        EXPECT_EQ(manager.getElementAt(1), 0);
+        EXPECT_EQ(manager.sweepRetired(), 1u);
+        EXPECT_FALSE(manager.isRetired(marker));
+    }
+}
+
+TEST(ElementStorageTest, MappedStorageBehavesLikeHeap) {
+    for (HugePageMode hugePages : {HugePageMode::None, HugePageMode::Transparent, HugePageMode::Explicit}) {
+        StorageOptions storage;
+        storage.kind = StorageKind::Anonymous;
+        storage.hugePages = hugePages;
+        ArrayManager manager(5000, ArrayBackend::LockFree, 0, storage);
+        
+        EXPECT_EQ(manager.getStorage().getKind(), StorageKind::Anonymous);
+        EXPECT_EQ(manager.recountMarkedElements(0), 5000u);
+        EXPECT_TRUE(manager.markElement(4999, 3));
+        EXPECT_EQ(manager.getElementAt(4999), 3);
+        EXPECT_EQ(manager.resetMarkedElements(3), 1u);
+    }
+}
+
+TEST(ElementStorageTest, FileStorageReopensWithOwnership) {
+    const std::string path = ::testing::TempDir() + "element_storage_test.arr";
+    {
+        ArrayManager manager(100, ArrayBackend::GlobalLock, 0, parseStorageOptions("file:" + path));
+        manager.markElement(10, 4);
+        manager.markElement(20, 4);
+        manager.markElement(30, 9);
+        manager.persist();
+    }
+    {
+        ArrayManager manager(100, ArrayBackend::GlobalLock, 0, parseStorageOptions("reopen:" + path));
+        EXPECT_TRUE(manager.getStorage().wasReopened());
+        EXPECT_EQ(manager.getElementAt(20), 4);
+        EXPECT_EQ(manager.countMarkedElements(4), 2u);
+        EXPECT_EQ(manager.countMarkedElements(9), 1u);
+        EXPECT_FALSE(manager.markElement(30, 4));
+        EXPECT_EQ(manager.resetMarkedElements(4), 2u);
+    }
+    EXPECT_THROW(ArrayManager(50, ArrayBackend::GlobalLock, 0, parseStorageOptions("reopen:" + path)),
+                 std::runtime_error);
+    EXPECT_THROW(ArrayManager(100, ArrayBackend::GlobalLock, 0, parseStorageOptions("reopen:" + path),
+                              CellWidth::Byte),
+                 std::runtime_error);
+    {
+        // The rejected reopens left the marks alone.
+        ArrayManager manager(100, ArrayBackend::GlobalLock, 0, parseStorageOptions("reopen:" + path));
+        EXPECT_EQ(manager.getElementAt(30), 9);
+    }
+    {
+        // A plain file: storage starts over.
+        ArrayManager manager(100, ArrayBackend::GlobalLock, 0, parseStorageOptions("file:" + path));
+        EXPECT_FALSE(manager.getStorage().wasReopened());
+        EXPECT_EQ(manager.getElementAt(30), 0);
+    }
+    std::remove(path.c_str());
+    
+    EXPECT_THROW(parseStorageOptions("file:"), std::invalid_argument);
+    EXPECT_THROW(parseHugePageMode("gigantic"), std::invalid_argument);
+}
+
+TEST(ElementStorageTest, ReopenRejectsMissingAndForeignFiles) {
+    const std::string missing = ::testing::TempDir() + "element_storage_missing.arr";
+    std::remove(missing.c_str());
+    EXPECT_THROW(ArrayManager(100, ArrayBackend::GlobalLock, 0, parseStorageOptions("reopen:" + missing)),
+                 std::runtime_error);
+    // Not created either.
+    EXPECT_EQ(std::fopen(missing.c_str(), "rb"), nullptr);
+    
+    const std::string foreign = ::testing::TempDir() + "element_storage_foreign.txt";
+    {
+        std::FILE* file = std::fopen(foreign.c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        std::fputs("not an array", file);
+        std::fclose(file);
+    }
+    EXPECT_THROW(ArrayManager(100, ArrayBackend::GlobalLock, 0, parseStorageOptions("reopen:" + foreign)),
+                 std::runtime_error);
+    // Neither overwritten nor grown.
+    std::FILE* file = std::fopen(foreign.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    char contents[64] = {};
+    EXPECT_EQ(std::fread(contents, 1, sizeof(contents), file), 12u);
+    std::fclose(file);
+    EXPECT_STREQ(contents, "not an array");
+    std::remove(foreign.c_str());
+}
+
+// Two nodes of two cores with two hyperthreads each, numbered the way
+// Linux numbers them: first threads of every core, then the siblings.
+CpuTopology twoNodeTopology() {
+    return CpuTopology({{0, 0, 0, 0}, {1, 0, 0, 1}, {2, 1, 1, 0}, {3, 1, 1, 1},
+                        {4, 0, 0, 0}, {5, 0, 0, 1}, {6, 1, 1, 0}, {7, 1, 1, 1}});
+}
+
+TEST(PlacementTest, ParsesPoliciesAndCpuLists) {
+    EXPECT_EQ(parseCpuList("0-3,8,10-11"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(parseAffinityPolicy("scatter").kind, AffinityKind::Scatter);
+    EXPECT_EQ(parseAffinityPolicy("cpus:2,4").cpus, (std::vector<int>{2, 4}));
+    EXPECT_EQ(parseNumaPlacement("interleave"), NumaPlacement::Interleave);
+    EXPECT_THROW(parseCpuList("3-1"), std::invalid_argument);
+    EXPECT_THROW(parseCpuList("1,,2"), std::invalid_argument);
+    EXPECT_THROW(parseAffinityPolicy("cpus:"), std::invalid_argument);
+    EXPECT_THROW(parseNumaPlacement("local"), std::invalid_argument);
+    
+    EXPECT_TRUE(systemTopology().hasCpu(systemTopology().getCpus().front().cpu));
+}
+
+TEST(PlacementTest, CompactPacksAndScatterSpreads) {
+    const CpuTopology topology = twoNodeTopology();
+    
+    EXPECT_EQ(topology.getNodes(), (std::vector<int>{0, 1}));
+    EXPECT_EQ(topology.compactOrder(), (std::vector<int>{0, 4, 1, 5, 2, 6, 3, 7}));
+    EXPECT_EQ(topology.scatterOrder(), (std::vector<int>{0, 2, 1, 3, 4, 6, 5, 7}));
+    EXPECT_EQ(affinityCpu(AffinityPolicy::none(), topology, 3), -1);
+    EXPECT_EQ(affinityCpu(AffinityPolicy::scatter(), topology, 9), 2);
+    EXPECT_EQ(affinityCpu(AffinityPolicy::explicitCpus({5, 6}), topology, 3), 6);
+}
+
+TEST(PlacementTest, ThreadManagerAssignsCpus) {
+    auto array = std::make_shared<ArrayManager>(100);
+    ThreadManager manager(array);
+    const int cpu = systemTopology().getCpus().front().cpu;
+    
+    manager.createThreads(2);
+    manager.setAffinity(AffinityPolicy::explicitCpus({cpu}));
+    manager.createThreads(1);
+    for (int id = 1; id <= 3; ++id) {
+        EXPECT_EQ(manager.findThreadById(id)->getCpu(), cpu);
+    }
+    EXPECT_THROW(manager.setAffinity(AffinityPolicy::explicitCpus({1 << 20})), std::invalid_argument);
+    
+    manager.setAffinity(AffinityPolicy::compact());
+    manager.startAllThreads();
+    manager.waitForAllThreadsBlocked();
+    EXPECT_GT(manager.getTotalMarks(), 0u);
+}
+
+TEST(PlacementTest, FirstTouchKeepsContents) {
+    std::vector<char> buffer(100000, 'x');
+    buffer[99999] = 'y';
+    // Pinning to the second node's CPUs may fail here; touching must not.
+    firstTouchMemory(buffer.data(), buffer.size(), true, twoNodeTopology());
+    EXPECT_EQ(std::count(buffer.begin(), buffer.end(), 'x'), 99999);
+    EXPECT_EQ(buffer[99999], 'y');
+    
+    for (NumaPlacement numa : {NumaPlacement::FirstTouch, NumaPlacement::Interleave}) {
+        StorageOptions storage;
+        storage.kind = StorageKind::Anonymous;
+        storage.numa = numa;
+        ArrayManager manager(50000, ArrayBackend::GlobalLock, 0, storage);
+        
+        EXPECT_EQ(manager.recountMarkedElements(0), 50000u);
+        EXPECT_TRUE(manager.markElement(49999, 2));
+        EXPECT_EQ(manager.countMarkedElements(2), 1u);
+    }
+}
+
+TEST(ArrayDumpTest, FormatsEveryMode) {
+    ArraySnapshot snapshot;
+    snapshot.values = {0, 0, 0, 3, 3, 0, 7};
+    
+    EXPECT_EQ(ArrayDumper(ArrayDumpMode::Full).format(snapshot),
+              "Array contents: [0, 0, 0, 3, 3, 0, 7]\n");
+    EXPECT_EQ(ArrayDumper(ArrayDumpMode::RunLength).format(snapshot),
+              "Array runs: [0 x 3, 3 x 2, 0, 7]\n");
+    EXPECT_EQ(ArrayDumper(ArrayDumpMode::Summary).format(snapshot),
+              "Array summary: size=7 free=4 marker3=2 marker7=1\n");
+    EXPECT_EQ(ArrayDumper(ArrayDumpMode::Full).format(ArraySnapshot{}), "Array contents: []\n");
+    EXPECT_THROW(parseArrayDumpMode("json"), std::invalid_argument);
+}
+
+TEST(ArrayDumpTest, DeltaReportsChangesSincePreviousDump) {
+    ArrayManager manager(6);
+    ArrayDumper dumper(ArrayDumpMode::Delta);
+    
+    EXPECT_EQ(dumper.format(manager.snapshot()), "Array runs: [0 x 6]\n");
+    manager.markElement(1, 2);
+    manager.markElement(4, 2);
+    EXPECT_EQ(dumper.format(manager.snapshot()), "Array delta: changed=2 [1: 0 -> 2, 4: 0 -> 2]\n");
+    manager.resetElement(4, 2);
+    EXPECT_EQ(dumper.format(manager.snapshot()), "Array delta: changed=1 [4: 2 -> 0]\n");
+    EXPECT_EQ(dumper.format(manager.snapshot()), "Array delta: changed=0 []\n");
+    
+    std::ostringstream out;
+    ArrayDumper(ArrayDumpMode::Full).print(manager, out);
+    EXPECT_EQ(out.str(), "Array contents: [0, 2, 0, 0, 0, 0]\n");
+}
+
+TEST(ArrayManagerStripesTest, StripeCountDoesNotChangeResults) {
+    for (size_t stripes : {1u, 3u, 64u, 1000u}) {
+        ArrayManager manager(10, ArrayBackend::Striped, stripes);
+        EXPECT_TRUE(manager.markElement(4, 1));
+        EXPECT_FALSE(manager.markElement(4, 2));
+        EXPECT_TRUE(manager.markElement(5, 2));
+        EXPECT_EQ(manager.countMarkedElements(2), 1u);
+        EXPECT_EQ(manager.recountMarkedElements(1), 1u);
+    }
+}
+
+TEST(MockArrayManagerTest, ForwardsToRealBackend) {
+    auto mock = std::make_shared<::testing::NiceMock<MockArrayManager>>(10, ArrayBackend::Striped, 4);
+    EXPECT_CALL(*mock, markElement(::testing::An<size_t>(), ::testing::Eq(1))).Times(::testing::AtLeast(1));
+    
+    auto marker = std::make_shared<MarkerThread>(1, mock);
+    marker->start();
+    marker->signalStart();
+    marker->waitForBlocking();
+    
+    EXPECT_EQ(mock->countMarkedElements(1), marker->getMarkedCount());
+    
+    marker->sendCommand(MarkerCommand::Terminate);
+    marker->join();
+    EXPECT_EQ(mock->recountMarkedElements(1), 0u);
+}
+
+class ScanKernelsTest : public ::testing::TestWithParam<ScanIsa> {
+protected:
+    void SetUp() override {
+        if (!isScanIsaSupported(GetParam())) {
+            GTEST_SKIP() << scanIsaName(GetParam()) << " not supported on this CPU";
+        }
+    }
+    
+    static std::vector<int> makeData(size_t size, unsigned int seed) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> value(-1, 5);
+        std::vector<int> data(size);
+        for (auto& element : data) {
+            element = value(rng);
+        }
+        // Add uniform runs so the block fast paths are exercised too.
+        for (size_t i = 0; i + 40 < size; i += 97) {
+            std::fill(data.begin() + static_cast<long>(i), data.begin() + static_cast<long>(i + 40), static_cast<int>(i % 4));
+        }
+        return data;
+    }
+};
+
+TEST_P(ScanKernelsTest, MatchesScalarKernels) {
+    const ScanKernels& scalar = scanKernels(ScanIsa::Scalar);
+    const ScanKernels& vector = scanKernels(GetParam());
+    
+    for (size_t size : {0u, 1u, 3u, 7u, 15u, 16u, 17u, 33u, 1000u, 4099u}) {
+        for (int value = -1; value <= 5; ++value) {
+            auto expected = makeData(size, static_cast<unsigned int>(size));
+            auto actual = expected;
+            
+            EXPECT_EQ(vector.countEqual(actual.data(), size, value),
+                      scalar.countEqual(expected.data(), size, value));
+            EXPECT_EQ(vector.resetEqual(actual.data(), size, value),
+                      scalar.resetEqual(expected.data(), size, value));
+            EXPECT_EQ(actual, expected);
+        }
+        
+        const auto data = makeData(size, static_cast<unsigned int>(size) + 1);
+        // Few bins take the compare-and-count route, many the uniform-block one.
+        for (size_t binCount : {3u, 5u, 13u, 70u}) {
+            std::vector<size_t> expectedBins(binCount, 0);
+            std::vector<size_t> actualBins(binCount, 0);
+            scalar.histogram(data.data(), size, expectedBins.data(), expectedBins.size());
+            vector.histogram(data.data(), size, actualBins.data(), actualBins.size());
+            EXPECT_EQ(actualBins, expectedBins);
+        }
+    }
+}
+
+template <typename Cell>
+void expectNarrowKernelsMatch(const NarrowScanKernels<Cell>& scalar, const NarrowScanKernels<Cell>& vector) {
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> value(0, 5);
+    const Cell maxCell = std::numeric_limits<Cell>::max();
+    
+    // 20000 byte cells overflow the vector kernels' per-lane counters.
+    for (size_t size : {0u, 1u, 31u, 32u, 33u, 65u, 1000u, 20000u}) {
+        std::vector<Cell> data(size);
+        for (auto& element : data) {
+            element = static_cast<Cell>(value(rng));
+        }
+        for (size_t i = 0; i + 70 < size; i += 211) {
+            std::fill(data.begin() + static_cast<long>(i), data.begin() + static_cast<long>(i + 70),
+                      i % 3 == 0 ? maxCell : Cell(1));
+        }
+        
+        for (Cell target : {Cell(0), Cell(1), Cell(5), maxCell}) {
+            auto expected = data;
+            auto actual = data;
+            EXPECT_EQ(vector.countEqual(actual.data(), size, target),
+                      scalar.countEqual(expected.data(), size, target));
+            EXPECT_EQ(vector.resetEqual(actual.data(), size, target),
+                      scalar.resetEqual(expected.data(), size, target));
+            EXPECT_EQ(actual, expected);
+        }
+        
+        for (size_t binCount : {3u, 5u, 13u, 70u}) {
+            std::vector<size_t> expectedBins(binCount, 0);
+            std::vector<size_t> actualBins(binCount, 0);
+            scalar.histogram(data.data(), size, expectedBins.data(), expectedBins.size());
+            vector.histogram(data.data(), size, actualBins.data(), actualBins.size());
+            EXPECT_EQ(actualBins, expectedBins);
+        }
+    }
+}
+
+TEST_P(ScanKernelsTest, NarrowKernelsMatchScalar) {
+    const ScanKernels& scalar = scanKernels(ScanIsa::Scalar);
+    const ScanKernels& vector = scanKernels(GetParam());
+    
+    expectNarrowKernelsMatch(scalar.bytes, vector.bytes);
+    expectNarrowKernelsMatch(scalar.halfwords, vector.halfwords);
+}
+
+INSTANTIATE_TEST_SUITE_P(Isas, ScanKernelsTest,
+                         ::testing::Values(ScanIsa::Scalar, ScanIsa::SSE2, ScanIsa::AVX2, ScanIsa::AVX512));
+
 class EventTest : public ::testing::Test {
 protected:
     Event event;
@@ -104,6 +851,138 @@ TEST_F(EventTest, WaitForReturnsFalseOnTimeout) {
     EXPECT_FALSE(event.waitFor(50ms));
 }
 
+TEST_F(EventTest, SignalWakesParkedWaiter) {
+    std::atomic<bool> woke(false);
+    std::thread waiter([this, &woke] {
+        event.wait();
+        woke.store(true);
+    });
+    
+    std::this_thread::sleep_for(20ms);
+    EXPECT_FALSE(woke.load());
+    event.signal();
+    waiter.join();
+    EXPECT_TRUE(woke.load());
+}
+
+TEST_F(EventTest, WaitForWakesBeforeTimeout) {
+    std::thread signaller([this] {
+        std::this_thread::sleep_for(10ms);
+        event.signal();
+    });
+    
+    EXPECT_TRUE(event.waitFor(5000ms));
+    signaller.join();
+}
+
+TEST(CountdownEventTest, RejectsNegativeCount) {
+    EXPECT_THROW(CountdownEvent(-1), std::invalid_argument);
+}
+
+TEST(CountdownEventTest, SetsAfterAllSignals) {
+    CountdownEvent countdown(3);
+    std::vector<std::thread> signallers;
+    for (int i = 0; i < 3; ++i) {
+        signallers.emplace_back([&countdown] { countdown.signal(); });
+    }
+    
+    EXPECT_TRUE(countdown.waitFor(5000ms));
+    EXPECT_TRUE(countdown.isSet());
+    for (auto& signaller : signallers) {
+        signaller.join();
+    }
+}
+
+TEST(CountdownEventTest, AddCountAndReset) {
+    CountdownEvent countdown(1);
+    countdown.addCount(2);
+    countdown.signal();
+    countdown.signal();
+    EXPECT_FALSE(countdown.waitFor(10ms));
+    countdown.signal();
+    EXPECT_TRUE(countdown.isSet());
+    EXPECT_THROW(countdown.addCount(), std::logic_error);
+    
+    countdown.reset(2);
+    EXPECT_FALSE(countdown.isSet());
+}
+
+TEST(CountdownEventTest, OnlyTheFinalSignalWakesTheWaiter) {
+    CountdownEvent countdown(8);
+    Event event;
+    std::thread countdownWaiter([&countdown] { countdown.wait(); });
+    std::thread eventWaiter([&event] { event.wait(); });
+    while (countdown.getParkCount() == 0 || event.getParkCount() == 0) {
+        std::this_thread::sleep_for(1ms);
+    }
+    
+    // A waiter woken too early finds its condition false and parks again.
+    for (int i = 0; i < 7; ++i) {
+        countdown.signal();
+        event.reset();
+        std::this_thread::sleep_for(2ms);
+    }
+    EXPECT_FALSE(countdown.isSet());
+    countdown.signal();
+    event.signal();
+    countdownWaiter.join();
+    eventWaiter.join();
+    EXPECT_EQ(countdown.getParkCount(), 1u);
+    EXPECT_EQ(event.getParkCount(), 1u);
+}
+
+TEST(ParkingWordTest, WakeOneReleasesOneParkedWaiter) {
+    ParkingWord word(0);
+    std::atomic<int> released(0);
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 2; ++i) {
+        waiters.emplace_back([&] {
+            word.waitUntil([](uint32_t value) { return value != 0; });
+            ++released;
+        });
+    }
+    while (word.getParkCount() < 2) {
+        std::this_thread::sleep_for(1ms);
+    }
+    std::this_thread::sleep_for(10ms);
+    
+    word.store(1);
+    word.wakeOne();
+    while (released.load() == 0) {
+        std::this_thread::sleep_for(1ms);
+    }
+    std::this_thread::sleep_for(20ms);
+#if defined(__linux__)
+    EXPECT_EQ(released.load(), 1);
+#endif
+
+    word.wakeAll();
+    for (auto& waiter : waiters) {
+        waiter.join();
+    }
+    EXPECT_EQ(released.load(), 2);
+}
+
+TEST(EpochEventTest, AdvanceReleasesAllWaiters) {
+    EpochEvent epoch;
+    const uint32_t seen = epoch.current();
+    std::atomic<int> released(0);
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 4; ++i) {
+        waiters.emplace_back([&] {
+            epoch.waitForChange(seen);
+            ++released;
+        });
+    }
+    
+    EXPECT_FALSE(epoch.waitForChangeFor(seen, 10ms));
+    EXPECT_EQ(epoch.advance(), seen + 1);
+    for (auto& waiter : waiters) {
+        waiter.join();
+    }
+    EXPECT_EQ(released.load(), 4);
+}
+
 class MarkerThreadTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -120,14 +999,14 @@ TEST_F(MarkerThreadTest, InitialIdIsCorrect) {
 }
 
 TEST_F(MarkerThreadTest, ThreadRunsAndBlocks) {
-    
+
     markerThread->start();
     markerThread->signalStart();
     markerThread->waitForBlocking();
     
     
     EXPECT_TRUE(markerThread->isBlocked());
-    EXPECT_GT(markerThread->getMarkedCount(), 0);
+    EXPECT_GT(markerThread->getMarkedCount(), 0u);
     
     
     markerThread->sendCommand(MarkerCommand::Terminate);
@@ -144,6 +1023,295 @@ TEST_F(MarkerThreadTest, ThreadRunsAndBlocks) {
     EXPECT_FALSE(markerThread->isRunning());
 }
 
+TEST_F(MarkerThreadTest, UnpacedMarkerBlocksAndTerminates) {
+    markerThread->setPacing(PacingPolicy::none());
+    markerThread->start();
+    EXPECT_THROW(markerThread->setPacing(PacingPolicy::spin(10)), std::logic_error);
+    
+    markerThread->signalStart();
+    markerThread->waitForBlocking();
+    EXPECT_GT(markerThread->getTotalMarks(), 0u);
+    
+    markerThread->sendCommand(MarkerCommand::Terminate);
+    markerThread->join();
+    EXPECT_EQ(arrayManager->recountMarkedElements(1), 0u);
+}
+
+TEST(PacingTest, ParsesPolicies) {
+    EXPECT_EQ(parsePacingPolicy("none").mode, PacingMode::None);
+    
+    const PacingPolicy spin = parsePacingPolicy("spin:2000");
+    EXPECT_EQ(spin.mode, PacingMode::Spin);
+    EXPECT_EQ(spin.spinCycles, 2000u);
+    
+    const PacingPolicy sleep = parsePacingPolicy("sleep:250:50");
+    EXPECT_EQ(sleep.mode, PacingMode::Sleep);
+    EXPECT_EQ(sleep.sleepDuration, std::chrono::microseconds(250));
+    EXPECT_EQ(sleep.sleepJitter, std::chrono::microseconds(50));
+    
+    EXPECT_EQ(PacingPolicy().sleepDuration, std::chrono::microseconds(5000));
+    EXPECT_THROW(parsePacingPolicy("spin"), std::invalid_argument);
+    EXPECT_THROW(parsePacingPolicy("sleep:-1"), std::invalid_argument);
+    EXPECT_THROW(parsePacingPolicy("nap:5"), std::invalid_argument);
+}
+
+TEST(PacingTest, SleepHonoursDuration) {
+    Pacer pacer(PacingPolicy::sleep(std::chrono::microseconds(2000), std::chrono::microseconds(1000)), 1);
+    const auto start = std::chrono::steady_clock::now();
+    pacer.pace();
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::microseconds(2000));
+}
+
+TEST(IndexGeneratorTest, SameSeedSameSequence) {
+    Xoshiro256 first(42);
+    Xoshiro256 second(42);
+    Xoshiro256 other(43);
+    bool differs = false;
+    for (int i = 0; i < 100; ++i) {
+        const uint64_t value = first();
+        EXPECT_EQ(value, second());
+        differs |= value != other();
+    }
+    EXPECT_TRUE(differs);
+}
+
+TEST(IndexGeneratorTest, AllPatternsStayInBounds) {
+    for (const char* pattern : {"uniform", "zipf:0.8", "zipf:1", "zipf:1.5", "sequential", "strided:7"}) {
+        IndexGenerator generator(parseAccessPolicy(pattern), 97, 3);
+        for (int i = 0; i < 10000; ++i) {
+            ASSERT_LT(generator.next(), 97u) << pattern;
+        }
+    }
+}
+
+TEST(IndexGeneratorTest, SequentialAndStridedWrap) {
+    IndexGenerator sequential(parseAccessPolicy("sequential"), 5, 1);
+    const size_t start = sequential.next();
+    EXPECT_EQ(sequential.next(), (start + 1) % 5);
+    
+    IndexGenerator strided(parseAccessPolicy("strided:3"), 10, 1);
+    const size_t first = strided.next();
+    EXPECT_EQ(strided.next(), (first + 3) % 10);
+    EXPECT_EQ(strided.next(), (first + 6) % 10);
+    EXPECT_EQ(strided.next(), (first + 9) % 10);
+}
+
+TEST(IndexGeneratorTest, ZipfConcentratesOnLowIndices) {
+    constexpr size_t size = 1000;
+    constexpr int draws = 200000;
+    IndexGenerator generator(parseAccessPolicy("zipf:1"), size, 9);
+    std::vector<int> hits(size, 0);
+    for (int i = 0; i < draws; ++i) {
+        ++hits[generator.next()];
+    }
+    
+    // P(rank 1) = 1 / H(1000) ~= 0.1336 for exponent 1.
+    EXPECT_NEAR(static_cast<double>(hits[0]) / draws, 0.1336, 0.01);
+    EXPECT_GT(hits[0], hits[1]);
+    EXPECT_GT(hits[1], hits[10]);
+}
+
+TEST(IndexGeneratorTest, RejectsBadPatterns) {
+    EXPECT_THROW(parseAccessPolicy("gaussian"), std::invalid_argument);
+    EXPECT_THROW(parseAccessPolicy("zipf:0"), std::invalid_argument);
+    EXPECT_THROW(parseAccessPolicy("strided:0"), std::invalid_argument);
+    EXPECT_THROW(parseAccessPolicy("uniform:2"), std::invalid_argument);
+}
+
+TEST(TraceTest, RingDropsWhenFull) {
+    TraceRing ring(4);
+    for (uint64_t i = 0; i < 6; ++i) {
+        ring.record(TraceEventType::Mark, 1, i);
+    }
+    
+    std::vector<TraceRecord> drained;
+    EXPECT_EQ(ring.drainInto(drained), 4u);
+    EXPECT_EQ(ring.getDropped(), 2u);
+    EXPECT_EQ(drained.back().index, 3u);
+    EXPECT_LE(drained.front().timestamp, drained.back().timestamp);
+    
+    ring.record(TraceEventType::Reset, 1, 4);
+    drained.clear();
+    EXPECT_EQ(ring.drainInto(drained), 1u);
+    EXPECT_EQ(drained.front().type, TraceEventType::Reset);
+}
+
+TEST(TraceTest, RecorderRoundTripsMarkerEvents) {
+    const std::string path = ::testing::TempDir() + "marker_trace_test.trc";
+    {
+        auto arrayManager = std::make_shared<ArrayManager>(10);
+        auto recorder = std::make_shared<TraceRecorder>(path, arrayManager->getSize());
+        auto marker = std::make_shared<MarkerThread>(1, arrayManager);
+        marker->setPacing(PacingPolicy::none());
+        marker->setTraceRecorder(recorder);
+        
+        marker->start();
+        marker->signalStart();
+        marker->waitForBlocking();
+        marker->sendCommand(MarkerCommand::Terminate);
+        marker->join();
+        recorder->stop();
+        EXPECT_EQ(recorder->getDropped(), 0u);
+    }
+    
+    const TraceFile trace = readTraceFile(path);
+    std::remove(path.c_str());
+    EXPECT_EQ(trace.header.arraySize, 10u);
+    
+    std::map<TraceEventType, size_t> counts;
+    for (const auto& record : trace.records) {
+        EXPECT_EQ(record.markerId, 1u);
+        ++counts[record.type];
+    }
+    EXPECT_GT(counts[TraceEventType::Mark], 0u);
+    EXPECT_EQ(counts[TraceEventType::Collision], 1u);
+    EXPECT_EQ(counts[TraceEventType::Block], 1u);
+    EXPECT_EQ(counts[TraceEventType::Terminate], 1u);
+    EXPECT_EQ(counts[TraceEventType::Reset], 1u);
+    EXPECT_EQ(trace.records.back().index, counts[TraceEventType::Mark]);
+}
+
+TEST(TraceTest, RejectsForeignFiles) {
+    EXPECT_THROW(readTraceFile("/nonexistent/trace.trc"), std::runtime_error);
+}
+
+TEST(MarkerStatsTest, HistogramBucketsBoundTheirValues) {
+    const std::vector<uint64_t> values = {0, 1, 7, 8, 9, 100, 12345, uint64_t(1) << 40, UINT64_MAX};
+    for (uint64_t value : values) {
+        const size_t bucket = LatencyHistogram::bucketFor(value);
+        ASSERT_LT(bucket, LatencyHistogram::kBucketCount);
+        EXPECT_GE(LatencyHistogram::bucketUpperBound(bucket), value);
+        if (bucket > 0) {
+            EXPECT_LT(LatencyHistogram::bucketUpperBound(bucket - 1), value);
+        }
+    }
+    EXPECT_EQ(LatencyHistogram::bucketFor(UINT64_MAX), LatencyHistogram::kBucketCount - 1);
+}
+
+TEST(MarkerStatsTest, PercentilesStayWithinBucketPrecision) {
+    LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.record(value);
+    }
+    
+    HistogramSnapshot snapshot;
+    histogram.snapshotInto(snapshot);
+    EXPECT_EQ(snapshot.count, 1000u);
+    EXPECT_EQ(snapshot.min, 1u);
+    EXPECT_EQ(snapshot.max, 1000u);
+    EXPECT_DOUBLE_EQ(snapshot.mean(), 500.5);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(50)), 500.0, 500.0 / 8);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(99)), 990.0, 990.0 / 8);
+    EXPECT_EQ(snapshot.percentile(100), 1000u);
+    
+    HistogramSnapshot merged;
+    merged.merge(snapshot);
+    merged.merge(snapshot);
+    EXPECT_EQ(merged.count, 2000u);
+    EXPECT_EQ(merged.percentile(0), snapshot.percentile(0));
+}
+
+TEST(MarkerStatsTest, CountersSplitAttempts) {
+    MarkerStats stats;
+    stats.countAttempt(true);
+    stats.countAttempt(true);
+    stats.countAttempt(false);
+    stats.recordBlock(300, 20);
+    
+    const MarkerStatsSnapshot snapshot = stats.snapshot(4);
+    EXPECT_EQ(snapshot.markerId, 4);
+    EXPECT_EQ(snapshot.markAttempts, 3u);
+    EXPECT_EQ(snapshot.successfulMarks, 2u);
+    EXPECT_EQ(snapshot.collisions, 1u);
+    EXPECT_EQ(snapshot.blockedNanos, 300u);
+    EXPECT_EQ(snapshot.resumeLatency.count, 1u);
+    EXPECT_EQ(snapshot.cleanupDuration.count, 0u);
+}
+
+TEST(LoggerTest, RoutesLevelsAndFormatsParts) {
+    std::ostringstream out;
+    std::ostringstream err;
+    {
+        Logger logger(out, err);
+        EXPECT_FALSE(logger.log(LogLevel::Debug, "hidden"));
+        EXPECT_TRUE(logger.log(LogLevel::Info, "Marker ", 3, " index ", size_t(42), ' ', std::string("ok")));
+        EXPECT_TRUE(logger.log(LogLevel::Error, "failed"));
+        logger.flush();
+        EXPECT_EQ(out.str(), "Marker 3 index 42 ok\n");
+        EXPECT_EQ(err.str(), "failed\n");
+        
+        logger.setLevel(LogLevel::Off);
+        EXPECT_FALSE(logger.log(LogLevel::Error, "silenced"));
+    }
+    EXPECT_EQ(err.str(), "failed\n");
+}
+
+TEST(LoggerTest, SwitchesStreamsAfterWritingQueuedRecords) {
+    std::ostringstream err;
+    std::ostringstream out;
+    Logger logger(err, err);
+    logger.log(LogLevel::Info, "before");
+    logger.setStreams(out, err);
+    logger.log(LogLevel::Info, "after");
+    logger.log(LogLevel::Warning, "warned");
+    logger.flush();
+    
+    EXPECT_EQ(out.str(), "after\n");
+    EXPECT_EQ(err.str(), "before\nwarned\n");
+}
+
+TEST(LoggerTest, ConcurrentProducersLoseNothingWhenBlocking) {
+    std::ostringstream out;
+    std::ostringstream err;
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 2000;
+    {
+        Logger logger(out, err, 16, LogOverflow::Block);
+        std::vector<std::thread> producers;
+        for (int t = 0; t < kThreads; ++t) {
+            producers.emplace_back([&logger, t] {
+                for (int i = 0; i < kRecords; ++i) {
+                    logger.log(LogLevel::Info, t, ":", i);
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        logger.flush();
+        EXPECT_EQ(logger.getDropped(), 0u);
+    }
+    
+    std::istringstream lines(out.str());
+    std::vector<int> next(kThreads, 0);
+    std::string line;
+    int total = 0;
+    while (std::getline(lines, line)) {
+        const size_t colon = line.find(':');
+        const int producer = std::stoi(line.substr(0, colon));
+        // Each producer's records keep their order.
+        EXPECT_EQ(std::stoi(line.substr(colon + 1)), next[producer]++);
+        ++total;
+    }
+    EXPECT_EQ(total, kThreads * kRecords);
+}
+
+TEST(LoggerTest, DropsOnOverflowAndTruncates) {
+    std::ostringstream out;
+    std::ostringstream err;
+    Logger logger(out, err, 2, LogOverflow::Drop);
+    
+    size_t accepted = 0;
+    for (int i = 0; i < 10000; ++i) {
+        accepted += logger.log(LogLevel::Info, std::string(Logger::kMaxMessageLength + 10, 'x')) ? 1 : 0;
+    }
+    logger.flush();
+    EXPECT_EQ(accepted + logger.getDropped(), 10000u);
+    EXPECT_EQ(out.str().size(), accepted * (Logger::kMaxMessageLength + 1));
+    EXPECT_THROW(Logger(out, err, 3), std::invalid_argument);
+    EXPECT_THROW(parseLogLevel("loud"), std::invalid_argument);
+}
+
 class ThreadManagerTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -157,7 +1325,7 @@ protected:
 
 TEST_F(ThreadManagerTest, CreateThreadsIncreasesActiveThreadCount) {
     threadManager->createThreads(3);
-    EXPECT_EQ(threadManager->getActiveThreadCount(), 3);
+    EXPECT_EQ(threadManager->getActiveThreadCount(), 3u);
 }
 
 TEST_F(ThreadManagerTest, FindThreadByIdWorks) {
@@ -181,7 +1349,7 @@ TEST_F(ThreadManagerTest, ThreadTerminationReducesActiveCount) {
     threadManager->terminateThread(2);
     
     
-    EXPECT_EQ(threadManager->getActiveThreadCount(), 2);
+    EXPECT_EQ(threadManager->getActiveThreadCount(), 2u);
     EXPECT_EQ(threadManager->findThreadById(2), nullptr);
     
     
@@ -190,11 +1358,629 @@ TEST_F(ThreadManagerTest, ThreadTerminationReducesActiveCount) {
     
     
     auto activeIds = threadManager->getActiveThreadIds();
-    EXPECT_EQ(activeIds.size(), 2);
+    EXPECT_EQ(activeIds.size(), 2u);
     EXPECT_NE(std::find(activeIds.begin(), activeIds.end(), 1), activeIds.end());
     EXPECT_NE(std::find(activeIds.begin(), activeIds.end(), 3), activeIds.end());
 }
 
+TEST_F(ThreadManagerTest, RoundsRunUntilAllThreadsTerminated) {
+    threadManager->createThreads(5);
+    threadManager->startAllThreads();
+    
+    while (!threadManager->areAllThreadsFinished()) {
+        threadManager->waitForAllThreadsBlocked();
+        
+        const int victim = threadManager->getActiveThreadIds().front();
+        threadManager->terminateThread(victim);
+        EXPECT_EQ(arrayManager->recountMarkedElements(victim), 0u);
+        
+        if (!threadManager->areAllThreadsFinished()) {
+            threadManager->continueOtherThreads();
+        }
+    }
+    
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+    EXPECT_THROW(threadManager->terminateThread(1), std::invalid_argument);
+}
+
+TEST(VictimPolicyTest, PoliciesPickByTheirRule) {
+    const std::vector<VictimCandidate> candidates = {
+        {1, 4, 300}, {2, 9, 100}, {3, 2, 200}, {4, 9, 400}, {5, 2, 500}};
+    const auto pick = [&candidates](TerminationChoice choice) {
+        return VictimSelector(choice).choose(candidates);
+    };
+    
+    EXPECT_EQ(pick(TerminationChoice::First), 1);
+    EXPECT_EQ(pick(TerminationChoice::Last), 5);
+    // Ties go to the earlier marker.
+    EXPECT_EQ(pick(TerminationChoice::MostMarked), 2);
+    EXPECT_EQ(pick(TerminationChoice::FewestMarked), 3);
+    EXPECT_EQ(pick(TerminationChoice::Oldest), 2);
+    
+    VictimSelector roundRobin(TerminationChoice::RoundRobin);
+    EXPECT_EQ(roundRobin.choose(candidates), 1);
+    EXPECT_EQ(roundRobin.choose(candidates), 2);
+    EXPECT_EQ(roundRobin.choose({candidates[0], candidates[1]}), 1);
+    
+    VictimSelector first(TerminationChoice::Random, 42);
+    VictimSelector second(TerminationChoice::Random, 42);
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(first.choose(candidates), second.choose(candidates));
+    }
+    EXPECT_THROW(first.choose({}), std::invalid_argument);
+    
+    EXPECT_EQ(parseTerminationChoice("round-robin"), TerminationChoice::RoundRobin);
+    EXPECT_EQ(parseTerminationChoice("most"), TerminationChoice::MostMarked);
+    EXPECT_THROW(parseTerminationChoice("youngest"), std::invalid_argument);
+}
+
+TEST_F(ThreadManagerTest, AutomaticRoundsFollowThePolicy) {
+    threadManager->setPacing(PacingPolicy::none());
+    threadManager->setVictimPolicy(TerminationChoice::MostMarked);
+    threadManager->createThreads(4);
+    threadManager->startAllThreads();
+    
+    const RoundReport first = threadManager->runRound([this](const RoundReport& report) {
+        EXPECT_EQ(report.activeMarkers, 4u);
+        for (int id : threadManager->getActiveThreadIds()) {
+            EXPECT_LE(threadManager->findThreadById(id)->getMarkedCount(), report.victimMarked);
+        }
+    });
+    EXPECT_EQ(first.round, 1u);
+    EXPECT_EQ(threadManager->findThreadById(first.victim), nullptr);
+    EXPECT_EQ(arrayManager->recountMarkedElements(first.victim), 0u);
+    EXPECT_EQ(first.total, first.blockWait + first.cleanup);
+    
+    const std::vector<RoundReport> rest = threadManager->runRounds();
+    ASSERT_EQ(rest.size(), 3u);
+    EXPECT_EQ(rest.back().round, 4u);
+    EXPECT_EQ(rest.back().activeMarkers, 1u);
+    EXPECT_TRUE(threadManager->areAllThreadsFinished());
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+    EXPECT_THROW(threadManager->runRound(), std::logic_error);
+}
+
+TEST_F(ThreadManagerTest, BatchedMarkersRunTheSameRounds) {
+    threadManager->setPacing(PacingPolicy::none());
+    threadManager->setMarkBatch(8);
+    threadManager->createThreads(4);
+    threadManager->startAllThreads();
+    
+    threadManager->waitForAllThreadsBlocked();
+    for (int id : threadManager->getActiveThreadIds()) {
+        const auto thread = threadManager->findThreadById(id);
+        EXPECT_NE(arrayManager->getElementAt(thread->getBlockedIndex()), 0);
+        EXPECT_EQ(arrayManager->recountMarkedElements(id), thread->getMarkedCount());
+    }
+    threadManager->terminateThread(1);
+    threadManager->continueOtherThreads();
+    
+    threadManager->runRounds();
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+    EXPECT_THROW(threadManager->setMarkBatch(0), std::invalid_argument);
+}
+
+TEST_F(ThreadManagerTest, NearestClaimsBlockOnlyOnceTheArrayIsFull) {
+    threadManager->setPacing(PacingPolicy::none());
+    threadManager->setClaimMode(ClaimMode::Nearest);
+    threadManager->createThreads(3);
+    threadManager->startAllThreads();
+    
+    threadManager->waitForAllThreadsBlocked();
+    EXPECT_TRUE(arrayManager->isFull());
+    const size_t victimMarked = arrayManager->recountMarkedElements(2);
+    threadManager->terminateThread(2);
+    EXPECT_EQ(arrayManager->getFreeCount(), victimMarked);
+    threadManager->continueOtherThreads();
+    
+    threadManager->waitForAllThreadsBlocked();
+    EXPECT_TRUE(arrayManager->isFull());
+    threadManager->runRounds();
+    EXPECT_EQ(arrayManager->getOccupiedCount(), 0u);
+}
+
+TEST_F(ThreadManagerTest, LazyReleaseRetiresTheVictimsCells) {
+    threadManager->setPacing(PacingPolicy::none());
+    threadManager->setClaimMode(ClaimMode::Nearest);
+    threadManager->setReleaseMode(ReleaseMode::Lazy);
+    threadManager->createThreads(3);
+    threadManager->startAllThreads();
+    
+    threadManager->waitForAllThreadsBlocked();
+    const size_t victimMarked = arrayManager->countMarkedElements(2);
+    threadManager->terminateThread(2);
+    // Free at once, whether or not the sweeper has drained them yet.
+    EXPECT_EQ(arrayManager->recountMarkedElements(2), 0u);
+    EXPECT_EQ(arrayManager->getFreeCount(), victimMarked);
+    threadManager->continueOtherThreads();
+    
+    threadManager->waitForAllThreadsBlocked();
+    EXPECT_TRUE(arrayManager->isFull());
+    threadManager->runRounds();
+    threadManager.reset();
+    arrayManager->sweepRetired();
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+
+TEST_F(ThreadManagerTest, MarkersCanBeRecreatedAfterALazyRelease) {
+    threadManager->setPacing(PacingPolicy::none());
+    threadManager->setReleaseMode(ReleaseMode::Lazy);
+    threadManager->createThreads(3);
+    threadManager->startAllThreads();
+    EXPECT_EQ(threadManager->runRounds().size(), 3u);
+    threadManager.reset();
+    
+    // A new owner takes the same ids 1..3 while their cells may still be
+    // waiting for the sweep.
+    threadManager = std::make_shared<ThreadManager>(arrayManager);
+    threadManager->setPacing(PacingPolicy::none());
+    threadManager->createThreads(3);
+    for (int id = 1; id <= 3; ++id) {
+        EXPECT_FALSE(arrayManager->isRetired(id));
+    }
+    threadManager->startAllThreads();
+    EXPECT_EQ(threadManager->runRounds().size(), 3u);
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+
+TEST(ThreadManagerFailureTest, FailedMarkersAreDroppedFromLaterRounds) {
+    auto mock = std::make_shared<::testing::NiceMock<MockArrayManager>>(20);
+    ON_CALL(*mock, markElement(::testing::An<size_t>(), ::testing::Ge(2)))
+        .WillByDefault(::testing::Throw(std::runtime_error("injected failure")));
+    
+    ThreadManager manager(mock);
+    manager.setPacing(PacingPolicy::none());
+    manager.createThreads(3);
+    manager.startAllThreads();
+    
+    // Marker 1 is the only one left after the first round.
+    const std::vector<RoundReport> reports = manager.runRounds();
+    ASSERT_EQ(reports.size(), 1u);
+    EXPECT_EQ(reports[0].victim, 1);
+    EXPECT_EQ(reports[0].activeMarkers, 1u);
+    EXPECT_TRUE(manager.areAllThreadsFinished());
+    EXPECT_EQ(mock->recountMarkedElements(0), mock->getSize());
+}
+
+TEST(ThreadManagerFailureTest, MarkersFailingAtStartDoNotHangTheRound) {
+    auto mock = std::make_shared<::testing::NiceMock<MockArrayManager>>(20);
+    ON_CALL(*mock, getSize()).WillByDefault(::testing::Throw(std::runtime_error("injected failure")));
+    
+    ThreadManager manager(mock);
+    manager.createThreads(2);
+    manager.startAllThreads();
+    manager.waitForAllThreadsBlocked();
+    EXPECT_TRUE(manager.areAllThreadsFinished());
+    EXPECT_TRUE(manager.runRounds().empty());
+}
+
+TEST(ThreadManagerShutdownTest, DestroyWhileMarkersRun) {
+    // A large array keeps the survivor marking long after the release, so the
+    // manager is destroyed before it blocks again.
+    auto arrayManager = std::make_shared<ArrayManager>(size_t(1) << 22, ArrayBackend::LockFree);
+    {
+        ThreadManager manager(arrayManager);
+        manager.setPacing(PacingPolicy::none());
+        manager.createThreads(2);
+        manager.startAllThreads();
+        manager.waitForAllThreadsBlocked();
+        manager.terminateThread(1);
+        manager.continueOtherThreads();
+    }
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+
+TEST(WorkerPoolTest, ThousandsOfMarkersShareAFewWorkers) {
+    auto arrayManager = std::make_shared<ArrayManager>(20000, ArrayBackend::LockFree);
+    {
+        ThreadManager manager(arrayManager);
+        manager.setPacing(PacingPolicy::sleep(std::chrono::microseconds(200)));
+        manager.useWorkerPool(2);
+        manager.createThreads(2000);
+        manager.startAllThreads();
+        
+        for (int round = 0; round < 3; ++round) {
+            manager.waitForAllThreadsBlocked();
+            const int victim = manager.getActiveThreadIds().back();
+            manager.terminateThread(victim);
+            EXPECT_EQ(arrayManager->recountMarkedElements(victim), 0u);
+            manager.continueOtherThreads();
+        }
+        EXPECT_EQ(manager.getActiveThreadCount(), 1997u);
+        EXPECT_EQ(manager.getWorkerPool()->getWorkerCount(), 2u);
+    }
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+
+TEST(WorkerPoolTest, StandaloneMarkerRunsAsTask) {
+    auto arrayManager = std::make_shared<ArrayManager>(10);
+    auto pool = std::make_shared<WorkStealingPool>(1);
+    MarkerThread marker(1, arrayManager);
+    marker.setPool(pool);
+    
+    marker.start();
+    marker.signalStart();
+    marker.waitForBlocking();
+    EXPECT_GT(marker.getMarkedCount(), 0u);
+    
+    marker.sendCommand(MarkerCommand::Terminate);
+    marker.join();
+    EXPECT_FALSE(marker.isRunning());
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+
+TEST(WorkerPoolTest, RunsDelayedAndStolenTasks) {
+    struct CountingTask : PoolTask {
+        WorkStealingPool* pool = nullptr;
+        std::atomic<int>* finished = nullptr;
+        int runsLeft = 5;
+        
+        void run() override {
+            if (--runsLeft == 0) {
+                finished->fetch_add(1);
+            } else if (runsLeft % 2 == 0) {
+                pool->submitAfter(this, std::chrono::microseconds(500));
+            } else {
+                pool->submit(this);
+            }
+        }
+    };
+    
+    std::atomic<int> finished{0};
+    std::vector<CountingTask> tasks(500);
+    {
+        WorkStealingPool pool(4);
+        for (auto& task : tasks) {
+            task.pool = &pool;
+            task.finished = &finished;
+            pool.submit(&task);
+        }
+        
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (finished.load() < 500 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    EXPECT_EQ(finished.load(), 500);
+}
+
+#ifdef THREAD_SYNC_PROCESSES
+std::shared_ptr<ArrayManager> makeSharedArray(size_t size) {
+    StorageOptions storage;
+    storage.kind = StorageKind::Shared;
+    return std::make_shared<ArrayManager>(size, ArrayBackend::LockFree, 0, storage);
+}
+
+TEST(ProcessManagerTest, NeedsSharedLockFreeArray) {
+    EXPECT_THROW(ProcessManager(std::make_shared<ArrayManager>(10, ArrayBackend::LockFree)),
+                 std::invalid_argument);
+    StorageOptions storage;
+    storage.kind = StorageKind::Shared;
+    EXPECT_THROW(ProcessManager(std::make_shared<ArrayManager>(10, ArrayBackend::GlobalLock, 0, storage)),
+                 std::invalid_argument);
+    EXPECT_TRUE(makeSharedArray(10)->getStorage().isShared());
+}
+
+TEST(ProcessManagerTest, RoundsRunUntilAllProcessesTerminated) {
+    auto arrayManager = makeSharedArray(1000);
+    {
+        ProcessManager manager(arrayManager);
+        manager.setPacing(PacingPolicy::none());
+        manager.createProcesses(4);
+        EXPECT_EQ(manager.getPid(1), -1);
+        manager.startAllProcesses();
+        EXPECT_GT(manager.getPid(1), 0);
+        
+        int rounds = 0;
+        while (!manager.areAllProcessesFinished()) {
+            manager.waitForAllProcessesBlocked();
+            ++rounds;
+            // The markers wrote through their own mappings of the segment.
+            for (int id : manager.getActiveProcessIds()) {
+                EXPECT_EQ(manager.getMarkedCount(id), arrayManager->recountMarkedElements(id));
+                EXPECT_NE(arrayManager->getElementAt(manager.getBlockedIndex(id)), 0);
+            }
+            
+            const int victim = manager.getActiveProcessIds().front();
+            manager.terminateProcess(victim);
+            EXPECT_EQ(arrayManager->recountMarkedElements(victim), 0u);
+            if (!manager.areAllProcessesFinished()) {
+                manager.continueOtherProcesses();
+            }
+        }
+        EXPECT_EQ(rounds, 4);
+        EXPECT_GT(manager.getTotalMarks(), 0u);
+        EXPECT_TRUE(manager.getCrashedIds().empty());
+    }
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+
+TEST(ProcessManagerTest, CrashedMarkerIsContained) {
+    auto arrayManager = makeSharedArray(1000);
+    {
+        ProcessManager manager(arrayManager);
+        manager.setPacing(PacingPolicy::none());
+        manager.createProcesses(3);
+        manager.startAllProcesses();
+        manager.waitForAllProcessesBlocked();
+        
+        ASSERT_EQ(kill(manager.getPid(2), SIGKILL), 0);
+        manager.terminateProcess(1);
+        manager.continueOtherProcesses();
+        manager.waitForAllProcessesBlocked();
+        
+        EXPECT_EQ(manager.getCrashedIds(), (std::vector<int>{2}));
+        EXPECT_EQ(manager.getActiveProcessIds(), (std::vector<int>{3}));
+        EXPECT_EQ(arrayManager->recountMarkedElements(2), 0u);
+        EXPECT_EQ(manager.getMarkedCount(3), arrayManager->recountMarkedElements(3));
+    }
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+#endif
+
+#ifdef THREAD_SYNC_COROUTINES
+CoroTask awaitEvent(AsyncEvent& event, std::vector<int>& order, int id) {
+    co_await event.wait();
+    order.push_back(id);
+}
+
+CoroTask awaitCountdown(AsyncCountdownEvent& countdown, bool& done) {
+    co_await countdown.wait();
+    done = true;
+}
+
+CoroTask awaitEpoch(AsyncEpochEvent& epoch, uint32_t seenEpoch, int& resumed) {
+    co_await epoch.waitForChange(seenEpoch);
+    ++resumed;
+}
+
+CoroTask sleepThenRecord(CoroExecutor& executor, std::chrono::microseconds delay,
+                         std::vector<int>& order, int id) {
+    co_await executor.sleepFor(delay);
+    order.push_back(id);
+}
+
+CoroTask failAfterYield(CoroExecutor& executor) {
+    co_await executor.yield();
+    throw std::runtime_error("marker failed");
+}
+
+TEST(CoroSyncTest, EventResumesWaitersInOrder) {
+    CoroExecutor executor;
+    AsyncEvent event(executor);
+    std::vector<int> order;
+    CoroTask first = awaitEvent(event, order, 1);
+    CoroTask second = awaitEvent(event, order, 2);
+    first.start(executor);
+    second.start(executor);
+    
+    executor.run();
+    EXPECT_TRUE(order.empty());
+    EXPECT_FALSE(first.isDone());
+    
+    event.signal();
+    EXPECT_TRUE(order.empty());
+    executor.run();
+    EXPECT_EQ(order, (std::vector<int>{1, 2}));
+    EXPECT_TRUE(first.isDone());
+    EXPECT_TRUE(second.isDone());
+    
+    // A signaled event does not suspend its waiter at all.
+    CoroTask third = awaitEvent(event, order, 3);
+    third.start(executor);
+    executor.run();
+    EXPECT_EQ(order.back(), 3);
+    EXPECT_EQ(executor.getResumes(), 5u);
+}
+
+TEST(CoroSyncTest, CountdownMirrorsCountdownEvent) {
+    CoroExecutor executor;
+    EXPECT_THROW(AsyncCountdownEvent(executor, -1), std::invalid_argument);
+    
+    AsyncCountdownEvent countdown(executor, 2);
+    bool done = false;
+    CoroTask task = awaitCountdown(countdown, done);
+    task.start(executor);
+    
+    countdown.signal();
+    countdown.addCount();
+    countdown.signal();
+    executor.run();
+    EXPECT_FALSE(done);
+    
+    countdown.signal();
+    countdown.signal();
+    executor.run();
+    EXPECT_TRUE(done);
+    EXPECT_TRUE(countdown.isSet());
+    EXPECT_THROW(countdown.addCount(), std::logic_error);
+    
+    countdown.reset(1);
+    EXPECT_FALSE(countdown.isSet());
+}
+
+TEST(CoroSyncTest, EpochReleasesEveryWaiter) {
+    CoroExecutor executor;
+    AsyncEpochEvent epoch(executor);
+    int resumed = 0;
+    std::vector<CoroTask> tasks;
+    for (int i = 0; i < 100; ++i) {
+        tasks.push_back(awaitEpoch(epoch, epoch.current(), resumed));
+        tasks.back().start(executor);
+    }
+    
+    executor.run();
+    EXPECT_EQ(resumed, 0);
+    EXPECT_EQ(epoch.advance(), 1u);
+    executor.run();
+    EXPECT_EQ(resumed, 100);
+}
+
+TEST(CoroSyncTest, ExecutorRunsSleepersByDeadline) {
+    CoroExecutor executor;
+    std::vector<int> order;
+    CoroTask slow = sleepThenRecord(executor, std::chrono::microseconds(3000), order, 1);
+    CoroTask fast = sleepThenRecord(executor, std::chrono::microseconds(1000), order, 2);
+    CoroTask immediate = sleepThenRecord(executor, std::chrono::microseconds(0), order, 3);
+    CoroTask failing = failAfterYield(executor);
+    slow.start(executor);
+    fast.start(executor);
+    immediate.start(executor);
+    failing.start(executor);
+    
+    const auto startedAt = std::chrono::steady_clock::now();
+    executor.run();
+    EXPECT_GE(std::chrono::steady_clock::now() - startedAt, std::chrono::microseconds(3000));
+    EXPECT_EQ(order, (std::vector<int>{3, 2, 1}));
+    EXPECT_EQ(executor.getSleepingCount(), 0u);
+    EXPECT_THROW(failing.rethrowIfFailed(), std::runtime_error);
+    EXPECT_NO_THROW(slow.rethrowIfFailed());
+}
+
+TEST(CoroMarkerTest, RoundsRunUntilAllMarkersTerminated) {
+    auto arrayManager = std::make_shared<ArrayManager>(100, ArrayBackend::LockFree);
+    CoroMarkerManager manager(arrayManager);
+    manager.setPacing(PacingPolicy::none());
+    manager.createMarkers(4);
+    EXPECT_THROW(manager.createMarkers(0), std::invalid_argument);
+    manager.startAllMarkers();
+    
+    int rounds = 0;
+    while (!manager.areAllMarkersFinished()) {
+        manager.waitForAllMarkersBlocked();
+        ++rounds;
+        for (int id : manager.getActiveMarkerIds()) {
+            CoroMarker* marker = manager.findMarkerById(id);
+            EXPECT_TRUE(marker->isBlocked());
+            EXPECT_EQ(marker->getMarkedCount(), arrayManager->recountMarkedElements(id));
+        }
+        
+        const int victim = manager.getActiveMarkerIds().front();
+        manager.terminateMarker(victim);
+        EXPECT_EQ(arrayManager->recountMarkedElements(victim), 0u);
+        EXPECT_EQ(manager.findMarkerById(victim), nullptr);
+        EXPECT_THROW(manager.terminateMarker(victim), std::invalid_argument);
+        if (!manager.areAllMarkersFinished()) {
+            manager.continueOtherMarkers();
+        }
+    }
+    EXPECT_EQ(rounds, 4);
+    EXPECT_GT(manager.getTotalMarks(), 0u);
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+
+TEST(CoroMarkerTest, ThousandsOfMarkersOnOneThread) {
+    auto arrayManager = std::make_shared<ArrayManager>(20000, ArrayBackend::LockFree);
+    {
+        CoroMarkerManager manager(arrayManager);
+        manager.setPacing(PacingPolicy::sleep(std::chrono::microseconds(200)));
+        manager.createMarkers(2000);
+        manager.startAllMarkers();
+        
+        for (int round = 0; round < 3; ++round) {
+            manager.waitForAllMarkersBlocked();
+            const int victim = manager.getActiveMarkerIds().back();
+            manager.terminateMarker(victim);
+            EXPECT_EQ(arrayManager->recountMarkedElements(victim), 0u);
+            manager.continueOtherMarkers();
+        }
+        EXPECT_EQ(manager.getActiveMarkerCount(), 1997u);
+        // Destroyed while the survivors are marking again.
+    }
+    EXPECT_EQ(arrayManager->recountMarkedElements(0), arrayManager->getSize());
+}
+#endif
+
+TEST_F(ThreadManagerTest, SnapshotStatsCoversTerminatedMarkers) {
+    threadManager->setPacing(PacingPolicy::none());
+    threadManager->createThreads(3);
+    threadManager->startAllThreads();
+    threadManager->waitForAllThreadsBlocked();
+    
+    threadManager->terminateThread(2);
+    threadManager->continueOtherThreads();
+    threadManager->waitForAllThreadsBlocked();
+    
+    const StatsSnapshot stats = threadManager->snapshotStats();
+    ASSERT_EQ(stats.markers.size(), 3u);
+    EXPECT_EQ(stats.markers[1].markerId, 2);
+    EXPECT_EQ(stats.total.successfulMarks, threadManager->getTotalMarks());
+    EXPECT_EQ(stats.total.markAttempts, stats.total.successfulMarks + stats.total.collisions);
+    // Every marker blocked in round one; the two survivors also resumed and
+    // blocked again, the terminated one resumed once to exit.
+    EXPECT_EQ(stats.total.collisions, 5u);
+    EXPECT_EQ(stats.total.resumeLatency.count, 3u);
+    EXPECT_EQ(stats.total.cleanupDuration.count, 1u);
+}
+
+TEST(DriverOptionsTest, NoArgumentsMeansInteractive) {
+    const DriverOptions options = parseDriverOptions({});
+    EXPECT_FALSE(options.headless);
+}
+
+TEST(DriverOptionsTest, ParsesFlags) {
+    const DriverOptions options = parseDriverOptions({
+        "--array-size", "5000000", "--markers", "500", "--rounds", "10",
+        "--terminate", "random", "--seed", "7", "--verbosity", "rounds",
+        "--backend", "striped", "--stripes", "16", "--log-level", "warning",
+        "--log-overflow", "block", "--dump", "delta",
+        "--huge-pages", "thp", "--numa", "interleave", "--storage", "anon", "--cell-width", "16",
+        "--affinity", "cpus:0-1", "--execution", "pool:8"});
+    
+    EXPECT_TRUE(options.headless);
+    EXPECT_EQ(options.arraySize, 5000000u);
+    EXPECT_EQ(options.markerCount, 500);
+    EXPECT_EQ(options.roundLimit, 10u);
+    EXPECT_EQ(options.termination, TerminationChoice::Random);
+    EXPECT_EQ(options.seed, 7u);
+    EXPECT_EQ(options.verbosity, Verbosity::Rounds);
+    EXPECT_EQ(options.backend, ArrayBackend::Striped);
+    EXPECT_EQ(options.stripeCount, 16u);
+    EXPECT_EQ(options.logLevel, LogLevel::Warning);
+    EXPECT_EQ(options.logOverflow, LogOverflow::Block);
+    EXPECT_EQ(options.dumpMode, ArrayDumpMode::Delta);
+    EXPECT_EQ(options.storage.kind, StorageKind::Anonymous);
+    EXPECT_EQ(options.storage.hugePages, HugePageMode::Transparent);
+    EXPECT_EQ(options.cellWidth, CellWidth::Halfword);
+    EXPECT_EQ(options.storage.numa, NumaPlacement::Interleave);
+    EXPECT_EQ(options.affinity.kind, AffinityKind::Explicit);
+    EXPECT_EQ(options.affinity.cpus, (std::vector<int>{0, 1}));
+    EXPECT_EQ(options.execution, ExecutionMode::Pool);
+    EXPECT_EQ(options.poolWorkers, 8u);
+    EXPECT_FALSE(parseDriverOptions({"--cell-width", "auto"}).cellWidth.has_value());
+
+#ifdef THREAD_SYNC_PROCESSES
+    const DriverOptions processes = parseDriverOptions({"--execution", "processes", "--storage", "shm"});
+    EXPECT_EQ(processes.execution, ExecutionMode::Processes);
+    EXPECT_EQ(processes.storage.kind, StorageKind::Shared);
+#else
+    EXPECT_THROW(parseDriverOptions({"--execution", "processes"}), std::invalid_argument);
+#endif
+    EXPECT_EQ(parseDriverOptions({"--batch", "16"}).markBatch, 16u);
+    EXPECT_EQ(parseDriverOptions({"--claim", "nearest"}).claim, ClaimMode::Nearest);
+    EXPECT_EQ(parseDriverOptions({"--release", "lazy"}).release, ReleaseMode::Lazy);
+}
+
+TEST(DriverOptionsTest, QuietImpliesWarningLogLevel) {
+    EXPECT_EQ(effectiveLogLevel(parseDriverOptions({"--headless"})), LogLevel::Warning);
+    EXPECT_EQ(effectiveLogLevel(parseDriverOptions({"--verbosity", "rounds"})), LogLevel::Info);
+    EXPECT_EQ(effectiveLogLevel(parseDriverOptions({"--log-level", "debug"})), LogLevel::Debug);
+}
+
+TEST(DriverOptionsTest, RejectsBadInput) {
+    EXPECT_THROW(parseDriverOptions({"--markers", "0"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--markers", "-4"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--array-size"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--colour", "blue"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--cell-width", "12"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--execution", "fibers"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--terminate", "youngest"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--batch", "0"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--claim", "any"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--release", "later"}), std::invalid_argument);
+    EXPECT_THROW(parseDriverOptions({"--config", "/nonexistent/driver.conf"}), std::invalid_argument);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
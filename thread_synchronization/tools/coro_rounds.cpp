@@ -0,0 +1,125 @@
+#include "array_dump.h"
+#include "array_manager.h"
+#include "coro_marker.h"
+#include "driver_options.h"
+#include "logger.h"
+#include "victim_policy.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<VictimCandidate> markerCandidates(CoroMarkerManager& markerManager) {
+    std::vector<VictimCandidate> candidates;
+    for (int id : markerManager.getActiveMarkerIds()) {
+        // Block times are not tracked for coroutine markers.
+        candidates.push_back({id, markerManager.findMarkerById(id)->getMarkedCount(), 0});
+    }
+    return candidates;
+}
+
+// Everything here runs on one thread, so options that place or trace
+// marker threads have nothing to act on. Coroutine markers also mark just
+// the index they draw.
+void rejectThreadOptions(const DriverOptions& options) {
+    if (options.execution != ExecutionMode::Threads) {
+        throw std::invalid_argument("--execution does not apply to coroutine markers");
+    }
+    if (options.affinity.kind != AffinityKind::None) {
+        throw std::invalid_argument("--affinity does not apply to coroutine markers");
+    }
+    if (!options.tracePath.empty()) {
+        throw std::invalid_argument("--trace is not supported for coroutine markers");
+    }
+    if (options.markBatch > 1) {
+        throw std::invalid_argument("--batch is not supported for coroutine markers");
+    }
+    if (options.claim != ClaimMode::Drawn) {
+        throw std::invalid_argument("--claim nearest is not supported for coroutine markers");
+    }
+    if (options.release != ReleaseMode::Eager) {
+        throw std::invalid_argument("--release lazy is not supported for coroutine markers");
+    }
+}
+
+}
+
+// Runs the headless round protocol with every marker a coroutine on a single
+// executor thread, printing the same summary line as thread_sync --headless
+// so the two can be compared directly.
+int main(int argc, char** argv) {
+    try {
+        const DriverOptions options = parseDriverOptions(std::vector<std::string>(argv + 1, argv + argc));
+        if (options.showHelp) {
+            printDriverUsage(std::cout, argv[0]);
+            std::cout << "\nMarkers run as coroutines on one thread; --execution, --affinity,\n"
+                      << "--trace, --batch, --claim and --release are not supported.\n";
+            return 0;
+        }
+        rejectThreadOptions(options);
+        
+        const auto startTime = std::chrono::steady_clock::now();
+        defaultLogger().setLevel(effectiveLogLevel(options));
+        defaultLogger().setOverflow(options.logOverflow);
+        
+        const CellWidth cellWidth = options.cellWidth.value_or(narrowestCellWidth(options.markerCount));
+        auto arrayManager = std::make_shared<ArrayManager>(options.arraySize, options.backend,
+                                                           options.stripeCount, options.storage, cellWidth);
+        auto markerManager = std::make_unique<CoroMarkerManager>(arrayManager);
+        markerManager->setPacing(options.pacing);
+        markerManager->setAccessPolicy(options.access);
+        markerManager->createMarkers(options.markerCount);
+        markerManager->startAllMarkers();
+        
+        ArrayDumper dumper(options.dumpMode);
+        VictimSelector victimSelector(options.termination, options.seed);
+        size_t rounds = 0;
+        
+        while (!markerManager->areAllMarkersFinished() &&
+               (options.roundLimit == 0 || rounds < options.roundLimit)) {
+            markerManager->waitForAllMarkersBlocked();
+            ++rounds;
+            
+            const int victim = victimSelector.choose(markerCandidates(*markerManager));
+            if (options.verbosity != Verbosity::Quiet) {
+                defaultLogger().log(LogLevel::Info, "round=", rounds, " terminated=", victim,
+                                    " marked=", markerManager->findMarkerById(victim)->getMarkedCount());
+            }
+            if (options.verbosity == Verbosity::Full) {
+                defaultLogger().flush();
+                dumper.print(*arrayManager, std::cout);
+            }
+            
+            markerManager->terminateMarker(victim);
+            if (!markerManager->areAllMarkersFinished()) {
+                markerManager->continueOtherMarkers();
+            }
+        }
+        
+        const size_t totalMarks = markerManager->getTotalMarks();
+        const uint64_t resumes = markerManager->getExecutor().getResumes();
+        markerManager.reset();
+        defaultLogger().flush();
+        
+        const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (options.verbosity != Verbosity::Quiet) {
+            std::cout << "executor resumes=" << resumes << "\n";
+        }
+        std::cout << std::fixed << std::setprecision(3)
+                  << "summary rounds=" << rounds
+                  << " total_marks=" << totalMarks
+                  << " wall_ms=" << wallSeconds * 1000.0
+                  << " marks_per_sec=" << (wallSeconds > 0 ? static_cast<double>(totalMarks) / wallSeconds : 0.0)
+                  << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        defaultLogger().log(LogLevel::Error, "Fatal error: ", e.what());
+        defaultLogger().flush();
+        return 1;
+    }
+}
@@ -0,0 +1,154 @@
+#include "array_manager.h"
+#include "trace.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct ReplayOptions {
+    std::string path;
+    size_t bucketCount = 20;
+    size_t topCount = 10;
+};
+
+struct Bucket {
+    size_t events = 0;
+    size_t marks = 0;
+    size_t collisions = 0;
+    size_t blockedAtEnd = 0;
+};
+
+ReplayOptions parseArgs(int argc, char** argv) {
+    ReplayOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "--buckets" || arg == "--top") && i + 1 < argc) {
+            const size_t value = std::stoul(argv[++i]);
+            (arg == "--buckets" ? options.bucketCount : options.topCount) = value;
+        } else if (options.path.empty() && arg.rfind("--", 0) != 0) {
+            options.path = arg;
+        } else {
+            throw std::invalid_argument("Unexpected argument: " + arg);
+        }
+    }
+    
+    if (options.path.empty() || options.bucketCount == 0) {
+        throw std::invalid_argument("Usage: thread_sync_trace_replay FILE [--buckets N] [--top N]");
+    }
+    return options;
+}
+
+}
+
+// Replays a marker trace against a fresh ArrayManager, checks that every
+// recorded mark and reset is reproducible, and prints a contention timeline.
+int main(int argc, char** argv) {
+    try {
+        const ReplayOptions options = parseArgs(argc, argv);
+        TraceFile trace = readTraceFile(options.path);
+        auto& records = trace.records;
+        
+        std::stable_sort(records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+            return a.timestamp < b.timestamp;
+        });
+        
+        std::cout << "trace " << options.path << ": " << records.size() << " events, array size "
+                  << trace.header.arraySize << std::endl;
+        if (records.empty()) {
+            return 0;
+        }
+        
+        const uint64_t start = records.front().timestamp;
+        const uint64_t span = records.back().timestamp - start + 1;
+        const double ticksPerMs = trace.header.ticksPerNanosecond * 1e6;
+        
+        ArrayManager array(static_cast<size_t>(trace.header.arraySize), ArrayBackend::LockFree);
+        std::vector<Bucket> buckets(options.bucketCount);
+        std::map<uint64_t, size_t> collisionsByIndex;
+        std::set<uint32_t> blocked;
+        std::map<TraceEventType, size_t> totals;
+        size_t inconsistent = 0;
+        
+        for (const TraceRecord& record : records) {
+            const size_t bucketIndex = static_cast<size_t>(
+                (record.timestamp - start) * options.bucketCount / span);
+            Bucket& bucket = buckets[std::min(bucketIndex, options.bucketCount - 1)];
+            ++bucket.events;
+            ++totals[record.type];
+            
+            switch (record.type) {
+                case TraceEventType::Mark:
+                    ++bucket.marks;
+                    if (record.index >= array.getSize() ||
+                        !array.markElement(static_cast<size_t>(record.index), static_cast<int>(record.markerId))) {
+                        ++inconsistent;
+                    }
+                    break;
+                case TraceEventType::Collision:
+                    ++bucket.collisions;
+                    ++collisionsByIndex[record.index];
+                    break;
+                case TraceEventType::Block:
+                    blocked.insert(record.markerId);
+                    break;
+                case TraceEventType::Resume:
+                    blocked.erase(record.markerId);
+                    break;
+                case TraceEventType::Terminate:
+                    break;
+                case TraceEventType::Reset:
+                    if (array.resetMarkedElements(static_cast<int>(record.markerId)) != record.index) {
+                        ++inconsistent;
+                    }
+                    break;
+            }
+            bucket.blockedAtEnd = blocked.size();
+        }
+        
+        std::cout << "events:";
+        for (const auto& [type, count] : totals) {
+            std::cout << " " << traceEventName(type) << "=" << count;
+        }
+        std::cout << " inconsistent=" << inconsistent << "\n\n";
+        
+        std::cout << std::setw(12) << "t_ms" << std::setw(10) << "marks"
+                  << std::setw(12) << "collisions" << std::setw(10) << "blocked" << "\n";
+        size_t lastBlocked = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            Bucket& bucket = buckets[i];
+            // Buckets without events keep the previous blocked count.
+            if (bucket.events == 0) {
+                bucket.blockedAtEnd = lastBlocked;
+            }
+            lastBlocked = bucket.blockedAtEnd;
+            
+            const double bucketStartMs = static_cast<double>(span) * static_cast<double>(i) /
+                                         static_cast<double>(buckets.size()) / ticksPerMs;
+            std::cout << std::fixed << std::setprecision(3) << std::setw(12) << bucketStartMs
+                      << std::setw(10) << bucket.marks << std::setw(12) << bucket.collisions
+                      << std::setw(10) << bucket.blockedAtEnd << "\n";
+        }
+        
+        std::vector<std::pair<uint64_t, size_t>> hottest(collisionsByIndex.begin(), collisionsByIndex.end());
+        std::sort(hottest.begin(), hottest.end(), [](const auto& a, const auto& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        hottest.resize(std::min(hottest.size(), options.topCount));
+        
+        std::cout << "\nhottest indices by collisions:\n";
+        for (const auto& [index, count] : hottest) {
+            std::cout << std::setw(12) << index << std::setw(10) << count << "\n";
+        }
+        
+        return inconsistent == 0 ? 0 : 3;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}